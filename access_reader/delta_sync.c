@@ -0,0 +1,188 @@
+#include "delta_sync.h"
+
+#include "string.h"
+
+#include "../common/trace.h"
+
+#define DELTA_MAGIC 0x5344 // "DS"
+
+static uint16_t get_u16(const uint8_t *buf){
+  return buf[0] | buf[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *buf){
+  return buf[0] | buf[1] << 8 | (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+static void put_u16(uint8_t *buf, uint16_t value){
+  buf[0] = value;
+  buf[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *buf, uint32_t value){
+  for (int i = 0; i < 4; i++){
+    buf[i] = value >> (8 * i);
+  }
+}
+
+static void fletcher16(const uint8_t *buf, int len, uint16_t *sum1, uint16_t *sum2){
+  for (int i = 0; i < len; i++){
+    *sum1 = (*sum1 + buf[i]) % 255;
+    *sum2 = (*sum2 + *sum1) % 255;
+  }
+}
+
+// Fletcher-16 over the header after the magic, but the checksum, and the records.
+static uint16_t frame_checksum(const uint8_t *frame, uint16_t used){
+  uint16_t sum1 = 0, sum2 = 0;
+  fletcher16(&frame[2], DELTA_HEADER_SIZE - 4, &sum1, &sum2);
+  fletcher16(&frame[DELTA_HEADER_SIZE], used, &sum1, &sum2);
+  return sum2 << 8 | sum1;
+}
+
+// 7 bits a byte, low first; a set top bit means more follow.
+static uint16_t put_varint(uint8_t *buf, uint32_t value){
+  uint16_t len = 0;
+  for ( ; value >= 0x80; value >>= 7){
+    buf[len++] = value | 0x80;
+  }
+  buf[len++] = value;
+  return len;
+}
+
+// decode the record at '*offset' of a frame whose records end at 'end', with 'code' holding the
+// code of the record before it, and move '*offset' past it. return false if it is malformed.
+static bool decode_record(const uint8_t *frame, uint16_t end, uint16_t *offset, uint32_t base_time,
+  uint8_t *code, delta_record_t *record){
+  uint16_t at = *offset;
+  if (at >= end) return false;
+  uint8_t op = frame[at] >> 6, shared = frame[at] & 0x3F;
+  at++;
+  if (op > DELTA_REMOVE || shared > DELTA_CODE_BYTES || end - at < DELTA_CODE_BYTES - shared) return false;
+  memcpy(&code[shared], &frame[at], DELTA_CODE_BYTES - shared);
+  at += DELTA_CODE_BYTES - shared;
+  record->op = op;
+  memcpy(record->code, code, DELTA_CODE_BYTES);
+  record->expiration = 0;
+  if (op != DELTA_REMOVE){
+    uint64_t delta = 0;
+    for (int shift = 0; ; shift += 7){
+      if (at == end || shift > 28) return false;
+      delta |= (uint64_t) (frame[at] & 0x7F) << shift;
+      if (!(frame[at++] & 0x80)) break;
+    }
+    if (delta > UINT32_MAX - base_time) return false;
+    record->expiration = base_time + delta;
+  }
+  *offset = at;
+  return true;
+}
+
+// start the frame being filled, empty.
+static void start_frame(delta_writer_t *writer){
+  writer->count = 0;
+  writer->used = 0;
+}
+
+// finish the frame being filled and hand it to 'emit'.
+static bool emit_frame(delta_writer_t *writer, bool last){
+  uint8_t *frame = writer->frame;
+  put_u16(&frame[0], DELTA_MAGIC);
+  put_u16(&frame[2], writer->door_id);
+  put_u16(&frame[4], writer->seq);
+  frame[6] = writer->flags | (last ? DELTA_LAST : 0);
+  frame[7] = writer->count;
+  put_u32(&frame[8], writer->base_time);
+  put_u16(&frame[12], writer->used);
+  put_u16(&frame[14], frame_checksum(frame, writer->used));
+  writer->seq++;
+  bool ok = writer->emit(frame, DELTA_HEADER_SIZE + writer->used, writer->arg);
+  start_frame(writer);
+  return ok;
+}
+
+void delta_writer_init(delta_writer_t *writer, uint16_t door_id, uint32_t base_time, bool full,
+  delta_emit_fn_t emit, void *arg){
+  writer->door_id = door_id;
+  writer->seq = 0;
+  writer->flags = full ? DELTA_FULL : 0;
+  writer->base_time = base_time;
+  writer->has_last = false;
+  writer->emit = emit;
+  writer->arg = arg;
+  start_frame(writer);
+}
+
+bool delta_writer_add(delta_writer_t *writer, const delta_record_t *record){
+  if (writer->has_last && memcmp(record->code, writer->last_code, DELTA_CODE_BYTES) <= 0) return false;
+  if (record->op != DELTA_REMOVE && record->expiration < writer->base_time) return false;
+  if (writer->used > DELTA_FRAME_SIZE - DELTA_HEADER_SIZE - DELTA_MAX_RECORD || writer->count == UINT8_MAX){
+    if (!emit_frame(writer, false)) return false;
+  }
+  uint8_t shared = 0;
+  if (writer->count > 0){
+    while (shared < DELTA_CODE_BYTES && record->code[shared] == writer->last_code[shared]) shared++;
+  }
+  uint8_t *out = &writer->frame[DELTA_HEADER_SIZE + writer->used];
+  uint16_t len = 0;
+  out[len++] = record->op << 6 | shared;
+  memcpy(&out[len], &record->code[shared], DELTA_CODE_BYTES - shared);
+  len += DELTA_CODE_BYTES - shared;
+  if (record->op != DELTA_REMOVE) len += put_varint(&out[len], record->expiration - writer->base_time);
+  writer->used += len;
+  writer->count++;
+  memcpy(writer->last_code, record->code, DELTA_CODE_BYTES);
+  writer->has_last = true;
+  return true;
+}
+
+bool delta_writer_finish(delta_writer_t *writer){
+  return emit_frame(writer, true);
+}
+
+bool delta_frame_open(delta_frame_t *reader, const uint8_t *frame, uint16_t len){
+  if (len < DELTA_HEADER_SIZE || get_u16(&frame[0]) != DELTA_MAGIC) return false;
+  uint16_t used = get_u16(&frame[12]);
+  if (used != len - DELTA_HEADER_SIZE || get_u16(&frame[14]) != frame_checksum(frame, used)) return false;
+  reader->frame = frame;
+  reader->door_id = get_u16(&frame[2]);
+  reader->seq = get_u16(&frame[4]);
+  reader->flags = frame[6];
+  reader->count = frame[7];
+  reader->base_time = get_u32(&frame[8]);
+  reader->offset = DELTA_HEADER_SIZE;
+  reader->read = 0;
+
+  // every record must decode, in order, and fill the frame exactly.
+  uint16_t offset = DELTA_HEADER_SIZE;
+  uint8_t code[DELTA_CODE_BYTES], previous[DELTA_CODE_BYTES];
+  delta_record_t record;
+  for (int i = 0; i < reader->count; i++){
+    if (i == 0 && offset < len && (frame[offset] & 0x3F) != 0) return false;
+    if (!decode_record(frame, len, &offset, reader->base_time, code, &record)) return false;
+    if (i > 0 && memcmp(code, previous, DELTA_CODE_BYTES) <= 0) return false;
+    memcpy(previous, code, DELTA_CODE_BYTES);
+  }
+  return offset == len;
+}
+
+bool delta_frame_next(delta_frame_t *reader, delta_record_t *record){
+  if (reader->read == reader->count) return false;
+  uint16_t end = DELTA_HEADER_SIZE + get_u16(&reader->frame[12]);
+  decode_record(reader->frame, end, &reader->offset, reader->base_time, reader->code, record);
+  reader->read++;
+  TRACE_COUNT("delta records", 1);
+  return true;
+}
+
+bool delta_frame_has(const delta_frame_t *reader, const uint8_t *code){
+  uint16_t offset = DELTA_HEADER_SIZE, end = DELTA_HEADER_SIZE + get_u16(&reader->frame[12]);
+  uint8_t scan[DELTA_CODE_BYTES];
+  delta_record_t record;
+  for (int i = 0; i < reader->count; i++){
+    decode_record(reader->frame, end, &offset, reader->base_time, scan, &record);
+    int order = memcmp(scan, code, DELTA_CODE_BYTES);
+    if (order >= 0) return order == 0;
+  }
+  return false;
+}
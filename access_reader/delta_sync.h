@@ -0,0 +1,112 @@
+#ifndef DELTA_SYNC_H_
+#define DELTA_SYNC_H_
+
+#include "stdbool.h"
+#include "stdint.h"
+
+// Delta sync: a batch of changes to a reader's code table, sent as frames of up to
+// DELTA_FRAME_SIZE bytes instead of one 40-byte packet per code.
+//
+// A frame is little-endian:
+//   [ uint16 magic ][ uint16 door_id ][ uint16 seq ][ uint8 flags ][ uint8 count ]
+//   [ uint32 base_time ][ uint16 used ][ uint16 checksum ][ used bytes of records ]
+// 'seq' counts the frames of a batch from 0, and the checksum is Fletcher-16 over everything
+// after the magic but the checksum itself. A frame decodes on its own, so a frame lost or
+// corrupted on the radio is sent again without the frames around it.
+//
+// A record is:
+//   [ op:2 | shared:6 ][ code bytes shared.. ][ varint expiration - base_time ]
+// 'shared' is the number of leading bytes the code has in common with the record before it in
+// the frame (0 for the first), and a remove has no expiration. Records are in increasing code
+// order, which is also the order of the reader's table (see hash() in main.c), so the reader
+// applies a batch in one pass over its flash.
+//
+// A batch flagged DELTA_FULL lists every code the reader should have: each frame also removes
+// the codes after the previous frame's last code, through its own, that it does not list; the
+// last frame (DELTA_LAST) removes every unlisted code after the previous frame's.
+//
+// Both ops that set an expiration set it exactly, later or earlier, unlike single packets.
+
+#define DELTA_FRAME_SIZE 256
+#define DELTA_HEADER_SIZE 16
+#define DELTA_CODE_BYTES 32                    // ACCESS_CODE_BYTES of main.c
+#define DELTA_MAX_RECORD (1 + DELTA_CODE_BYTES + 5)
+
+#define DELTA_FULL 1
+#define DELTA_LAST 2
+
+typedef enum {
+  DELTA_ADD = 0,        // store the code with this expiration
+  DELTA_EXPIRY = 1,     // change the expiration of the code, if stored
+  DELTA_REMOVE = 2,
+} delta_op_t;
+
+typedef enum {
+  DELTA_OK,             // applied; more frames of the batch to come
+  DELTA_DONE,           // applied the last frame of the batch
+  DELTA_BAD_FRAME,      // failed its checksum or is malformed: send it again
+  DELTA_OUT_OF_ORDER,   // not the next frame of a batch: send the batch again from seq 0
+  DELTA_OTHER_DOOR,     // for another door: ignored
+} delta_status_t;
+
+typedef struct {
+  delta_op_t op;
+  uint8_t code[DELTA_CODE_BYTES];
+  uint32_t expiration;  // not for DELTA_REMOVE
+} delta_record_t;
+
+// head-end side: called with each frame as it fills.
+typedef bool (*delta_emit_fn_t)(const uint8_t *frame, uint16_t len, void *arg);
+
+typedef struct {
+  uint16_t door_id;
+  uint16_t seq;         // of the frame being filled
+  uint8_t flags;
+  uint8_t count;
+  uint16_t used;
+  uint32_t base_time;
+  bool has_last;        // last_code holds the code of the latest record
+  uint8_t last_code[DELTA_CODE_BYTES];
+  delta_emit_fn_t emit;
+  void *arg;
+  uint8_t frame[DELTA_FRAME_SIZE];
+} delta_writer_t;
+
+// start a batch for 'door_id', full or not, with expirations counted from 'base_time'.
+void delta_writer_init(delta_writer_t *writer, uint16_t door_id, uint32_t base_time, bool full,
+  delta_emit_fn_t emit, void *arg);
+
+// add a record. return false if its code is not after the last one, its expiration is before
+// base_time, or 'emit' fails.
+bool delta_writer_add(delta_writer_t *writer, const delta_record_t *record);
+
+// emit the frame being filled as the last one of the batch, even if it is empty.
+bool delta_writer_finish(delta_writer_t *writer);
+
+// reader side: the records of one frame.
+typedef struct {
+  const uint8_t *frame;
+  uint16_t door_id;
+  uint16_t seq;
+  uint8_t flags;
+  uint8_t count;
+  uint32_t base_time;
+  uint16_t offset;      // of the next record
+  uint8_t read;         // records read
+  uint8_t code[DELTA_CODE_BYTES];  // of the latest record read
+} delta_frame_t;
+
+/* delta_frame_open
+ * check the frame of 'len' bytes at 'frame' and start reading its records.
+ * return false unless its checksum holds and every record decodes, in increasing code order,
+ * so a frame is applied whole or not at all.
+*/
+bool delta_frame_open(delta_frame_t *reader, const uint8_t *frame, uint16_t len);
+
+// the next record into 'record'. return false after the last.
+bool delta_frame_next(delta_frame_t *reader, delta_record_t *record);
+
+// return true if the frame has a record for 'code'.
+bool delta_frame_has(const delta_frame_t *reader, const uint8_t *code);
+
+#endif  // DELTA_SYNC_H_
@@ -0,0 +1,182 @@
+#include "expiry_wheel.h"
+
+#include "stddef.h"
+#include "string.h"
+
+#include "flash.h"
+#include "../common/trace.h"
+
+typedef struct __attribute__((__packed__)) {
+  uint16_t prev;        // slot + 1 of the entry before in the bucket, 0 for the first
+  uint16_t next;        // slot + 1 of the entry after, 0 for the last
+  uint32_t expiration;  // 0 if the slot is in no bucket
+} expiry_link_t;
+
+// heads are read this many at a time when mounting.
+#define HEADS_PER_READ 64
+
+static uint32_t head_address(const expiry_wheel_t *wheel, uint32_t bucket){
+  return wheel->base + 4 + 2 * bucket;
+}
+
+static uint32_t link_address(const expiry_wheel_t *wheel, uint32_t slot){
+  return wheel->base + EXPIRY_WHEEL_FIXED_BYTES + slot * sizeof(expiry_link_t);
+}
+
+static uint16_t read_head(const expiry_wheel_t *wheel, uint32_t bucket){
+  uint16_t head;
+  flash_read(head_address(wheel, bucket), (uint8_t *) &head, sizeof(head));
+  return head;
+}
+
+static void write_head(expiry_wheel_t *wheel, uint32_t bucket, uint16_t head){
+  flash_write(head_address(wheel, bucket), (uint8_t *) &head, sizeof(head));
+  if (head != 0) wheel->occupied[bucket / 32] |= 1u << (bucket % 32);
+  else wheel->occupied[bucket / 32] &= ~(1u << (bucket % 32));
+}
+
+static void read_link(const expiry_wheel_t *wheel, uint32_t slot, expiry_link_t *link){
+  flash_read(link_address(wheel, slot), (uint8_t *) link, sizeof(expiry_link_t));
+}
+
+static void write_link(const expiry_wheel_t *wheel, uint32_t slot, expiry_link_t *link){
+  flash_write(link_address(wheel, slot), (uint8_t *) link, sizeof(expiry_link_t));
+}
+
+// point the 'prev' (or 'next') of the entry stored as 'entry' (slot + 1) at 'value'.
+static void write_prev(const expiry_wheel_t *wheel, uint16_t entry, uint16_t value){
+  flash_write(link_address(wheel, entry - 1) + offsetof(expiry_link_t, prev), (uint8_t *) &value, sizeof(value));
+}
+
+static void write_next(const expiry_wheel_t *wheel, uint16_t entry, uint16_t value){
+  flash_write(link_address(wheel, entry - 1) + offsetof(expiry_link_t, next), (uint8_t *) &value, sizeof(value));
+}
+
+// the bucket an entry expiring at 'expiration' belongs in, with the cursor where it is.
+static uint32_t bucket_of(const expiry_wheel_t *wheel, uint32_t expiration){
+  uint32_t diff = expiration ^ wheel->cursor;
+  uint32_t level = 0;
+  while (level < EXPIRY_WHEEL_LEVELS - 1 && (diff >> (EXPIRY_WHEEL_SLOT_BITS * (level + 1))) != 0){
+    level++;
+  }
+  return level * EXPIRY_WHEEL_SLOTS + ((expiration >> (EXPIRY_WHEEL_SLOT_BITS * level)) & (EXPIRY_WHEEL_SLOTS - 1));
+}
+
+// take the entry whose link is 'link' out of 'bucket', joining its neighbours.
+static void unlink_entry(expiry_wheel_t *wheel, uint32_t bucket, const expiry_link_t *link){
+  if (link->prev != 0) write_next(wheel, link->prev, link->next);
+  else write_head(wheel, bucket, link->next);
+  if (link->next != 0) write_prev(wheel, link->next, link->prev);
+}
+
+// first bucket from 'from' on in the level whose bits start at 'bits', or -1.
+static int next_occupied(const uint32_t *bits, uint32_t from){
+  while (from < EXPIRY_WHEEL_SLOTS){
+    uint32_t word = bits[from / 32] >> (from % 32);
+    if (word != 0) return from + __builtin_ctz(word);
+    from = (from / 32 + 1) * 32;
+  }
+  return -1;
+}
+
+// the time the next non-empty bucket comes due, and that bucket; UINT64_MAX if there is none.
+// Level 0 buckets are due at their second, from the cursor's own on; a bucket of a higher
+// level, when the cursor reaches the start of its range.
+static uint64_t next_due(const expiry_wheel_t *wheel, uint32_t *bucket){
+  uint64_t due = UINT64_MAX;
+  for (uint32_t level = 0; level < EXPIRY_WHEEL_LEVELS; level++){
+    uint32_t shift = EXPIRY_WHEEL_SLOT_BITS * level;
+    uint32_t at = (wheel->cursor >> shift) & (EXPIRY_WHEEL_SLOTS - 1);
+    int slot = next_occupied(&wheel->occupied[level * EXPIRY_WHEEL_SLOTS / 32], level == 0 ? at : at + 1);
+    if (slot == -1) continue;
+    uint64_t above = (uint64_t) wheel->cursor >> (shift + EXPIRY_WHEEL_SLOT_BITS) << (shift + EXPIRY_WHEEL_SLOT_BITS);
+    uint64_t time = above | (uint64_t) slot << shift;
+    if (time < due){
+      due = time;
+      *bucket = level * EXPIRY_WHEEL_SLOTS + slot;
+    }
+  }
+  return due;
+}
+
+uint32_t expiry_wheel_bytes(uint32_t num_slots){
+  return EXPIRY_WHEEL_FIXED_BYTES + num_slots * sizeof(expiry_link_t);
+}
+
+bool expiry_wheel_init(expiry_wheel_t *wheel, uint32_t base, uint32_t size, uint32_t num_slots){
+  if (num_slots > EXPIRY_WHEEL_MAX_SLOTS || expiry_wheel_bytes(num_slots) > size) return false;
+  wheel->base = base;
+  wheel->num_slots = num_slots;
+  flash_read(base, (uint8_t *) &wheel->cursor, sizeof(wheel->cursor));
+  memset(wheel->occupied, 0, sizeof(wheel->occupied));
+  uint16_t heads[HEADS_PER_READ];
+  for (uint32_t bucket = 0; bucket < EXPIRY_WHEEL_BUCKETS; bucket += HEADS_PER_READ){
+    flash_read(head_address(wheel, bucket), (uint8_t *) heads, sizeof(heads));
+    for (uint32_t i = 0; i < HEADS_PER_READ; i++){
+      if (heads[i] != 0) wheel->occupied[(bucket + i) / 32] |= 1u << ((bucket + i) % 32);
+    }
+  }
+  return true;
+}
+
+bool expiry_wheel_insert(expiry_wheel_t *wheel, uint32_t slot, uint32_t expiration){
+  if (expiration < wheel->cursor || expiration == 0 || slot >= wheel->num_slots) return false;
+  uint32_t bucket = bucket_of(wheel, expiration);
+  uint16_t head = read_head(wheel, bucket);
+  expiry_link_t link = { .prev = 0, .next = head, .expiration = expiration };
+  write_link(wheel, slot, &link);
+  if (head != 0) write_prev(wheel, head, slot + 1);
+  write_head(wheel, bucket, slot + 1);
+  return true;
+}
+
+void expiry_wheel_remove(expiry_wheel_t *wheel, uint32_t slot){
+  expiry_link_t link;
+  read_link(wheel, slot, &link);
+  if (link.expiration == 0) return;
+  unlink_entry(wheel, bucket_of(wheel, link.expiration), &link);
+  memset(&link, 0, sizeof(link));
+  write_link(wheel, slot, &link);
+}
+
+void expiry_wheel_move(expiry_wheel_t *wheel, uint32_t from, uint32_t to){
+  expiry_link_t link;
+  read_link(wheel, from, &link);
+  if (link.expiration == 0) return;
+  write_link(wheel, to, &link);
+  if (link.prev != 0) write_next(wheel, link.prev, to + 1);
+  else write_head(wheel, bucket_of(wheel, link.expiration), to + 1);
+  if (link.next != 0) write_prev(wheel, link.next, to + 1);
+  memset(&link, 0, sizeof(link));
+  write_link(wheel, from, &link);
+}
+
+uint32_t expiry_wheel_advance(expiry_wheel_t *wheel, uint32_t now, expiry_wheel_fn_t expire){
+  if (now < wheel->cursor) return 0;
+  uint32_t expired = 0;
+  uint32_t bucket;
+  // every entry is due at or after next_due, so moving the cursor up to it leaves the other
+  // entries in their buckets.
+  for (uint64_t due = next_due(wheel, &bucket); due <= now; due = next_due(wheel, &bucket)){
+    wheel->cursor = due;
+    uint16_t head;
+    while ((head = read_head(wheel, bucket)) != 0){
+      expiry_link_t link;
+      read_link(wheel, head - 1, &link);
+      unlink_entry(wheel, bucket, &link);
+      if (bucket < EXPIRY_WHEEL_SLOTS){
+        memset(&link, 0, sizeof(link));
+        write_link(wheel, head - 1, &link);
+        expire(head - 1);
+        expired++;
+      } else {
+        // spread to a lower level; those due now land in level 0 at the cursor.
+        expiry_wheel_insert(wheel, head - 1, link.expiration);
+      }
+    }
+  }
+  wheel->cursor = now;
+  flash_write(wheel->base, (uint8_t *) &wheel->cursor, sizeof(wheel->cursor));
+  TRACE_COUNT("codes expired", expired);
+  return expired;
+}
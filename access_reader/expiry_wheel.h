@@ -0,0 +1,71 @@
+#ifndef EXPIRY_WHEEL_H_
+#define EXPIRY_WHEEL_H_
+
+#include "stdbool.h"
+#include "stdint.h"
+
+// Hierarchical timing wheel over the slots of a table in flash (see flash.h), so that reclaiming
+// expired entries costs time in proportion to how many expire, not to the size of the table.
+//
+// There are EXPIRY_WHEEL_LEVELS levels of EXPIRY_WHEEL_SLOTS buckets, one per byte of the 32-bit
+// expiration time. The wheel keeps a cursor, the time it has advanced to, and an entry expiring
+// at 'e' sits at the level of the highest byte where 'e' differs from the cursor (level 0 if they
+// are equal), in the bucket of that byte of 'e'. A bucket of level 0 is one second; of level 1,
+// 256 seconds; and so on. Advancing jumps the cursor from one non-empty bucket to the next: a
+// bucket of level 0 is due and its entries expire, one of a higher level is spread over the
+// levels below. An entry is spread at most EXPIRY_WHEEL_LEVELS - 1 times before it expires.
+//
+// The region holds:
+//   [ uint32 cursor ][ uint16 heads[LEVELS * SLOTS] ][ link[num_slots] ]
+//   link: [ uint16 prev ][ uint16 next ][ uint32 expiration ]
+// A bucket is a doubly linked list through the links of its table slots, with slot + 1 stored
+// so that erased (zeroed) flash is an empty wheel. RAM holds the cursor and a bit per bucket
+// that is not empty, to find the next one without reading flash; expiry_wheel_init rebuilds
+// the bits from the heads. The cursor is written back at the end of every advance.
+
+#define EXPIRY_WHEEL_LEVELS 4
+#define EXPIRY_WHEEL_SLOT_BITS 8
+#define EXPIRY_WHEEL_SLOTS (1 << EXPIRY_WHEEL_SLOT_BITS)
+#define EXPIRY_WHEEL_BUCKETS (EXPIRY_WHEEL_LEVELS * EXPIRY_WHEEL_SLOTS)
+// bytes of the region besides the links, and of the link of each slot.
+#define EXPIRY_WHEEL_FIXED_BYTES (4 + 2 * EXPIRY_WHEEL_BUCKETS)
+#define EXPIRY_WHEEL_SLOT_BYTES 8
+// slots are stored as slot + 1 in 16 bits.
+#define EXPIRY_WHEEL_MAX_SLOTS 0xFFFE
+
+typedef struct {
+  uint32_t base;        // flash address of the region
+  uint32_t num_slots;
+  uint32_t cursor;      // every entry expires at or after it
+  uint32_t occupied[EXPIRY_WHEEL_BUCKETS / 32];
+} expiry_wheel_t;
+
+// called with each slot that expires, after it has left the wheel.
+typedef void (*expiry_wheel_fn_t)(uint32_t slot);
+
+// bytes of flash the wheel takes for a table of 'num_slots' slots.
+uint32_t expiry_wheel_bytes(uint32_t num_slots);
+
+/* expiry_wheel_init
+ * mount the wheel for 'num_slots' table slots in the 'size' bytes of flash from 'base'.
+ * zeroed flash is an empty wheel. return false if the region is too small or there are too many slots.
+*/
+bool expiry_wheel_init(expiry_wheel_t *wheel, uint32_t base, uint32_t size, uint32_t num_slots);
+
+// add 'slot', expiring at 'expiration'. return false if the wheel's cursor is already past it.
+bool expiry_wheel_insert(expiry_wheel_t *wheel, uint32_t slot, uint32_t expiration);
+
+// take 'slot' out of the wheel, if it is in.
+void expiry_wheel_remove(expiry_wheel_t *wheel, uint32_t slot);
+
+// the table moved the entry of slot 'from' to the empty slot 'to': follow it.
+void expiry_wheel_move(expiry_wheel_t *wheel, uint32_t from, uint32_t to);
+
+/* expiry_wheel_advance
+ * move the cursor to 'now' and call 'expire' on every slot expiring at or before it, oldest
+ * first. 'expire' may move other slots with expiry_wheel_move. Going back in time does nothing.
+ * return the number of slots expired.
+*/
+uint32_t expiry_wheel_advance(expiry_wheel_t *wheel, uint32_t now, expiry_wheel_fn_t expire);
+
+#endif  // EXPIRY_WHEEL_H_
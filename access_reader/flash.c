@@ -2,21 +2,29 @@
 
 #include "stdint.h"
 
+#include "../common/trace.h"
+
 // In the real application, this is a separate device connected via SPI, MMC or
 // something like that.
 // For the purposes of this assignment,  we "fake" it with a 1 MByte array.
 static uint8_t flash_memory[FLASH_MEMORY_SIZE];
 
 bool flash_write(uint32_t address, uint8_t *src, uint32_t length) {
+  TRACE_BEGIN("flash_write");
   for (uint32_t idx = 0; idx < length; ++idx) {
     flash_memory[address + idx] = src[idx];
   }
+  TRACE_COUNT("flash bytes written", length);
+  TRACE_END("flash_write");
   return true;
 }
 
 bool flash_read(uint32_t address, uint8_t *dst, uint32_t length) {
+  TRACE_BEGIN("flash_read");
   for (uint32_t idx = 0; idx < length; ++idx) {
     dst[idx] = flash_memory[address + idx];
   }
+  TRACE_COUNT("flash bytes read", length);
+  TRACE_END("flash_read");
   return true;
 }
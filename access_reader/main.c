@@ -42,9 +42,13 @@ like the one described.
 #include "stdbool.h"
 #include "stdint.h"
 #include "stdio.h"
+#include "stdlib.h"
 
 #include "string.h"
+#include "delta_sync.h"
+#include "expiry_wheel.h"
 #include "flash.h"
+#include "../common/trace.h"
 
 // Number of bytes in the receive_access_code packet.
 #define UPDATE_SIZE_BYTES 40
@@ -65,6 +69,16 @@ typedef struct __attribute__((__packed__)) {
   access_code_t access_code; 
 } storage_block_t;
 
+// The flash holds the table of storage blocks, then the expiry wheel's region (expiry_wheel.h),
+// sized so that both fit. A code hashes to the blocks [0, TABLE_HASH_BLOCKS) and the table has
+// READ_BLOCKS_SIZE more after them, so a probe never runs off its end.
+#define TABLE_BLOCKS ((FLASH_MEMORY_SIZE - EXPIRY_WHEEL_FIXED_BYTES) / (sizeof(storage_block_t) + EXPIRY_WHEEL_SLOT_BYTES))
+#define TABLE_HASH_BLOCKS (TABLE_BLOCKS - READ_BLOCKS_SIZE)
+#define EXPIRY_WHEEL_BASE (TABLE_BLOCKS * sizeof(storage_block_t))
+
+// the wheel's cursor and bucket bits: the only RAM expiry takes.
+expiry_wheel_t expiry_wheel;
+
 typedef struct __attribute__((__packed__)) {
   uint16_t door_id;
   uint32_t expiration;
@@ -72,11 +86,144 @@ typedef struct __attribute__((__packed__)) {
   access_code_t access_code;
 } packet_t;
 
-uint32_t hash(access_code_t access_code){
-  uint32_t some_large_hash_number = access_code[0];
-  return some_large_hash_number % (FLASH_MEMORY_SIZE / sizeof(storage_block_t));
+// The leading 4 bytes of the code, scaled to the table. Codes are random, so this spreads them
+// evenly, and it keeps their order: codes in increasing order have increasing home blocks, so
+// a sorted delta sync batch (delta_sync.h) walks the table from front to back.
+uint32_t hash(const uint8_t *access_code){
+  uint32_t leading = (uint32_t) access_code[0] << 24 | (uint32_t) access_code[1] << 16 |
+    (uint32_t) access_code[2] << 8 | access_code[3];
+  return (uint64_t) leading * TABLE_HASH_BLOCKS >> 32;
+}
+
+// Flash calls and bytes spent on the table's blocks, so the check in main can show what a sync
+// costs: the simulated flash takes no time, and a real part pays a fixed command overhead on
+// every call as well as its bytes. The expiry wheel's own reads and writes are not counted.
+typedef struct {
+  uint32_t reads;
+  uint32_t read_bytes;
+  uint32_t writes;
+  uint32_t write_bytes;
+} flash_ops_t;
+
+flash_ops_t table_ops;
+
+void read_blocks(uint32_t idx, storage_block_t *blocks, uint32_t n){
+  flash_read(idx * sizeof(storage_block_t), (uint8_t *) blocks, n * sizeof(storage_block_t));
+  table_ops.reads++;
+  table_ops.read_bytes += n * sizeof(storage_block_t);
+}
+
+void write_blocks(uint32_t idx, storage_block_t *blocks, uint32_t n){
+  flash_write(idx * sizeof(storage_block_t), (uint8_t *) blocks, n * sizeof(storage_block_t));
+  table_ops.writes++;
+  table_ops.write_bytes += n * sizeof(storage_block_t);
+}
+
+// A RAM copy of the READ_BLOCKS_SIZE blocks from 'base', which the table is changed in:
+// get_block and put_block go to the window for the blocks it holds, and to flash for the others.
+// The blocks changed in it are written back in one flash_write when the window moves on past
+// them, and all of them by flush_window, at the end of every call that changes the table or, in
+// a delta sync batch, of the batch. Until then unlock_door reads them from the window, and a
+// reset loses them: a batch cut short is sent again from seq 0.
+typedef struct {
+  bool valid;
+  uint32_t base;
+  uint32_t dirty_from;   // the blocks [dirty_from, dirty_to) are not written back yet
+  uint32_t dirty_to;
+  storage_block_t blocks[READ_BLOCKS_SIZE];
+} block_window_t;
+
+block_window_t window;
+
+// Where get_block and put_block move the window to for a block it does not hold: the lowest
+// block the table's walk still needs (see seek_block), so in a batch it only moves forward.
+// With NO_FLOOR, as when the expiry wheel reclaims blocks, the window stays where it is.
+#define NO_FLOOR UINT32_MAX
+uint32_t window_floor = NO_FLOOR;
+
+bool in_window(uint32_t idx){
+  return window.valid && idx - window.base < READ_BLOCKS_SIZE;
+}
+
+// write the changed blocks before 'end' back to flash, in one call.
+void write_back(uint32_t end){
+  uint32_t to = window.dirty_to < end ? window.dirty_to : end;
+  if (window.dirty_from >= to) return;
+  write_blocks(window.dirty_from, &window.blocks[window.dirty_from - window.base], to - window.dirty_from);
+  window.dirty_from = to;
+  if (window.dirty_from == window.dirty_to) window.dirty_from = window.dirty_to = 0;
+}
+
+void flush_window(void){
+  write_back(UINT32_MAX);
+}
+
+// Move the window to start at 'base' (at most TABLE_HASH_BLOCKS), writing back the changed blocks
+// it leaves and reading only the ones it did not hold.
+void move_window(uint32_t base){
+  if (window.valid && base == window.base) return;
+  if (window.valid && base - window.base < READ_BLOCKS_SIZE){
+    write_back(base);
+    uint32_t keep = READ_BLOCKS_SIZE - (base - window.base);
+    memmove(window.blocks, &window.blocks[base - window.base], keep * sizeof(storage_block_t));
+    read_blocks(base + keep, &window.blocks[keep], READ_BLOCKS_SIZE - keep);
+  } else if (window.valid && window.base - base < READ_BLOCKS_SIZE){
+    flush_window();
+    uint32_t keep = READ_BLOCKS_SIZE - (window.base - base);
+    memmove(&window.blocks[window.base - base], window.blocks, keep * sizeof(storage_block_t));
+    read_blocks(base, window.blocks, window.base - base);
+  } else {
+    flush_window();
+    read_blocks(base, window.blocks, READ_BLOCKS_SIZE);
+  }
+  window.valid = true;
+  window.base = base;
+}
+
+// the block at 'idx', from the window if it holds it or can move on to it.
+void get_block(uint32_t idx, storage_block_t *block){
+  if (!in_window(idx) && window_floor != NO_FLOOR) move_window(window_floor);
+  if (in_window(idx)) *block = window.blocks[idx - window.base];
+  else read_blocks(idx, block, 1);
+}
+
+void put_block(uint32_t idx, storage_block_t *block){
+  if (!in_window(idx) && window_floor != NO_FLOOR) move_window(window_floor);
+  if (!in_window(idx)){
+    write_blocks(idx, block, 1);
+    return;
+  }
+  window.blocks[idx - window.base] = *block;
+  if (window.dirty_from == window.dirty_to){
+    window.dirty_from = idx;
+    window.dirty_to = idx + 1;
+  } else {
+    window.dirty_from = idx < window.dirty_from ? idx : window.dirty_from;
+    window.dirty_to = idx + 1 > window.dirty_to ? idx + 1 : window.dirty_to;
+  }
+}
+
+// copy the window's blocks not written back yet among the 'n' from 'idx' over 'blocks', read
+// from flash.
+void overlay_window(uint32_t idx, storage_block_t *blocks, uint32_t n){
+  uint32_t from = idx > window.dirty_from ? idx : window.dirty_from;
+  uint32_t to = idx + n < window.dirty_to ? idx + n : window.dirty_to;
+  if (from < to){
+    memcpy(&blocks[from - idx], &window.blocks[from - window.base], (to - from) * sizeof(storage_block_t));
+  }
 }
 
+// Where a delta sync batch is up to, between its frames.
+typedef struct {
+  bool active;                  // a batch is in progress
+  bool full;
+  uint16_t next_seq;
+  bool has_last;                // last_code is the code of the last record so far
+  access_code_t last_code;
+} delta_sync_t;
+
+delta_sync_t delta_sync;
+
 // moves all blocks underneath this address up one to maintain continuity.
 // it's possible block one is hashed to 100, and block 2 to 101. In this case
 // it is incorrect to shift block 2 just because block 1 is expired.
@@ -84,9 +231,115 @@ uint32_t hash(access_code_t access_code){
 // nevertheless, you keep going until you find an empty block, since some blocks
 // might still need shifting even if they're underneath an unshifted block.
 // therefore, you should store the last free / shiftable-to location.
+// the expiry wheel is told of every block that moves, so it keeps following them.
 void expire_block(uint32_t storage_block_idx){
-  // TODO
-  return;
+  uint32_t hole = storage_block_idx;
+  for (uint32_t idx = hole + 1; idx < TABLE_BLOCKS; idx++){
+    storage_block_t block;
+    get_block(idx, &block);
+    if (block.expiration == 0) break;
+    if (hash(block.access_code) <= hole){
+      put_block(hole, &block);
+      expiry_wheel_move(&expiry_wheel, idx, hole);
+      hole = idx;
+    }
+  }
+  storage_block_t empty = {0};
+  put_block(hole, &empty);
+}
+
+// Mount the expiry wheel. Call once at boot, before the functions below.
+bool reader_init(void){
+  return expiry_wheel_init(&expiry_wheel, EXPIRY_WHEEL_BASE, FLASH_MEMORY_SIZE - EXPIRY_WHEEL_BASE, TABLE_BLOCKS);
+}
+
+// Reclaim the blocks of every code that expired since the last call, in time proportional to
+// their number. Returns how many there were.
+uint32_t expire_access_codes(uint32_t current_time){
+  uint32_t expired = expiry_wheel_advance(&expiry_wheel, current_time, expire_block);
+  // in a batch, the window is written back as it moves on.
+  if (!delta_sync.active) flush_window();
+  return expired;
+}
+
+// Take the block at 'idx' out of the expiry wheel and the table.
+void remove_block(uint32_t idx){
+  expiry_wheel_remove(&expiry_wheel, idx);
+  expire_block(idx);
+}
+
+// The table holds its codes in increasing order: insert_block keeps each run of blocks in code
+// order, and hash() keeps the order of the codes, so a code is after every code of a smaller home
+// block. Walk it from block *idx, at or before where 'code' would be, to where 'code' is or would
+// go; return true if it is there. *idx ends at its block, or TABLE_BLOCKS if it has no room.
+// Codes up to 'after' (NULL: none) are passed over, and so are the others before 'code', unless
+// 'remove': a full batch removes the codes it does not list. A NULL 'code' walks to the end.
+bool seek_block(const uint8_t *code, const uint8_t *after, bool remove, uint32_t *idx){
+  uint32_t home = code == NULL ? TABLE_HASH_BLOCKS : hash(code);
+  while (*idx < TABLE_BLOCKS){
+    TRACE_COUNT("probes", 1);
+    // a code is never READ_BLOCKS_SIZE blocks or more from home.
+    if (code != NULL && *idx >= home + READ_BLOCKS_SIZE) break;
+    window_floor = *idx < home ? *idx : home;
+    storage_block_t block;
+    get_block(*idx, &block);
+    if (block.expiration == 0){
+      if (code != NULL && *idx >= home) return false;
+    } else {
+      int order = code == NULL ? -1 : memcmp(block.access_code, code, ACCESS_CODE_BYTES);
+      if (order >= 0) return order == 0;
+      if (remove && (after == NULL || memcmp(block.access_code, after, ACCESS_CODE_BYTES) > 0)){
+        // a block from further on may shift into this one.
+        remove_block(*idx);
+        continue;
+      }
+    }
+    (*idx)++;
+  }
+  *idx = TABLE_BLOCKS;
+  return false;
+}
+
+// Give the block at 'idx' a new expiration; if the wheel's clock is already past it, the code is
+// gone instead.
+void set_expiration(uint32_t idx, uint32_t expiration){
+  expiry_wheel_remove(&expiry_wheel, idx);
+  if (!expiry_wheel_insert(&expiry_wheel, idx, expiration)){
+    expire_block(idx);
+    return;
+  }
+  storage_block_t block;
+  get_block(idx, &block);
+  block.expiration = expiration;
+  put_block(idx, &block);
+}
+
+// Store a new 'code' at block 'idx', where seek_block found it goes, moving the blocks from there
+// up to the next empty one along by one. Kept in order, a code is never further from home than
+// the codes before it push it, so far more codes fit before one is pushed out of its
+// READ_BLOCKS_SIZE window than when each takes the first empty block. Return false if one would be.
+bool insert_block(uint32_t idx, const uint8_t *code, uint32_t expiration){
+  // expired by the wheel's clock already: nothing to store.
+  if (expiration < expiry_wheel.cursor) return true;
+  if (idx - hash(code) >= READ_BLOCKS_SIZE) return false;
+  storage_block_t block;
+  uint32_t last;
+  for (last = idx; last < TABLE_BLOCKS; last++){
+    get_block(last, &block);
+    if (block.expiration == 0) break;
+    if (last + 1 - hash(block.access_code) >= READ_BLOCKS_SIZE) return false;
+  }
+  if (last == TABLE_BLOCKS) return false;
+  for (uint32_t j = last; j > idx; j--){
+    get_block(j - 1, &block);
+    put_block(j, &block);
+    expiry_wheel_move(&expiry_wheel, j - 1, j);
+  }
+  block.expiration = expiration;
+  memcpy(block.access_code, code, ACCESS_CODE_BYTES);
+  expiry_wheel_insert(&expiry_wheel, idx, expiration);
+  put_block(idx, &block);
+  return true;
 }
 
 // Receive a wireless update with the access code.
@@ -109,50 +362,36 @@ void expire_block(uint32_t storage_block_idx){
 // what the flash memory looks like:
 // we use a "hash table with chaining" data structure, hashed by access_code.
 // [storage_block_t] [storage_block_t] [empty] [empty] [...] [storage_block_t]
-// ^ hashed by hash(access_code), and then placed in the next empty block.
+// ^ hashed by hash(access_code), and then placed in code order among the blocks
+// from there to the next empty block (see insert_block()).
 // any expired blocks potentially need their children to be shifted leftward
 // when they are removed so that continuity is maintained.
 // see expire_block() above for further notes.
+// every stored block is also in the expiry wheel, which finds the expired ones.
 void receive_access_code(uint32_t current_time, uint8_t *packet) {
-  // TODO: Implement this function.
   packet_t packet_parse;
   memcpy(&packet_parse, packet, sizeof(packet_t));
-  uint32_t storage_block_idx = hash(packet_parse.access_code);
 
-  if (packet_parse.door_id != MY_DOOR_ID || packet_parse.expiration < current_time){
+  // a code is valid only before its expiration, so one expiring now is never valid.
+  if (packet_parse.door_id != MY_DOOR_ID || packet_parse.expiration <= current_time){
     return;
   }
-
-  storage_block_t new_block;
-  new_block.expiration = packet_parse.expiration;
-  memcpy(&new_block.access_code, &packet_parse.access_code, ACCESS_CODE_BYTES);
-
-  storage_block_t storage_blocks [READ_BLOCKS_SIZE];
-  flash_read(storage_block_idx * sizeof(storage_block_t), (uint8_t *) &storage_blocks, 
-  READ_BLOCKS_SIZE * sizeof(storage_block_t));
-  for (int i = 0; i < READ_BLOCKS_SIZE; i++){
-    storage_block_t this_block; 
-    memcpy(&this_block, &storage_blocks[i], sizeof(storage_block_t));
-    if (this_block.expiration == 0){
-      // the new block can go here.
-      flash_write((storage_block_idx+i) * sizeof(storage_block_t), 
-      (uint8_t *) &new_block, sizeof(storage_block_t));
-      return;
-    }
-    if (memcmp(&this_block.access_code, &new_block.access_code, ACCESS_CODE_BYTES) == 0){
-      // this access code is already there; maybe needs updating expiry
-      if (this_block.expiration < new_block.expiration){
-        flash_write((storage_block_idx+i) * sizeof(storage_block_t), 
-        (uint8_t *) &new_block, sizeof(storage_block_t));
-      }
-      return;
-    } else if (current_time > this_block.expiration){
-      // expired
-      expire_block(storage_block_idx + i);
+  // free the blocks of expired codes first, so this one can take them.
+  expire_access_codes(current_time);
+
+  uint32_t idx = hash(packet_parse.access_code);
+  if (seek_block(packet_parse.access_code, NULL, false, &idx)){
+    // this access code is already there; maybe needs updating expiry
+    storage_block_t this_block;
+    get_block(idx, &this_block);
+    if (this_block.expiration < packet_parse.expiration){
+      set_expiration(idx, packet_parse.expiration);
     }
+  } else if (!insert_block(idx, packet_parse.access_code, packet_parse.expiration)){
+    printf("Failed to find space for new access code\n");
   }
-  printf("Failed to find space for new access code\n");
-  return;
+  window_floor = NO_FLOOR;
+  flush_window();
 }
 
 // Returns true if this access code is valid. The door will unlock.
@@ -160,16 +399,19 @@ void receive_access_code(uint32_t current_time, uint8_t *packet) {
 // The arguments to this function are:
 // * current_time: the current time, expressed in seconds since the Unix epoch.
 // * code: the access code to check, always of size ACCESS_CODE_BYTES.
+// Expired codes still stored are found and refused; expire_access_codes reclaims them.
+// In a delta sync batch, the blocks not written back yet are read from the window.
 bool unlock_door(uint32_t current_time, uint8_t *code) {
-  // TODO: Implement this function.
   access_code_t access_code;
   memcpy(&access_code, code, ACCESS_CODE_BYTES);
   uint32_t storage_block_idx = hash(access_code);
   storage_block_t storage_blocks [READ_BLOCKS_SIZE];
   flash_read(storage_block_idx * sizeof(storage_block_t), (uint8_t *) &storage_blocks, 
   READ_BLOCKS_SIZE * sizeof(storage_block_t));
+  overlay_window(storage_block_idx, storage_blocks, READ_BLOCKS_SIZE);
   int i = 0;
   while(i < READ_BLOCKS_SIZE){
+    TRACE_COUNT("probes", 1);
     storage_block_t this_block; 
     memcpy(&this_block, &storage_blocks[i], sizeof(storage_block_t));
     if (this_block.expiration == 0){
@@ -179,16 +421,273 @@ bool unlock_door(uint32_t current_time, uint8_t *code) {
     if (memcmp(this_block.access_code, access_code, ACCESS_CODE_BYTES) == 0){
       return current_time < this_block.expiration;
     }
-    if (current_time > this_block.expiration){
-      // expired
-      expire_block(storage_block_idx + i);
-    }
     i++;
   }
   return false;
 }
 
+// Walk on from the last code of the batch to 'record', removing the codes in between if the
+// batch is full, and apply it there.
+void apply_delta_record(uint32_t current_time, const delta_record_t *record){
+  const uint8_t *after = delta_sync.has_last ? delta_sync.last_code : NULL;
+  // a partial batch can start from the record's home block; a full one passes every code.
+  uint32_t idx = !delta_sync.full ? hash(record->code) : after == NULL ? 0 : hash(after);
+  bool found = seek_block(record->code, after, delta_sync.full, &idx);
+  memcpy(delta_sync.last_code, record->code, ACCESS_CODE_BYTES);
+  delta_sync.has_last = true;
+  // a code expiring now is never valid again, so it goes like a removed one.
+  if (record->op == DELTA_REMOVE || record->expiration <= current_time){
+    if (found) remove_block(idx);
+    return;
+  }
+  if (found){
+    storage_block_t block;
+    get_block(idx, &block);
+    if (block.expiration != record->expiration) set_expiration(idx, record->expiration);
+  } else if (record->op == DELTA_ADD && !insert_block(idx, record->code, record->expiration)){
+    printf("Failed to find space for new access code\n");
+  }
+}
+
+// For the last frame of a full batch: remove every code after the last one it listed.
+void remove_unlisted(void){
+  const uint8_t *after = delta_sync.has_last ? delta_sync.last_code : NULL;
+  uint32_t idx = after == NULL ? 0 : hash(after);
+  seek_block(NULL, after, true, &idx);
+}
+
+// Receive a frame of a delta sync batch (see delta_sync.h) of 'len' bytes.
+//
+// The batch is merged into the table in one pass: its records and the table's codes are both in
+// code order, so each record is found by walking on from the one before it, through the window,
+// which only moves forward and is written back as it does. A full batch removes the codes it
+// does not list as the walk passes them. A frame that fails its checksum is not applied at all;
+// one out of order is refused, and the batch must be sent again from seq 0, which is safe as
+// every record sets the table to a state rather than changing it.
+delta_status_t receive_delta_frame(uint32_t current_time, const uint8_t *frame, uint16_t len){
+  delta_frame_t reader;
+  if (!delta_frame_open(&reader, frame, len)) return DELTA_BAD_FRAME;
+  if (reader.door_id != MY_DOOR_ID) return DELTA_OTHER_DOOR;
+  bool full = reader.flags & DELTA_FULL;
+  if (reader.seq == 0){
+    delta_sync.active = true;
+    delta_sync.full = full;
+    delta_sync.next_seq = 0;
+    delta_sync.has_last = false;
+  } else if (!delta_sync.active || reader.seq != delta_sync.next_seq || full != delta_sync.full){
+    return DELTA_OUT_OF_ORDER;
+  }
+  TRACE_BEGIN("receive_delta_frame");
+  expire_access_codes(current_time);
+  delta_record_t record;
+  while (delta_frame_next(&reader, &record)){
+    apply_delta_record(current_time, &record);
+  }
+  bool last = reader.flags & DELTA_LAST;
+  if (full && last) remove_unlisted();
+  window_floor = NO_FLOOR;
+  delta_sync.next_seq++;
+  delta_sync.active = !last;
+  if (last) flush_window();
+  TRACE_END("receive_delta_frame");
+  return last ? DELTA_DONE : DELTA_OK;
+}
+
+// Number of codes and the span of expirations in the reclaim check in main. hash() takes the
+// leading bytes of a code, so codes with the same first byte share CHECK_HOMES runs of blocks,
+// and shift into each other's when they are reclaimed.
+#define CHECK_CODES 200
+#define CHECK_HOMES 50
+#define CHECK_SPAN 200000
+
+// Count the blocks in use, scanning the whole table: what expire_access_codes avoids.
+uint32_t count_blocks(void){
+  uint32_t used = 0;
+  for (uint32_t idx = 0; idx < TABLE_BLOCKS; idx += READ_BLOCKS_SIZE){
+    storage_block_t storage_blocks [READ_BLOCKS_SIZE];
+    uint32_t n = TABLE_BLOCKS - idx < READ_BLOCKS_SIZE ? TABLE_BLOCKS - idx : READ_BLOCKS_SIZE;
+    flash_read(idx * sizeof(storage_block_t), (uint8_t *) &storage_blocks, n * sizeof(storage_block_t));
+    overlay_window(idx, storage_blocks, n);
+    for (uint32_t i = 0; i < n; i++){
+      used += storage_blocks[i].expiration != 0;
+    }
+  }
+  return used;
+}
+
+// Codes in the delta sync check in main: a full list, and some more that come later.
+#define SYNC_CODES 20000
+#define SYNC_NEW 500
+#define SYNC_ALL (SYNC_CODES + SYNC_NEW)
+
+// the head-end's codes, sorted, and the expiration the reader should have for each (0: none).
+access_code_t sync_codes[SYNC_ALL];
+uint32_t sync_expirations[SYNC_ALL];
+
+// the head-end's radio in the check: hands each frame straight to the reader.
+typedef struct {
+  uint32_t current_time;
+  uint32_t frames;
+  uint32_t bytes;
+  bool ok;
+  uint16_t last_len;
+  uint8_t last[DELTA_FRAME_SIZE];  // the latest frame sent
+} radio_t;
+
+bool send_frame(const uint8_t *frame, uint16_t len, void *arg){
+  radio_t *radio = arg;
+  delta_status_t status = receive_delta_frame(radio->current_time, frame, len);
+  radio->frames++;
+  radio->bytes += len;
+  memcpy(radio->last, frame, len);
+  radio->last_len = len;
+  radio->ok = radio->ok && (status == DELTA_OK || status == DELTA_DONE);
+  return true;
+}
+
+// print the table's flash traffic since the last call, and start counting again.
+void print_table_ops(void){
+  printf("             table flash: %u reads of %u bytes, %u writes of %u bytes\n",
+    table_ops.reads, table_ops.read_bytes, table_ops.writes, table_ops.write_bytes);
+  table_ops = (flash_ops_t) {0};
+}
+
+int compare_codes(const void *a, const void *b){
+  return memcmp(a, b, ACCESS_CODE_BYTES);
+}
+
+// every code unlocks as sync_expirations says at 'current_time', and the table holds no others.
+bool check_sync_codes(uint32_t current_time){
+  bool ok = true;
+  uint32_t live = 0;
+  for (uint32_t i = 0; i < SYNC_ALL; i++){
+    ok = ok && unlock_door(current_time, sync_codes[i]) == (sync_expirations[i] > current_time);
+    live += sync_expirations[i] > current_time;
+  }
+  return ok && count_blocks() == live;
+}
+
+// Delta sync check: a full list of SYNC_CODES codes sent one packet a code, then as a full
+// batch; a batch of changes to it; and a full batch that leaves codes out. Returns true if the
+// table is as the head-end meant after each.
+bool check_delta_sync(uint32_t now){
+  uint32_t random = 2463534242u;
+  for (uint32_t i = 0; i < SYNC_ALL; i++){
+    for (uint32_t b = 0; b < ACCESS_CODE_BYTES; b++){
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      sync_codes[i][b] = random;
+    }
+  }
+  qsort(sync_codes, SYNC_ALL, sizeof(access_code_t), compare_codes);
+  // every (SYNC_ALL / SYNC_NEW)th code is one of the later ones.
+  for (uint32_t i = 0; i < SYNC_ALL; i++){
+    sync_expirations[i] = i % (SYNC_ALL / SYNC_NEW) == SYNC_ALL / SYNC_NEW - 1 ? 0 : now + 3600 + (i * 2654435761u) % (30 * 86400);
+  }
+
+  packet_t packet;
+  packet.door_id = MY_DOOR_ID;
+  packet.padding = 0;
+  table_ops = (flash_ops_t) {0};
+  for (uint32_t i = 0; i < SYNC_ALL; i++){
+    if (sync_expirations[i] == 0) continue;
+    memcpy(packet.access_code, sync_codes[i], ACCESS_CODE_BYTES);
+    packet.expiration = sync_expirations[i];
+    receive_access_code(now, (uint8_t *) &packet);
+  }
+  bool ok = check_sync_codes(now);
+  printf("packets:     %d codes in %d bytes, %d packets, %s\n", SYNC_CODES,
+    SYNC_CODES * UPDATE_SIZE_BYTES, SYNC_CODES, ok ? "ok" : "FAILED");
+  print_table_ops();
+
+  // an empty full batch clears the table; then the same codes again.
+  radio_t radio = { .current_time = now, .ok = true };
+  delta_writer_t writer;
+  delta_writer_init(&writer, MY_DOOR_ID, now, true, send_frame, &radio);
+  delta_writer_finish(&writer);
+  ok = ok && radio.ok && count_blocks() == 0;
+  table_ops = (flash_ops_t) {0};
+  radio = (radio_t) { .current_time = now, .ok = true };
+  delta_writer_init(&writer, MY_DOOR_ID, now, true, send_frame, &radio);
+  for (uint32_t i = 0; i < SYNC_ALL; i++){
+    if (sync_expirations[i] == 0) continue;
+    delta_record_t record = { .op = DELTA_ADD, .expiration = sync_expirations[i] };
+    memcpy(record.code, sync_codes[i], ACCESS_CODE_BYTES);
+    delta_writer_add(&writer, &record);
+  }
+  delta_writer_finish(&writer);
+  bool full_ok = radio.ok && check_sync_codes(now);
+  printf("full batch:  %d codes in %u bytes, %u frames (%.1f bytes a code), %s\n",
+    SYNC_CODES, radio.bytes, radio.frames, (double) radio.bytes / SYNC_CODES, full_ok ? "ok" : "FAILED");
+  print_table_ops();
+  ok = ok && full_ok;
+
+  // changes: the later codes added, every 10th removed, every 10th but one expiring in a minute.
+  radio = (radio_t) { .current_time = now, .ok = true };
+  delta_writer_init(&writer, MY_DOOR_ID, now, false, send_frame, &radio);
+  for (uint32_t i = 0; i < SYNC_ALL; i++){
+    delta_record_t record = { .op = DELTA_ADD, .expiration = now + 86400 };
+    if (sync_expirations[i] == 0) sync_expirations[i] = record.expiration;
+    else if (i % 10 == 0) record.op = DELTA_REMOVE, sync_expirations[i] = 0;
+    else if (i % 10 == 1) record.op = DELTA_EXPIRY, record.expiration = sync_expirations[i] = now + 60;
+    else continue;
+    memcpy(record.code, sync_codes[i], ACCESS_CODE_BYTES);
+    delta_writer_add(&writer, &record);
+  }
+  delta_writer_finish(&writer);
+  bool changes_ok = radio.ok && check_sync_codes(now);
+  printf("changes:     %u bytes, %u frames, %s\n", radio.bytes, radio.frames, changes_ok ? "ok" : "FAILED");
+  print_table_ops();
+  // the expiry wheel reclaims codes as they expire, wherever they are in the table, a block at a
+  // time: counted apart from the batches, which merge in one pass.
+  uint32_t reclaimed = expire_access_codes(now + 60);
+  changes_ok = changes_ok && check_sync_codes(now + 60);
+  ok = ok && changes_ok;
+  reclaimed += expire_access_codes(now + 86400 - 1);
+  printf("reclaim:     %u codes as they expired\n", reclaimed);
+  print_table_ops();
+
+  // a full resync a day on that leaves every 10th but two out, with a frame sent twice and
+  // one corrupted on the way, both of which the reader refuses. Halfway, the codes merged so far
+  // unlock as they should, before the window holding the latest of them is written back.
+  now += 86400 - 1;
+  radio = (radio_t) { .current_time = now, .ok = true };
+  bool refused = false, halfway_ok = true;
+  delta_writer_init(&writer, MY_DOOR_ID, now, true, send_frame, &radio);
+  for (uint32_t i = 0; i < SYNC_ALL; i++){
+    if (i == SYNC_ALL / 2){
+      // the codes of the frame being filled are not sent yet.
+      for (uint32_t j = 0; j + 2 * DELTA_FRAME_SIZE / ACCESS_CODE_BYTES < i; j++){
+        halfway_ok = halfway_ok && unlock_door(now, sync_codes[j]) == (sync_expirations[j] > now);
+      }
+    }
+    if (sync_expirations[i] <= now) continue;
+    if (i % 10 == 2){
+      sync_expirations[i] = 0;
+      continue;
+    }
+    delta_record_t record = { .op = DELTA_ADD, .expiration = sync_expirations[i] };
+    memcpy(record.code, sync_codes[i], ACCESS_CODE_BYTES);
+    delta_writer_add(&writer, &record);
+    if (radio.frames == 10 && !refused){
+      refused = receive_delta_frame(now, radio.last, radio.last_len) == DELTA_OUT_OF_ORDER;
+      radio.last[DELTA_HEADER_SIZE] ^= 1;
+      refused = refused && receive_delta_frame(now, radio.last, radio.last_len) == DELTA_BAD_FRAME;
+    }
+  }
+  delta_writer_finish(&writer);
+  bool resync_ok = radio.ok && refused && halfway_ok && check_sync_codes(now);
+  printf("resync:      %u bytes, %u frames, %s\n", radio.bytes, radio.frames, resync_ok ? "ok" : "FAILED");
+  print_table_ops();
+  return ok && resync_ok;
+}
+
 int main(void) {
+  if (!reader_init()){
+    printf("expiry wheel does not fit in flash\n");
+    return 1;
+  }
   access_code_t access_code = {0};
   access_code[0] = 100;
 
@@ -206,6 +705,46 @@ int main(void) {
   // not present
   printf("unlock_door not present: %d\n", unlock_door(100, (uint8_t *) &access_code));
 
+  // the code above expired at 1000 and is reclaimed by the first update. Then many codes, with
+  // expirations spread from seconds to days ahead, some renewed, and time moves on in steps
+  // growing from 1 second to a day: every step should reclaim exactly the codes that expired
+  // in it, and leave the others unlocking.
+  uint32_t start = 1000;
+  uint32_t expirations[CHECK_CODES];
+  for (uint32_t i = 0; i < CHECK_CODES; i++){
+    packet.access_code[0] = i % CHECK_HOMES * 5;
+    packet.access_code[1] = i / CHECK_HOMES + 1;
+    packet.expiration = start + 1 + (i * 2654435761u) % CHECK_SPAN;
+    receive_access_code(start, (uint8_t *) &packet);
+    if (i % 3 == 0){
+      packet.expiration += 1000;
+      receive_access_code(start, (uint8_t *) &packet);
+    }
+    expirations[i] = packet.expiration;
+  }
+  uint32_t now = start, reclaimed = 0;
+  bool ok = count_blocks() == CHECK_CODES;
+  for (uint32_t step = 1; now < start + 2 * CHECK_SPAN; step = step < 86400 ? 2 * step : step){
+    uint32_t expected = 0, live = 0;
+    for (uint32_t i = 0; i < CHECK_CODES; i++){
+      expected += expirations[i] > now && expirations[i] <= now + step;
+      live += expirations[i] > now + step;
+    }
+    now += step;
+    uint32_t expired = expire_access_codes(now);
+    reclaimed += expired;
+    ok = ok && expired == expected && count_blocks() == live;
+    for (uint32_t i = 0; i < CHECK_CODES; i++){
+      packet.access_code[0] = i % CHECK_HOMES * 5;
+      packet.access_code[1] = i / CHECK_HOMES + 1;
+      ok = ok && unlock_door(now, packet.access_code) == (expirations[i] > now);
+    }
+  }
+  printf("expiry: %d codes, %u reclaimed as they expired, table empty after: %d, %s\n",
+    CHECK_CODES, reclaimed, count_blocks() == 0, ok ? "ok" : "FAILED");
+
+  ok = check_delta_sync(now) && ok;
+  return ok ? 0 : 1;
 }
 
 
@@ -215,7 +754,7 @@ memory of the disk
 there are 20k access codes
 you hash the access code modulo the size of the flash.
 you put it in the next available space.
-you evict anything that is expired.
+the expiry wheel evicts what has expired as time moves on.
 this requires shifting everything upwards.
 
 receive_access_code:
@@ -225,19 +764,14 @@ go to that memory address
 while this block is not empty:
   if access_code is me:
     update expiry
-  else if is expired:
-    expire_block(address)
 store access code with expiry in the next available spot.
 
 On unlock_door:
 hash the access code
 go to that memory address
 while this block is not empty:
-  if block is not expired
-    if access_code is me:
-      return true
-  else
-    expire_block(address)
+  if access_code is me:
+    return true if not expired
 return false
 */
 
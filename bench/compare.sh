@@ -0,0 +1,82 @@
+#!/bin/sh
+# Compares benchmark results (bench/run.sh) against a baseline and flags every metric that got
+# worse by more than the threshold, in the direction the metric's unit says is better. Metrics
+# that are not timings, rates or sizes, ones missing from either file, and times under 10 ms on
+# both sides (a tick or two of clock()) are not compared. Exits 1 if there is a regression or a
+# benchmark failed.
+#
+# Timings on a shared or busy machine move by more than 10% from run to run: compare runs from
+# the same quiet machine, or raise the threshold.
+#
+# usage: bench/compare.sh baseline.json results.json [threshold percent, default 10]
+
+set -u
+if [ $# -lt 2 ]; then
+    echo "usage: $0 baseline.json results.json [threshold percent]" >&2
+    exit 2
+fi
+awk -v threshold="${3:-10}" '
+# the value of "key" in a line of run.sh output: a string without its quotes, or a number.
+function field(line, key,    i, rest, value){
+    i = index(line, "\"" key "\": ")
+    if (i == 0) return ""
+    rest = substr(line, i + length(key) + 4)
+    if (substr(rest, 1, 1) != "\"") {
+        sub(/[,}].*$/, "", rest)
+        return rest
+    }
+    value = ""
+    for (i = 2; i <= length(rest); i++){
+        c = substr(rest, i, 1)
+        if (c == "\\") { value = value substr(rest, i + 1, 1); i++; continue }
+        if (c == "\"") break
+        value = value c
+    }
+    return value
+}
+
+FNR == 1 { file++ }
+
+/"status": / {
+    if (file == 2 && field($0, "status") != 0){
+        printf "FAILED      %s exited with status %s\n", field($0, "bench"), field($0, "status")
+        failures++
+    }
+    next
+}
+
+/"name": / {
+    key = field($0, "bench") " | " field($0, "name")
+    if (file == 1){
+        base[key] = field($0, "value")
+        next
+    }
+    better = field($0, "better")
+    if (better == "none") next
+    if (!(key in base)){
+        missing++
+        next
+    }
+    old = base[key] + 0
+    new = field($0, "value") + 0
+    unit = field($0, "unit")
+    if ((unit == "s" && old < 0.01 && new < 0.01) || (unit == "ms" && old < 10 && new < 10)) next
+    compared++
+    if (old == 0) next
+    change = 100 * (new - old) / old
+    worse = better == "higher" ? -change : change
+    if (worse > threshold){
+        printf "REGRESSION  %s: %s -> %s %s (%+.1f%%)\n", key, base[key], field($0, "value"), unit, change
+        regressions++
+    } else if (worse < -threshold) {
+        printf "improved    %s: %s -> %s %s (%+.1f%%)\n", key, base[key], field($0, "value"), unit, change
+        improvements++
+    }
+}
+
+END {
+    printf "%d metrics compared, %d regressions and %d improvements beyond %s%%, %d not in the baseline, %d benchmarks failed\n",
+        compared, regressions, improvements, threshold, missing, failures
+    exit (regressions > 0 || failures > 0) ? 1 : 0
+}
+' "$1" "$2"
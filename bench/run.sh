@@ -0,0 +1,62 @@
+#!/bin/sh
+# Runs every subsystem's benchmark and writes their metrics to one JSON file (see to_json.awk).
+# Each benchmark is built from clean with $CC and $CFLAGS, as the top-level Makefile sets them.
+#
+# usage, from the top of the repo: bench/run.sh [results.json]    (make bench does this)
+
+set -u
+out=${1:-bench/results.json}
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:--O2 -std=c99 -pedantic -Wall}
+top=$(pwd)
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# name, directory, command. 'build' is make with the flags above.
+BENCHES='
+state_bench          state_controller  build state_bench
+state_gen_bench      state_controller  build state_gen_bench && ./state_gen_bench
+path_codec           state_controller  build path_codec_demo && ./path_codec_demo
+path_log             state_controller  build path_log_demo && ./path_log_demo
+sort_bench           sort              build sort_bench
+tree_bench           trees             build tree_bench
+tree_parallel_bench  trees             build tree_parallel_bench && ./tree_parallel_bench
+serializer_bench     trees             build serializer_bench
+'
+
+build(){
+    make -s CC="$CC" CFLAGS="$CFLAGS" BENCH_CFLAGS="$CFLAGS -D BENCH" "$@"
+}
+
+: > "$tmp/benches"
+: > "$tmp/metrics"
+echo "$BENCHES" | while read -r name dir command; do
+    [ -z "$name" ] && continue
+    echo "== $name ($dir: $command)"
+    start=$(date +%s)
+    (cd "$top/$dir" && make -s clean > /dev/null && eval "$command") > "$tmp/$name.txt" 2>&1
+    status=$?
+    seconds=$(( $(date +%s) - start ))
+    cat "$tmp/$name.txt"
+    (cd "$top/$dir" && make -s clean > /dev/null)
+    echo "{\"bench\": \"$name\", \"status\": $status, \"seconds\": $seconds}" >> "$tmp/benches"
+    awk -v bench="$name" -f "$top/bench/to_json.awk" "$tmp/$name.txt" >> "$tmp/metrics"
+    [ $status -ne 0 ] && echo "== $name FAILED with status $status"
+done
+
+{
+    echo "{"
+    echo "\"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\","
+    echo "\"machine\": \"$(uname -sm)\","
+    echo "\"cc\": \"$($CC --version | head -n 1)\","
+    echo "\"cflags\": \"$CFLAGS\","
+    echo "\"benches\": ["
+    sed '$!s/$/,/' "$tmp/benches"
+    echo "],"
+    echo "\"metrics\": ["
+    sed '$!s/$/,/' "$tmp/metrics"
+    echo "]"
+    echo "}"
+} > "$out"
+echo "== wrote $(wc -l < "$tmp/metrics") metrics of $(wc -l < "$tmp/benches") benchmarks to $out"
+! grep -q '"status": [1-9]' "$tmp/benches"
@@ -0,0 +1,98 @@
+# Turns a benchmark's text output into JSON metrics, one object per line:
+#   {"bench": "...", "name": "...", "value": 12.3, "unit": "...", "better": "higher"}
+#
+# usage: awk -v bench=NAME -f to_json.awk output.txt
+#
+# Every number a line prints is a metric, but for whole numbers in the label before its first
+# ':' ("implementation 4, example:", "8 threads:"), which name the line. A metric's name is
+# the line with the other numbers replaced by #, then "#i" for the i'th number. An indented line is named under the last line that was not,
+# and a name seen again gets " (2)", " (3)", ... so repeated blocks stay apart. The unit is
+# what follows the number ("12.3 ns/path", "0.905s", "18.6 M states/s"); in a table, where only
+# numbers follow, it is the header text above the number's column. The unit decides whether a
+# higher or lower value is better, or neither (counts, sizes of the input).
+# Plain POSIX awk, so it runs on busybox too.
+
+function trim(s){
+    sub(/^[ \t(]+/, "", s)
+    sub(/[ \t,;:)]+$/, "", s)
+    return s
+}
+
+function is_number(t){
+    return t ~ /^-?[0-9]+(\.[0-9]+)?$/
+}
+
+function better(unit){
+    if (unit ~ /\/s$/ || unit == "x") return "higher"
+    if (unit ~ /^(ns|us|ms|s)(\/|$)/) return "lower"
+    if (unit ~ /^(bytes|bits)/ || unit ~ /MB$/) return "lower"
+    return "none"
+}
+
+function json(s){
+    gsub(/\\/, "\\\\", s)
+    gsub(/"/, "\\\"", s)
+    return "\"" s "\""
+}
+
+{
+    line = $0
+    if (line !~ /[0-9]/){
+        if (NF >= 3) header = line        # a table header, for the rows that follow
+        next
+    }
+    # split the line into tokens, remembering where each ends for the table header lookup.
+    n = 0
+    rest = line
+    offset = 0
+    while (match(rest, /[^ \t]+/)){
+        n++
+        token[n] = substr(rest, RSTART, RLENGTH)
+        end_col[n] = offset + RSTART + RLENGTH - 1
+        offset += RSTART + RLENGTH - 1
+        rest = substr(rest, RSTART + RLENGTH)
+    }
+
+    # template: numbers that start a token become #, but for the label's.
+    colon = index(line, ":")
+    template = ""
+    for (i = 1; i <= n; i++){
+        t = token[i]
+        label[i] = colon > 0 && end_col[i] < colon && t ~ /^[0-9]+,?$/
+        if (!label[i] && t ~ /^\(?-?[0-9]/) sub(/-?[0-9]+(\.[0-9]+)?/, "#", t)
+        template = template (i > 1 ? " " : "") t
+    }
+    indented = line ~ /^[ \t]/
+    if (!indented) parent = template
+    name = indented ? parent " / " template : template
+    seen[name]++
+    if (seen[name] > 1) name = name " (" seen[name] ")"
+
+    count = 0
+    previous_end = 0
+    for (i = 1; i <= n; i++){
+        t = trim(token[i])
+        if (t !~ /^-?[0-9]/ || label[i]){
+            previous_end = end_col[i]
+            continue
+        }
+        value = t
+        sub(/[^0-9.\-].*$/, "", value)
+        suffix = substr(t, length(value) + 1)
+        if (!is_number(value)){
+            previous_end = end_col[i]
+            continue
+        }
+        count++
+        if (suffix != "") unit = suffix
+        else if (i > 1 && trim(token[i-1]) == "speedup") unit = "x"
+        else if (i < n && !is_number(trim(token[i+1]))){
+            unit = trim(token[i+1])
+            if (unit ~ /^[KMG]$/ && i + 1 < n) unit = unit " " trim(token[i+2])
+        } else if (header != "" && !indented) unit = trim(substr(header, previous_end + 1, end_col[i] - previous_end))
+        else unit = ""
+        printf "{\"bench\": %s, \"name\": %s, \"value\": %s, \"unit\": %s, \"better\": %s}\n",
+            json(bench), json(name " #" count), value, json(unit), json(better(unit))
+        previous_end = end_col[i]
+    }
+}
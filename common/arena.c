@@ -0,0 +1,117 @@
+#include "arena.h"
+
+#include "stdlib.h"
+#include "string.h"
+
+#ifdef ARENA_POISON
+#define POISON(p, byte, size) memset(p, byte, size)
+#else
+#define POISON(p, byte, size) ((void) 0)
+#endif
+
+// bytes from 'address' up to the next multiple of 'align'.
+static size_t padding(uintptr_t address, size_t align){
+    return (align - (address & (align - 1))) & (align - 1);
+}
+
+void arena_init(arena_t *arena, void *buf, size_t size){
+    arena->base = buf;
+    arena->size = size;
+    arena->used = 0;
+    arena->last = 0;
+    arena->owned = NULL;
+    POISON(buf, ARENA_FREED, size);
+}
+
+bool arena_create(arena_t *arena, size_t size){
+    void *buf = malloc(size);
+    if (buf == NULL) return false;
+    arena_init(arena, buf, size);
+    arena->owned = buf;
+    return true;
+}
+
+void arena_destroy(arena_t *arena){
+    free(arena->owned);
+    memset(arena, 0, sizeof(arena_t));
+}
+
+void *arena_alloc(arena_t *arena, size_t size, size_t align){
+    size_t start = arena->used + padding((uintptr_t) arena->base + arena->used, align);
+    if (start > arena->size || size > arena->size - start) return NULL;
+    arena->last = start;
+    arena->used = start + size;
+    POISON(arena->base + start, ARENA_FRESH, size);
+    return arena->base + start;
+}
+
+bool arena_grow(arena_t *arena, void *p, size_t size){
+    if ((uint8_t *) p != arena->base + arena->last || size > arena->size - arena->last) return false;
+    size_t end = arena->last + size;
+    if (end > arena->used) POISON(arena->base + arena->used, ARENA_FRESH, end - arena->used);
+    else POISON(arena->base + end, ARENA_FREED, arena->used - end);
+    arena->used = end;
+    return true;
+}
+
+void arena_release(arena_t *arena, size_t mark){
+    if (mark >= arena->used) return;
+    POISON(arena->base + mark, ARENA_FREED, arena->used - mark);
+    arena->used = mark;
+    // arena_grow needs the latest allocation, which is gone; none can grow until the next.
+    arena->last = arena->size;
+}
+
+void arena_reset(arena_t *arena){
+    arena_release(arena, 0);
+}
+
+// blocks hold the free list link, and every one starts aligned.
+static size_t block_stride(size_t block_size, size_t align){
+    if (align < sizeof(void *)) align = sizeof(void *);
+    if (block_size < sizeof(void *)) block_size = sizeof(void *);
+    return block_size + padding(block_size, align);
+}
+
+size_t block_pool_bytes(size_t num_blocks, size_t block_size, size_t align){
+    return num_blocks * block_stride(block_size, align) + (align - 1);
+}
+
+bool block_pool_init(block_pool_t *pool, void *buf, size_t size, size_t block_size, size_t align){
+    size_t skip = padding((uintptr_t) buf, align);
+    pool->block_size = block_stride(block_size, align);
+    pool->base = (uint8_t *) buf + skip;
+    pool->num_blocks = size < skip ? 0 : (size - skip) / pool->block_size;
+    block_pool_reset(pool);
+    return pool->num_blocks > 0;
+}
+
+void *block_pool_alloc(block_pool_t *pool){
+    void *block = pool->free_list;
+    if (block != NULL){
+        memcpy(&pool->free_list, block, sizeof(void *));
+        POISON(block, ARENA_FRESH, pool->block_size);
+        return block;
+    }
+    return block_pool_alloc_run(pool, 1);
+}
+
+void *block_pool_alloc_run(block_pool_t *pool, size_t n){
+    if (pool->num_blocks - pool->carved < n) return NULL;
+    void *blocks = pool->base + pool->carved * pool->block_size;
+    pool->carved += n;
+    POISON(blocks, ARENA_FRESH, n * pool->block_size);
+    return blocks;
+}
+
+void block_pool_free(block_pool_t *pool, void *block){
+    POISON(block, ARENA_FREED, pool->block_size);
+    memcpy(block, &pool->free_list, sizeof(void *));
+    pool->free_list = block;
+}
+
+void block_pool_reset(block_pool_t *pool){
+    pool->carved = 0;
+    pool->free_list = NULL;
+    POISON(pool->base, ARENA_FREED, pool->num_blocks * pool->block_size);
+}
@@ -0,0 +1,88 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+// Allocators over one block of memory, for code that must not call malloc on its hot paths, or
+// at all: the block can be the caller's (a static array, a stack buffer, a region of SRAM), or
+// one malloc up front.
+//
+// arena_t hands out memory in order and takes it back all at once, or back to a mark: the
+// scratch space of one call, or everything built for one request. block_pool_t hands out
+// blocks of one size and takes them back one by one, for nodes and records that come and go.
+//
+// Built with ARENA_POISON defined (make debug does), memory is filled with ARENA_FRESH when
+// handed out and ARENA_FREED when taken back, so reads of memory never written, or already
+// given back, show up as those bytes rather than as plausible old values.
+
+#define ARENA_FRESH 0xCD
+#define ARENA_FREED 0xDD
+
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t last;                 // offset of the latest allocation, for arena_grow
+    void *owned;                 // from arena_create, freed by arena_destroy
+} arena_t;
+
+// an arena over the caller's 'size' bytes at 'buf'.
+void arena_init(arena_t *arena, void *buf, size_t size);
+
+// an arena over 'size' bytes of its own, from one malloc. return false if it fails.
+bool arena_create(arena_t *arena, size_t size);
+
+void arena_destroy(arena_t *arena);
+
+/* arena_alloc
+ * 'size' bytes aligned to 'align', a power of 2. return NULL if the arena cannot fit them.
+*/
+void *arena_alloc(arena_t *arena, size_t size, size_t align);
+
+/* arena_grow
+ * grow or shrink 'p', the latest allocation, in place to 'size' bytes.
+ * return false, leaving it as it was, if 'p' is not the latest or the arena cannot fit it.
+*/
+bool arena_grow(arena_t *arena, void *p, size_t size);
+
+// the arena's position, to give back everything allocated after it with arena_release.
+static inline size_t arena_mark(const arena_t *arena){
+    return arena->used;
+}
+
+void arena_release(arena_t *arena, size_t mark);
+
+void arena_reset(arena_t *arena);
+
+typedef struct {
+    uint8_t *base;
+    size_t block_size;
+    size_t num_blocks;
+    size_t carved;               // blocks ever handed out from the end; the rest were never used
+    void *free_list;             // given back, linked through their first bytes
+} block_pool_t;
+
+/* block_pool_init
+ * a pool of blocks of 'block_size' bytes aligned to 'align' (a power of 2), in the caller's
+ * 'size' bytes at 'buf'. Blocks are rounded up to the alignment and to hold a pointer.
+ * return false if not one block fits.
+*/
+bool block_pool_init(block_pool_t *pool, void *buf, size_t size, size_t block_size, size_t align);
+
+// bytes block_pool_init needs for 'num_blocks' blocks, wherever the buffer starts.
+size_t block_pool_bytes(size_t num_blocks, size_t block_size, size_t align);
+
+// a block, given back ones first. return NULL if the pool is empty.
+void *block_pool_alloc(block_pool_t *pool);
+
+// 'n' consecutive blocks from the never used end of the pool, or NULL if too few are left.
+void *block_pool_alloc_run(block_pool_t *pool, size_t n);
+
+void block_pool_free(block_pool_t *pool, void *block);
+
+// take back every block at once.
+void block_pool_reset(block_pool_t *pool);
+
+#endif  // ARENA_H_
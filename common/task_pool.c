@@ -0,0 +1,246 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "task_pool.h"
+
+#include "sched.h"
+#include "stdlib.h"
+
+#include "trace.h"
+
+// the worker this thread is, while it runs in a pool; NULL outside any.
+static __thread task_worker_t *this_worker;
+
+static task_worker_t *pool_worker(task_pool_t *pool){
+    return this_worker != NULL && this_worker->pool == pool ? this_worker : NULL;
+}
+
+// Chase-Lev deque, after Le, Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing
+// for Weak Memory Models" (2013), with a fixed capacity, and seq_cst loads and stores of top and
+// bottom where the paper has seq_cst fences. Task fields are loaded and stored one by one,
+// atomically: a thief may read a slot the owner is reusing, but then its CAS on top fails.
+
+static void store_task(task_t *slot, const task_t *task){
+    __atomic_store_n(&slot->fn, task->fn, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->arg, task->arg, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->group, task->group, __ATOMIC_RELAXED);
+}
+
+static void load_task(task_t *slot, task_t *task){
+    task->fn = __atomic_load_n(&slot->fn, __ATOMIC_RELAXED);
+    task->arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+    task->group = __atomic_load_n(&slot->group, __ATOMIC_RELAXED);
+}
+
+// owner only. return false if the deque is full.
+static bool deque_push(task_deque_t *deque, const task_t *task){
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= TASK_DEQUE_SIZE) return false;
+    store_task(&deque->tasks[bottom & (TASK_DEQUE_SIZE - 1)], task);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// owner only: the newest task. return false if there is none.
+static bool deque_take(task_deque_t *deque, task_t *task){
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+    if (top > bottom){
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    load_task(&deque->tasks[bottom & (TASK_DEQUE_SIZE - 1)], task);
+    if (top == bottom){
+        // the last task: race the thieves for it.
+        bool won = __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+// any thread: the oldest task. return false if there is none, or another thread got it first.
+static bool deque_steal(task_deque_t *deque, task_t *task){
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST);
+    if (top >= bottom) return false;
+    load_task(&deque->tasks[top & (TASK_DEQUE_SIZE - 1)], task);
+    return __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static void run_task(task_pool_t *pool, const task_t *task){
+    task->fn(pool, task->arg);
+    __atomic_fetch_sub(&task->group->pending, 1, __ATOMIC_RELEASE);
+}
+
+// run one task: this worker's newest, else one stolen from a random other worker.
+// return false if no worker had one.
+static bool run_one(task_worker_t *worker){
+    task_pool_t *pool = worker->pool;
+    task_t task;
+    if (deque_take(&worker->deque, &task)){
+        run_task(pool, &task);
+        return true;
+    }
+    // xorshift, then try every other worker once, from a random one on.
+    worker->random ^= worker->random << 13;
+    worker->random ^= worker->random >> 17;
+    worker->random ^= worker->random << 5;
+    for (int i = 0; i < pool->num_threads; i++){
+        int victim = (worker->random + i) % pool->num_threads;
+        if (victim == worker->index) continue;
+        if (deque_steal(&pool->workers[victim].deque, &task)){
+            TRACE_COUNT("tasks stolen", 1);
+            run_task(pool, &task);
+            return true;
+        }
+    }
+    return false;
+}
+
+// workers 1 on: steal while a task_pool_run is in progress, sleep while none is.
+static void *worker_main(void *arg){
+    task_worker_t *worker = arg;
+    task_pool_t *pool = worker->pool;
+    this_worker = worker;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping){
+        if (!__atomic_load_n(&pool->running, __ATOMIC_RELAXED)){
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        while (__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)){
+            if (!run_one(worker)) sched_yield();
+        }
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+bool task_pool_init(task_pool_t *pool, int num_threads){
+    pool->num_threads = num_threads < 1 ? 1 : num_threads;
+    pool->running = false;
+    pool->stopping = false;
+    pool->workers = calloc(pool->num_threads, sizeof(task_worker_t));
+    task_t *tasks = calloc((size_t) pool->num_threads * TASK_DEQUE_SIZE, sizeof(task_t));
+    if (pool->workers == NULL || tasks == NULL){
+        free(pool->workers);
+        free(tasks);
+        return false;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_mutex_init(&pool->run_lock, NULL);
+    for (int i = 0; i < pool->num_threads; i++){
+        task_worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->random = 2654435761u * (i + 1);
+        worker->deque.tasks = &tasks[(size_t) i * TASK_DEQUE_SIZE];
+    }
+    for (int i = 1; i < pool->num_threads; i++){
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0){
+            pool->num_threads = i;  // stop the ones started, and only those
+            task_pool_destroy(pool);
+            return false;
+        }
+    }
+    return true;
+}
+
+void task_pool_destroy(task_pool_t *pool){
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->num_threads; i++){
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    free(pool->workers[0].deque.tasks);
+    free(pool->workers);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->run_lock);
+}
+
+void task_pool_run(task_pool_t *pool, task_fn_t fn, void *arg){
+    pthread_mutex_lock(&pool->run_lock);
+    task_worker_t *outer = this_worker;  // a task of another pool may call into this one
+    this_worker = &pool->workers[0];
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->running, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    fn(pool, arg);
+
+    // fn joined everything it spawned, so every deque is empty again.
+    __atomic_store_n(&pool->running, false, __ATOMIC_RELEASE);
+    this_worker = outer;
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+void task_spawn(task_pool_t *pool, task_group_t *group, task_fn_t fn, void *arg){
+    task_worker_t *worker = pool_worker(pool);
+    task_t task = { .fn = fn, .arg = arg, .group = group };
+    __atomic_fetch_add(&group->pending, 1, __ATOMIC_RELAXED);
+    // outside the pool, or with the deque full, the spawner runs it now.
+    if (worker == NULL || !deque_push(&worker->deque, &task)) run_task(pool, &task);
+}
+
+void task_wait(task_pool_t *pool, task_group_t *group){
+    task_worker_t *worker = pool_worker(pool);
+    while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) != 0){
+        if (worker == NULL || !run_one(worker)) sched_yield();
+    }
+}
+
+typedef struct {
+    task_fn_t a, b;
+    void *a_arg, *b_arg;
+} fork_join_t;
+
+static void fork_join_task(task_pool_t *pool, void *arg){
+    fork_join_t *fork = arg;
+    task_group_t group = { 0 };
+    task_spawn(pool, &group, fork->b, fork->b_arg);
+    fork->a(pool, fork->a_arg);
+    task_wait(pool, &group);
+}
+
+void task_fork_join(task_pool_t *pool, task_fn_t a, void *a_arg, task_fn_t b, void *b_arg){
+    fork_join_t fork = { .a = a, .b = b, .a_arg = a_arg, .b_arg = b_arg };
+    if (pool_worker(pool) != NULL) fork_join_task(pool, &fork);
+    else task_pool_run(pool, fork_join_task, &fork);
+}
+
+typedef struct {
+    long begin, end, grain;
+    task_range_fn_t fn;
+    void *arg;
+} range_t;
+
+// halve the range until it fits the grain. the halves live on this stack frame, which
+// outlasts them since it waits for both.
+static void range_task(task_pool_t *pool, void *arg){
+    range_t *range = arg;
+    if (range->end - range->begin <= range->grain){
+        range->fn(pool, range->begin, range->end, range->arg);
+        return;
+    }
+    long middle = range->begin + (range->end - range->begin) / 2;
+    range_t low = *range, high = *range;
+    low.end = middle;
+    high.begin = middle;
+    fork_join_task(pool, &(fork_join_t) { .a = range_task, .a_arg = &low, .b = range_task, .b_arg = &high });
+}
+
+void task_parallel_for(task_pool_t *pool, long begin, long end, long grain, task_range_fn_t fn, void *arg){
+    if (begin >= end) return;
+    range_t range = { .begin = begin, .end = end, .grain = grain < 1 ? 1 : grain, .fn = fn, .arg = arg };
+    if (pool_worker(pool) != NULL) range_task(pool, &range);
+    else task_pool_run(pool, range_task, &range);
+}
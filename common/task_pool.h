@@ -0,0 +1,99 @@
+#ifndef TASK_POOL_H_
+#define TASK_POOL_H_
+
+#include "pthread.h"
+#include "stdbool.h"
+#include "stdint.h"
+
+// Work-stealing pool for divide and conquer: a task forks smaller tasks and joins them.
+//
+// Every worker thread has a Chase-Lev deque of tasks. A worker pushes the tasks it spawns onto
+// the bottom of its own deque and takes them back from the bottom, newest first, so it walks
+// its own work depth first and stays in cache. An idle worker steals from the top of another
+// worker's deque: the oldest task, which in divide and conquer is the biggest piece. Only a
+// steal takes a compare and swap; push and take are plain stores except when the deque is down
+// to its last task.
+//
+// A worker waiting on a join runs other tasks until the join is done, so no thread blocks
+// while there is work, and the pool never needs more threads than cores.
+//
+// The thread calling task_pool_run (or the helpers below from outside the pool) is worker 0
+// for the call, and the pool's other threads sleep between calls. Tasks past the per-worker
+// deque capacity run at once, inline, in the spawning task.
+
+#define TASK_DEQUE_SIZE 1024             // tasks per worker, a power of 2
+
+typedef struct task_pool task_pool_t;
+
+typedef void (*task_fn_t)(task_pool_t *pool, void *arg);
+// run the items [begin, end) of a task_parallel_for.
+typedef void (*task_range_fn_t)(task_pool_t *pool, long begin, long end, void *arg);
+
+// tasks spawned into a group, and not yet finished.
+typedef struct {
+    long pending;
+} task_group_t;
+
+typedef struct {
+    task_fn_t fn;
+    void *arg;
+    task_group_t *group;
+} task_t;
+
+typedef struct {
+    int64_t top;                         // stolen from here
+    int64_t bottom;                      // pushed and taken here, by the owner only
+    task_t *tasks;                       // TASK_DEQUE_SIZE, indexed mod the size
+} task_deque_t;
+
+typedef struct {
+    task_pool_t *pool;
+    int index;
+    uint32_t random;                     // picks steal victims
+    task_deque_t deque;
+    pthread_t thread;                    // not for worker 0, the caller's
+} task_worker_t;
+
+struct task_pool {
+    int num_threads;
+    task_worker_t *workers;
+    bool running;                        // a task_pool_run is in progress
+    bool stopping;
+    pthread_mutex_t lock;                // guards running and stopping for the sleepers
+    pthread_cond_t wake;
+    pthread_mutex_t run_lock;            // one task_pool_run at a time
+};
+
+/* task_pool_init
+ * start a pool of 'num_threads' threads, the caller of task_pool_run counted. return false if
+ * threads or memory run out.
+*/
+bool task_pool_init(task_pool_t *pool, int num_threads);
+
+void task_pool_destroy(task_pool_t *pool);
+
+static inline int task_pool_threads(const task_pool_t *pool){
+    return pool->num_threads;
+}
+
+// run fn(pool, arg) in the pool and wait for it; one caller at a time, the others wait their turn.
+// Not from the pool's own tasks, which fork and join instead.
+void task_pool_run(task_pool_t *pool, task_fn_t fn, void *arg);
+
+// from a task: queue fn(pool, arg) to run in this task or any other worker, as part of 'group'.
+void task_spawn(task_pool_t *pool, task_group_t *group, task_fn_t fn, void *arg);
+
+// from a task: run other tasks until every task spawned into 'group' has finished.
+void task_wait(task_pool_t *pool, task_group_t *group);
+
+// run a(pool, a_arg) and b(pool, b_arg), in parallel if a worker is free, and return when both are done.
+void task_fork_join(task_pool_t *pool, task_fn_t a, void *a_arg, task_fn_t b, void *b_arg);
+
+/* task_parallel_for
+ * call fn on pieces of [begin, end) of at most 'grain' items, in parallel, and return when all
+ * are done. The range is halved until pieces fit the grain: pick a grain worth a few
+ * microseconds of work, so the task overhead is lost in it.
+*/
+void task_parallel_for(task_pool_t *pool, long begin, long end, long grain, task_range_fn_t fn, void *arg);
+
+#endif  // TASK_POOL_H_
@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+typedef struct {
+    uint64_t ticks;
+    const char *name;
+    uint64_t value;
+    uint32_t type;
+} trace_slot_t;
+
+typedef struct {
+    uint32_t thread;
+    uint64_t count;                  // events ever recorded; the ring holds the last TRACE_RING_EVENTS
+    uint32_t num_counters;
+    const char *counter_names[TRACE_MAX_COUNTERS];
+    uint64_t counter_totals[TRACE_MAX_COUNTERS];
+    trace_slot_t slots[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+static trace_ring_t *rings[TRACE_MAX_THREADS];
+static uint32_t num_rings;           // claimed, including ones past TRACE_MAX_THREADS
+static __thread trace_ring_t *this_ring;
+static __thread bool no_ring;
+static uint64_t start_ticks, start_ns;
+
+static uint64_t clock_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+#ifdef TRACE_NOW_NS
+uint64_t trace_now(void){
+    return clock_ns();
+}
+#endif
+
+static void write_at_exit(void){
+    const char *path = getenv("TRACE_FILE");
+    if (path == NULL) path = "trace.bin";
+    if (!trace_write(path)) fprintf(stderr, "trace: could not write %s\n", path);
+}
+
+// this thread's ring, set up on its first event. NULL past TRACE_MAX_THREADS or out of memory.
+static trace_ring_t *thread_ring(void){
+    if (this_ring != NULL || no_ring) return this_ring;
+    uint32_t thread = __atomic_fetch_add(&num_rings, 1, __ATOMIC_RELAXED);
+    if (thread == 0){
+        start_ns = clock_ns();
+        start_ticks = trace_now();
+        atexit(write_at_exit);
+    }
+    trace_ring_t *ring = thread < TRACE_MAX_THREADS ? calloc(1, sizeof(trace_ring_t)) : NULL;
+    if (ring == NULL){
+        no_ring = true;
+        return NULL;
+    }
+    ring->thread = thread;
+    __atomic_store_n(&rings[thread], ring, __ATOMIC_RELEASE);
+    this_ring = ring;
+    return ring;
+}
+
+void trace_event(trace_event_type_t type, const char *name, uint64_t value){
+    uint64_t ticks = trace_now();
+    trace_ring_t *ring = thread_ring();
+    if (ring == NULL) return;
+    trace_slot_t *slot = &ring->slots[ring->count % TRACE_RING_EVENTS];
+    slot->ticks = ticks;
+    slot->name = name;
+    slot->value = value;
+    slot->type = type;
+    ring->count++;
+}
+
+void trace_count(const char *name, uint64_t n){
+    trace_ring_t *ring = thread_ring();
+    if (ring == NULL) return;
+    // pointers first: a counter is nearly always named by the same literal.
+    uint32_t c = 0;
+    while (c < ring->num_counters && ring->counter_names[c] != name) c++;
+    if (c == ring->num_counters){
+        for (c = 0; c < ring->num_counters && 0 != strcmp(ring->counter_names[c], name); c++);
+        if (c == TRACE_MAX_COUNTERS) return;
+        if (c == ring->num_counters) ring->counter_names[ring->num_counters++] = name;
+    }
+    ring->counter_totals[c] += n;
+    trace_event(TRACE_EVENT_COUNT, name, ring->counter_totals[c]);
+}
+
+// name table for trace_write: open addressing on the pointer, then the same string under
+// another pointer (the same literal in two files) gets the same id.
+typedef struct {
+    const char *names[TRACE_MAX_NAMES];
+    uint32_t num_names;
+    const char *slot_names[2 * TRACE_MAX_NAMES];
+    uint32_t slot_ids[2 * TRACE_MAX_NAMES];
+} name_table_t;
+
+// id of 'name', added if new. return -1 if the table is full.
+static long name_id(name_table_t *table, const char *name){
+    uint32_t mask = 2 * TRACE_MAX_NAMES - 1;
+    uint32_t slot = (uint32_t) (((uintptr_t) name >> 3) * 2654435761u) & mask;
+    for ( ; table->slot_names[slot] != NULL; slot = (slot + 1) & mask){
+        if (table->slot_names[slot] == name) return table->slot_ids[slot];
+    }
+    if (table->num_names == TRACE_MAX_NAMES) return -1;
+    uint32_t id = 0;
+    while (id < table->num_names && 0 != strcmp(table->names[id], name)) id++;
+    if (id == table->num_names) table->names[table->num_names++] = name;
+    table->slot_names[slot] = name;
+    table->slot_ids[slot] = id;
+    return id;
+}
+
+bool trace_write(const char *path){
+    static name_table_t table;
+    memset(&table, 0, sizeof(table));
+    uint32_t claimed = __atomic_load_n(&num_rings, __ATOMIC_RELAXED);
+    trace_file_header_t header = {
+        .magic = TRACE_FILE_MAGIC,
+        .num_threads = claimed < TRACE_MAX_THREADS ? claimed : TRACE_MAX_THREADS,
+        .lost_threads = claimed < TRACE_MAX_THREADS ? 0 : claimed - TRACE_MAX_THREADS,
+        .start_ticks = start_ticks,
+        .start_ns = start_ns,
+        .end_ns = clock_ns(),
+        .end_ticks = trace_now(),
+    };
+
+    // names first, as the events refer to them. a thread that failed to get its ring is empty.
+    for (uint32_t t = 0; t < header.num_threads; t++){
+        trace_ring_t *ring = __atomic_load_n(&rings[t], __ATOMIC_ACQUIRE);
+        uint64_t first = ring == NULL || ring->count < TRACE_RING_EVENTS ? 0 : ring->count - TRACE_RING_EVENTS;
+        for (uint64_t e = first; ring != NULL && e < ring->count; e++){
+            if (name_id(&table, ring->slots[e % TRACE_RING_EVENTS].name) == -1) return false;
+        }
+    }
+    header.num_names = table.num_names;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) return false;
+    bool ok = 1 == fwrite(&header, sizeof(header), 1, file);
+    for (uint32_t i = 0; i < table.num_names && ok; i++){
+        uint32_t len = strlen(table.names[i]);
+        ok = 1 == fwrite(&len, sizeof(len), 1, file) && len == fwrite(table.names[i], 1, len, file);
+    }
+    for (uint32_t t = 0; t < header.num_threads && ok; t++){
+        trace_ring_t *ring = __atomic_load_n(&rings[t], __ATOMIC_ACQUIRE);
+        uint64_t count = ring == NULL ? 0 : ring->count;
+        uint64_t first = count < TRACE_RING_EVENTS ? 0 : count - TRACE_RING_EVENTS;
+        trace_file_thread_t thread = { .thread = t, .num_events = count - first, .dropped = first };
+        ok = 1 == fwrite(&thread, sizeof(thread), 1, file);
+        for (uint64_t e = first; e < count && ok; e++){
+            const trace_slot_t *slot = &ring->slots[e % TRACE_RING_EVENTS];
+            trace_file_event_t event = {
+                .ticks = slot->ticks,
+                .value = slot->value,
+                .name = name_id(&table, slot->name),
+                .type = slot->type,
+            };
+            ok = 1 == fwrite(&event, sizeof(event), 1, file);
+        }
+    }
+    return 0 == fclose(file) && ok;
+}
@@ -0,0 +1,106 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "stdbool.h"
+#include "stdint.h"
+
+// Trace points for the hot paths of every exercise: spans, instants and per-thread counters,
+// timed by the CPU's cycle counter and kept in a binary ring buffer per thread.
+//
+// The trace points are macros that compile to nothing unless TRACE is defined, so they cost
+// nothing in the usual builds. 'make TRACE=1' in any directory (or at the top) defines it and
+// links trace.c in. A traced program writes its rings to $TRACE_FILE (default trace.bin) when it
+// exits, and trace_dump turns that into Chrome trace JSON, for chrome://tracing or Perfetto:
+//   make TRACE=1 reader && ./reader && ../common/trace_dump trace.bin trace.json
+//
+// Recording an event is a cycle counter read and a 32 byte store into the thread's own ring: no
+// locks, and no allocation after the thread's first event. A ring keeps the last
+// TRACE_RING_EVENTS events of its thread.
+//
+// Names must outlive the program, as string literals do: events keep the pointer.
+
+#ifdef TRACE
+#define TRACE_BEGIN(name) trace_event(TRACE_EVENT_BEGIN, name, 0)
+#define TRACE_END(name) trace_event(TRACE_EVENT_END, name, 0)
+#define TRACE_MARK(name) trace_event(TRACE_EVENT_MARK, name, 0)
+// add 'n' to this thread's counter 'name', and record its new total.
+#define TRACE_COUNT(name, n) trace_count(name, n)
+#else
+#define TRACE_BEGIN(name) ((void) 0)
+#define TRACE_END(name) ((void) 0)
+#define TRACE_MARK(name) ((void) 0)
+#define TRACE_COUNT(name, n) ((void) 0)
+#endif
+
+#ifndef TRACE_RING_EVENTS
+#define TRACE_RING_EVENTS (1 << 16)
+#endif
+#define TRACE_MAX_THREADS 64         // threads after this many record nothing
+#define TRACE_MAX_COUNTERS 32        // per thread
+#define TRACE_MAX_NAMES 1024         // distinct names in a trace file
+
+typedef enum {
+    TRACE_EVENT_BEGIN,
+    TRACE_EVENT_END,
+    TRACE_EVENT_MARK,
+    TRACE_EVENT_COUNT,
+} trace_event_type_t;
+
+// cycle counter: the TSC on x86, the virtual counter on ARM, else nanoseconds.
+#if defined(__x86_64__) || defined(__i386__)
+#include "x86intrin.h"
+static inline uint64_t trace_now(void){
+    return __rdtsc();
+}
+#elif defined(__aarch64__)
+static inline uint64_t trace_now(void){
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+}
+#else
+#define TRACE_NOW_NS
+uint64_t trace_now(void);
+#endif
+
+void trace_event(trace_event_type_t type, const char *name, uint64_t value);
+
+void trace_count(const char *name, uint64_t n);
+
+/* trace_write
+ * write every thread's ring to 'path', in the format below. Call it once traced threads are
+ * done; a traced program calls it when it exits. return false if the file cannot be written.
+*/
+bool trace_write(const char *path);
+
+// Trace file, in the byte order of the machine that wrote it:
+//   trace_file_header_t
+//   num_names names: uint32_t length, then that many bytes, no terminator
+//   num_threads times: trace_file_thread_t, then its num_events trace_file_event_t, oldest first
+// Names are referred to by their position. The header's two clock readings, at the first event
+// and at trace_write, convert ticks to nanoseconds.
+#define TRACE_FILE_MAGIC 0x31435254  // "TRC1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t num_names;
+    uint32_t num_threads;
+    uint32_t lost_threads;           // past TRACE_MAX_THREADS, not recorded
+    uint64_t start_ticks, start_ns;
+    uint64_t end_ticks, end_ns;
+} trace_file_header_t;
+
+typedef struct {
+    uint32_t thread;                 // in order of each thread's first event
+    uint32_t num_events;
+    uint64_t dropped;                // overwritten in the ring before trace_write
+} trace_file_thread_t;
+
+typedef struct {
+    uint64_t ticks;
+    uint64_t value;                  // counter total
+    uint32_t name;
+    uint32_t type;                   // trace_event_type_t
+} trace_file_event_t;
+
+#endif  // TRACE_H_
@@ -0,0 +1,149 @@
+/*
+Converts a trace file (trace.h) to Chrome trace JSON, for chrome://tracing or ui.perfetto.dev,
+and prints the calls and time of every span to stderr.
+
+Spans are matched per thread. An end whose begin was overwritten in the ring is left out, and a
+begin that never ended is left open. Counters of different threads are separate series.
+
+compile:
+make trace_dump
+
+run:
+./trace_dump trace.bin [trace.json]
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "trace.h"
+
+#define MAX_DEPTH 256
+
+typedef struct {
+    uint64_t calls;
+    uint64_t ticks;
+} span_total_t;
+
+char *names[TRACE_MAX_NAMES];
+span_total_t totals[TRACE_MAX_NAMES];
+
+void put_string(FILE *out, const char *s){
+    fputc('"', out);
+    for ( ; *s != '\0'; s++){
+        if (*s == '"' || *s == '\\') fprintf(out, "\\%c", *s);
+        else if ((unsigned char) *s < 0x20) fprintf(out, "\\u%04x", *s);
+        else fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+bool read_names(FILE *in, uint32_t num_names){
+    for (uint32_t i = 0; i < num_names; i++){
+        uint32_t len;
+        if (1 != fread(&len, sizeof(len), 1, in)) return false;
+        names[i] = malloc(len + 1);
+        if (names[i] == NULL || len != fread(names[i], 1, len, in)) return false;
+        names[i][len] = '\0';
+    }
+    return true;
+}
+
+// read one thread's events and write them out. '*first' is false once an event has been written.
+bool dump_thread(FILE *in, FILE *out, const trace_file_header_t *header, double ticks_per_us,
+    uint64_t origin, bool *first){
+    trace_file_thread_t thread;
+    if (1 != fread(&thread, sizeof(thread), 1, in)) return false;
+    if (thread.dropped > 0){
+        fprintf(stderr, "thread %u: %llu older events were overwritten in the ring\n",
+            thread.thread, (unsigned long long) thread.dropped);
+    }
+    fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}",
+        *first ? "" : ",\n", thread.thread, thread.thread);
+    *first = false;
+
+    trace_file_event_t open[MAX_DEPTH];
+    int depth = 0;
+    for (uint32_t e = 0; e < thread.num_events; e++){
+        trace_file_event_t event;
+        if (1 != fread(&event, sizeof(event), 1, in) || event.name >= header->num_names) return false;
+        const char *phase = "i";
+        if (event.type == TRACE_EVENT_BEGIN){
+            if (depth == MAX_DEPTH) return false;
+            open[depth++] = event;
+            phase = "B";
+        } else if (event.type == TRACE_EVENT_END){
+            if (depth == 0 || open[depth-1].name != event.name) continue;
+            depth--;
+            totals[event.name].calls++;
+            totals[event.name].ticks += event.ticks - open[depth].ticks;
+            phase = "E";
+        } else if (event.type == TRACE_EVENT_COUNT){
+            phase = "C";
+        }
+        fprintf(out, ",\n{\"name\": ");
+        put_string(out, names[event.name]);
+        fprintf(out, ", \"ph\": \"%s\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u", phase,
+            (event.ticks - origin) / ticks_per_us, thread.thread);
+        if (event.type == TRACE_EVENT_MARK) fprintf(out, ", \"s\": \"t\"");
+        if (event.type == TRACE_EVENT_COUNT){
+            // a counter series is per process in the viewer, so name each thread's apart.
+            fprintf(out, ", \"id\": %u, \"args\": {\"value\": %llu}", thread.thread, (unsigned long long) event.value);
+        }
+        fprintf(out, "}");
+    }
+    return true;
+}
+
+int main(int argc, char **argv){
+    if (argc < 2){
+        fprintf(stderr, "usage: %s trace.bin [trace.json]\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (in == NULL || out == NULL){
+        fprintf(stderr, "cannot open %s\n", in == NULL ? argv[1] : argv[2]);
+        return 1;
+    }
+    trace_file_header_t header;
+    if (1 != fread(&header, sizeof(header), 1, in) || header.magic != TRACE_FILE_MAGIC ||
+        header.num_names > TRACE_MAX_NAMES || !read_names(in, header.num_names)){
+        fprintf(stderr, "%s is not a trace file\n", argv[1]);
+        return 1;
+    }
+    double ticks_per_us = header.end_ns > header.start_ns ?
+        (double) (header.end_ticks - header.start_ticks) * 1000 / (header.end_ns - header.start_ns) : 1000;
+    if (header.lost_threads > 0) fprintf(stderr, "%u threads past the first %d were not traced\n", header.lost_threads, TRACE_MAX_THREADS);
+
+    // times are from the earliest event of any thread; find it first.
+    long events_start = ftell(in);
+    uint64_t origin = UINT64_MAX;
+    for (uint32_t t = 0; t < header.num_threads; t++){
+        trace_file_thread_t thread;
+        trace_file_event_t event;
+        if (1 != fread(&thread, sizeof(thread), 1, in)) break;
+        for (uint32_t e = 0; e < thread.num_events && 1 == fread(&event, sizeof(event), 1, in); e++){
+            if (event.ticks < origin) origin = event.ticks;
+        }
+    }
+    fseek(in, events_start, SEEK_SET);
+
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    bool first = true, ok = true;
+    for (uint32_t t = 0; t < header.num_threads && ok; t++){
+        ok = dump_thread(in, out, &header, ticks_per_us, origin, &first);
+    }
+    fprintf(out, "\n]}\n");
+    if (!ok) fprintf(stderr, "%s is cut short or malformed; wrote what came before\n", argv[1]);
+
+    fprintf(stderr, "%-32s %10s %12s %12s\n", "span", "calls", "total ms", "mean us");
+    for (uint32_t i = 0; i < header.num_names; i++){
+        if (totals[i].calls == 0) continue;
+        double us = totals[i].ticks / ticks_per_us;
+        fprintf(stderr, "%-32s %10llu %12.3f %12.3f\n", names[i], (unsigned long long) totals[i].calls,
+            us / 1000, us / totals[i].calls);
+    }
+    fclose(in);
+    return 0 == fclose(out) && ok ? 0 : 1;
+}
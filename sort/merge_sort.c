@@ -1,6 +1,41 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, for the benchmark
+
+#include <stdbool.h>
 #include <stdio.h>
 
+#include "../common/arena.h"
+#include "../common/task_pool.h"
+#include "../common/trace.h"
+
 #define SIZE (1 << 5)
+// ranges up to this long are sorted by mergeSort, in one task.
+#define MERGE_SORT_GRAIN (1 << 13)
+
+/* merge
+*  merge the sorted halves [from_idx, midpoint] and [midpoint+1, to_idx] of arr through tmp_arr.
+*/
+static void merge(int *arr, int from_idx, int midpoint, int to_idx, int *tmp_arr){
+    // merge left and right halves into tmp_arr
+    TRACE_BEGIN("merge");
+    for (int i = from_idx, j = midpoint+1, k = from_idx; i <= midpoint || j <= to_idx; k++){
+        if (j > to_idx || (i <= midpoint && arr[i] <= arr[j])){
+            // take from LHS
+            tmp_arr[k] = arr[i];
+            i++;
+        }
+        else {
+            // take from RHS
+            tmp_arr[k] = arr[j];
+            j++;
+        }
+    }
+
+    // copy back tmp_arr into arr
+    for (int k = from_idx; k <= to_idx; k++){
+        arr[k] = tmp_arr[k];
+    }
+    TRACE_END("merge");
+}
 
 /* mergeSort
 *  sort an array between from_idx and to_idx
@@ -21,28 +56,58 @@ void mergeSort(int *arr, int from_idx, int to_idx, int *tmp_arr){
     // mergeSort the right half
     mergeSort(arr, midpoint + 1, to_idx, tmp_arr);
 
-    // merge left and right halves into tmp_arr
-    for (int i = from_idx, j = midpoint+1, k = from_idx; i <= midpoint || j <= to_idx; k++){
-        if (j > to_idx || arr[i] <= arr[j]){
-            // take from LHS
-            tmp_arr[k] = arr[i];
-            i++;
-        }
-        else if (i > midpoint || arr[j] < arr[i]){
-            // take from RHS
-            tmp_arr[k] = arr[j];
-            j++;
-        }
-    }
+    merge(arr, from_idx, midpoint, to_idx, tmp_arr);
 
-    // copy back tmp_arr into arr
-    for (int k = from_idx; k <= to_idx; k++){
-        arr[k] = tmp_arr[k];
+    return;
+}
+
+/* mergeSortScratch
+*  mergeSort with tmp_arr taken from 'scratch' and given back after, for callers with no heap.
+*  return false, leaving arr as it was, if 'scratch' cannot fit to_idx - from_idx + 1 ints.
+*/
+bool mergeSortScratch(int *arr, int from_idx, int to_idx, arena_t *scratch){
+    size_t mark = arena_mark(scratch);
+    int *tmp_arr = arena_alloc(scratch, (to_idx - from_idx + 1) * sizeof(int), sizeof(int));
+    if (tmp_arr == NULL) return false;
+    // tmp_arr is indexed like arr, so sort the range as an array of its own.
+    mergeSort(arr + from_idx, 0, to_idx - from_idx, tmp_arr);
+    arena_release(scratch, mark);
+    return true;
+}
+
+typedef struct {
+    int *arr;
+    int from_idx;
+    int to_idx;
+    int *tmp_arr;
+} sort_job_t;
+
+static void sortTask(task_pool_t *pool, void *arg){
+    sort_job_t *job = arg;
+    if (job->to_idx - job->from_idx < MERGE_SORT_GRAIN){
+        mergeSort(job->arr, job->from_idx, job->to_idx, job->tmp_arr);
+        return;
     }
+    int midpoint = (job->from_idx + job->to_idx) / 2;
+    sort_job_t left = { job->arr, job->from_idx, midpoint, job->tmp_arr };
+    sort_job_t right = { job->arr, midpoint + 1, job->to_idx, job->tmp_arr };
+    task_fork_join(pool, sortTask, &left, sortTask, &right);
+    merge(job->arr, job->from_idx, midpoint, job->to_idx, job->tmp_arr);
+}
 
-    return;
+/* mergeSortParallel
+*  mergeSort on the threads of 'pool': the two halves of every range longer than
+*  MERGE_SORT_GRAIN are sorted in parallel, then merged by one thread. The halves use
+*  disjoint parts of tmp_arr, so the extra space is still linear.
+*  The final merges are sequential, so the speedup levels off: the last one alone is a
+*  pass over the whole array.
+*/
+void mergeSortParallel(task_pool_t *pool, int *arr, int from_idx, int to_idx, int *tmp_arr){
+    sort_job_t job = { arr, from_idx, to_idx, tmp_arr };
+    task_pool_run(pool, sortTask, &job);
 }
 
+#ifndef BENCH
 int main(void){
 
     // make a reverse list for testing
@@ -57,9 +122,15 @@ int main(void){
     }
     printf("\n");
 
+    // the scratch space for merging comes from an arena, here over memory of our own.
     int to_idx = SIZE-1;
-    int tmp_arr[SIZE] = {0};
-    mergeSort(arr, 0, to_idx, tmp_arr);
+    static int scratch_memory[SIZE];
+    arena_t scratch;
+    arena_init(&scratch, scratch_memory, sizeof(scratch_memory));
+    if (!mergeSortScratch(arr, 0, to_idx, &scratch)){
+        printf("no room to sort\n");
+        return 1;
+    }
 
     printf("Final: ");
     for (int i = 0; i <= to_idx; i++){
@@ -69,3 +140,80 @@ int main(void){
     
     return 0;
 }
+#else
+/*
+Scaling of mergeSortParallel against mergeSort, on BENCH_ITEMS random ints.
+
+compile:
+make sort_bench
+
+run:
+./merge_sort_bench [max threads]
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef BENCH_ITEMS
+#define BENCH_ITEMS (1 << 23)
+#endif
+
+double nowSec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv){
+    int n = BENCH_ITEMS;
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1) max_threads = 1;
+    int *input = malloc(n * sizeof(int));
+    int *expected = malloc(n * sizeof(int));
+    int *arr = malloc(n * sizeof(int));
+    int *tmp_arr = malloc(n * sizeof(int));
+    if (input == NULL || expected == NULL || arr == NULL || tmp_arr == NULL){
+        printf("failed to allocate %d ints\n", n);
+        return 1;
+    }
+    srand(1);
+    for (int i = 0; i < n; i++){
+        input[i] = rand();
+    }
+    memset(tmp_arr, 0xff, n * sizeof(int)); // fault it in before timing
+
+    memcpy(expected, input, n * sizeof(int));
+    double start = nowSec();
+    mergeSort(expected, 0, n - 1, tmp_arr);
+    double sequential = nowSec() - start;
+    bool ok = true;
+    for (int i = 1; i < n; i++){
+        ok = ok && expected[i-1] <= expected[i];
+    }
+    printf("random     n=%-9d sequential        %8.3fs   sorted %d\n", n, sequential, ok);
+    for (int threads = 1; threads <= max_threads; threads *= 2){
+        task_pool_t pool;
+        if (!task_pool_init(&pool, threads)){
+            printf("failed to start %d threads\n", threads);
+            return 1;
+        }
+        memcpy(arr, input, n * sizeof(int));
+        start = nowSec();
+        mergeSortParallel(&pool, arr, 0, n - 1, tmp_arr);
+        double parallel = nowSec() - start;
+        task_pool_destroy(&pool);
+        bool match = 0 == memcmp(expected, arr, n * sizeof(int));
+        printf("random     n=%-9d parallel x%-3d     %8.3fs   speedup %5.2f   match %d\n",
+            n, threads, parallel, sequential / parallel, match);
+        ok = ok && match;
+    }
+    free(input);
+    free(expected);
+    free(arr);
+    free(tmp_arr);
+    return ok ? 0 : 1;
+}
+#endif
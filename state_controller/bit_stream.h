@@ -0,0 +1,126 @@
+#ifndef BIT_STREAM_H_
+#define BIT_STREAM_H_
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "string.h"
+
+// Bit streams with the bits of each byte used low order bit first, and values of up to
+// BIT_STREAM_MAX_WIDTH bits stored low order bits first. Positions are size_t bit offsets,
+// so a stream can be as long as its buffer.
+//
+// The writer gathers bits in a 64-bit word and stores it whole after every put, moving on by
+// the number of complete bytes. The reader loads the 64-bit word under its position on every
+// peek, so there is nothing to refill. Both fall back to byte loops only within 8 bytes of the
+// buffer's end. The reader sees zeros past the end of its buffer.
+
+#define BIT_STREAM_MAX_WIDTH 57
+
+static inline uint64_t bit_stream_mask(int width){
+    return width == 0 ? 0 : UINT64_MAX >> (64 - width);
+}
+
+// little endian 64-bit read of buf[byte, byte+8), zero past 'len'.
+static inline uint64_t bit_stream_load(const uint8_t *buf, size_t len, size_t byte){
+    uint64_t word = 0;
+    if (byte + 8 <= len){
+        memcpy(&word, &buf[byte], 8);
+        #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+        #endif
+        return word;
+    }
+    for (size_t i = 0; byte + i < len; i++){
+        word |= (uint64_t) buf[byte + i] << (8 * i);
+    }
+    return word;
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;        // bytes
+    size_t byte;       // bytes complete
+    uint64_t bits;     // the incomplete byte's bits, low order first
+    int count;         // number of them, below 8
+    bool overflow;     // a put did not fit in 'cap'
+} bit_writer_t;
+
+static inline void bit_writer_init(bit_writer_t *writer, uint8_t *buf, size_t cap){
+    writer->buf = buf;
+    writer->cap = cap;
+    writer->byte = 0;
+    writer->bits = 0;
+    writer->count = 0;
+    writer->overflow = false;
+}
+
+/* bit_writer_put
+ * append the low 'width' bits of 'value' (width at most BIT_STREAM_MAX_WIDTH).
+ * The bytes up to the last bit written are always complete in the buffer; up to 8 bytes after
+ * them may be overwritten with zeros. return false if the bits do not fit, and from then on.
+*/
+static inline bool bit_writer_put(bit_writer_t *writer, uint64_t value, int width){
+    if (writer->overflow || 8 * writer->byte + writer->count + width > 8 * writer->cap){
+        writer->overflow = true;
+        return false;
+    }
+    writer->bits |= (value & bit_stream_mask(width)) << writer->count;
+    writer->count += width;
+    if (writer->byte + 8 <= writer->cap){
+        uint64_t word = writer->bits;
+        #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+        #endif
+        memcpy(&writer->buf[writer->byte], &word, 8);
+    } else {
+        for (int i = 0; 8 * i < writer->count; i++){
+            writer->buf[writer->byte + i] = writer->bits >> (8 * i);
+        }
+    }
+    int flushed = writer->count & ~7; // up to 64: shift in two halves
+    writer->byte += flushed >> 3;
+    writer->bits = writer->bits >> (flushed / 2) >> (flushed / 2);
+    writer->count &= 7;
+    return true;
+}
+
+// bits written so far.
+static inline size_t bit_writer_bits(const bit_writer_t *writer){
+    return 8 * writer->byte + writer->count;
+}
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;        // bytes
+    size_t pos;        // bits read
+} bit_reader_t;
+
+static inline void bit_reader_init(bit_reader_t *reader, const uint8_t *buf, size_t len){
+    reader->buf = buf;
+    reader->len = len;
+    reader->pos = 0;
+}
+
+// the next 'width' bits (width at most BIT_STREAM_MAX_WIDTH), without moving past them.
+static inline uint64_t bit_reader_peek(const bit_reader_t *reader, int width){
+    uint64_t word = bit_stream_load(reader->buf, reader->len, reader->pos >> 3);
+    return (word >> (reader->pos & 7)) & bit_stream_mask(width);
+}
+
+static inline void bit_reader_skip(bit_reader_t *reader, int width){
+    reader->pos += width;
+}
+
+static inline uint64_t bit_reader_get(bit_reader_t *reader, int width){
+    uint64_t value = bit_reader_peek(reader, width);
+    reader->pos += width;
+    return value;
+}
+
+// bits left before the end of the buffer; negative once the reader has gone past it.
+static inline long bit_reader_left(const bit_reader_t *reader){
+    return (long) (8 * reader->len) - (long) reader->pos;
+}
+
+#endif  // BIT_STREAM_H_
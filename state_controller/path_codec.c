@@ -0,0 +1,236 @@
+#include "path_codec.h"
+
+#include "stdlib.h"
+#include "string.h"
+
+#include "bit_stream.h"
+#include "../common/trace.h"
+
+static uint32_t name_hash(const char *name){
+    uint32_t hash = 2166136261u;
+    for ( ; *name != '\0'; name++){
+        hash = (hash ^ (uint8_t) *name) * 16777619u;
+    }
+    return hash;
+}
+
+long path_codec_state_index(const path_codec_t *codec, const char *name){
+    for (uint32_t slot = name_hash(name) & codec->name_mask; ; slot = (slot + 1) & codec->name_mask){
+        uint32_t i = codec->name_slots[slot];
+        if (i == 0) return -1;
+        if (0 == strcmp(codec->names[i-1], name)) return i - 1;
+    }
+}
+
+// bits to index n children: 0 for n = 0 or 1, else 1 + floor(log2(n - 1)).
+static uint8_t bits_to_index(uint32_t n){
+    uint8_t bits = 0;
+    for (uint32_t m = n > 1 ? n - 1 : 0; m > 0; m >>= 1){
+        bits++;
+    }
+    return bits;
+}
+
+typedef struct {
+    size_t num_children;
+    size_t name_bytes;
+    uint32_t num_slots;
+} codec_sizes_t;
+
+static codec_sizes_t codec_sizes(const path_codec_state_t *states, uint32_t num_states){
+    codec_sizes_t sizes = { .num_slots = 2 };
+    for (uint32_t s = 0; s < num_states; s++){
+        sizes.num_children += states[s].num_children;
+        sizes.name_bytes += strlen(states[s].name) + 1;
+    }
+    while (sizes.num_slots < 2 * (uint64_t) num_states) sizes.num_slots *= 2;
+    return sizes;
+}
+
+size_t path_codec_bytes(const path_codec_state_t *states, uint32_t num_states){
+    codec_sizes_t sizes = codec_sizes(states, num_states);
+    // pointers, then 32-bit words, then bytes, so every array is aligned; and up to a pointer
+    // of padding in front, to align the first.
+    return num_states * sizeof(char *)
+        + (num_states + 1 + 3 * sizes.num_children + sizes.num_slots) * sizeof(uint32_t)
+        + num_states + sizes.name_bytes + sizeof(char *) - 1;
+}
+
+bool path_codec_init(path_codec_t *codec, const path_codec_state_t *states, uint32_t num_states){
+    size_t size = path_codec_bytes(states, num_states);
+    void *block = malloc(size);
+    if (block == NULL) return false;
+    arena_t arena;
+    arena_init(&arena, block, size);
+    if (!path_codec_init_in(codec, states, num_states, &arena)){
+        free(block);
+        return false;
+    }
+    codec->block = block;
+    return true;
+}
+
+bool path_codec_init_in(path_codec_t *codec, const path_codec_state_t *states, uint32_t num_states, arena_t *arena){
+    memset(codec, 0, sizeof(path_codec_t));
+    codec_sizes_t sizes = codec_sizes(states, num_states);
+    size_t mark = arena_mark(arena);
+    codec->names = arena_alloc(arena, num_states * sizeof(char *), sizeof(char *));
+    codec->child_start = arena_alloc(arena, (num_states + 1) * sizeof(uint32_t), sizeof(uint32_t));
+    codec->next = arena_alloc(arena, sizes.num_children * sizeof(uint32_t), sizeof(uint32_t));
+    codec->sorted_next = arena_alloc(arena, sizes.num_children * sizeof(uint32_t), sizeof(uint32_t));
+    codec->sorted_child = arena_alloc(arena, sizes.num_children * sizeof(uint32_t), sizeof(uint32_t));
+    codec->name_slots = arena_alloc(arena, sizes.num_slots * sizeof(uint32_t), sizeof(uint32_t));
+    codec->child_bits = arena_alloc(arena, num_states, 1);
+    char *name_pool = arena_alloc(arena, sizes.name_bytes, 1);
+    if (codec->names == NULL || codec->child_start == NULL || codec->next == NULL || codec->sorted_next == NULL ||
+        codec->sorted_child == NULL || codec->name_slots == NULL || codec->child_bits == NULL || name_pool == NULL){
+        arena_release(arena, mark);
+        memset(codec, 0, sizeof(path_codec_t));
+        return false;
+    }
+    uint32_t num_slots = sizes.num_slots;
+    codec->num_states = num_states;
+    codec->name_mask = num_slots - 1;
+    memset(codec->name_slots, 0, num_slots * sizeof(uint32_t));
+
+    for (uint32_t s = 0; s < num_states; s++){
+        if (path_codec_state_index(codec, states[s].name) != -1) goto fail; // names must be unique
+        size_t len = strlen(states[s].name) + 1;
+        memcpy(name_pool, states[s].name, len);
+        codec->names[s] = name_pool;
+        name_pool += len;
+        uint32_t slot = name_hash(states[s].name) & codec->name_mask;
+        while (codec->name_slots[slot] != 0) slot = (slot + 1) & codec->name_mask;
+        codec->name_slots[slot] = s + 1;
+    }
+    long start = path_codec_state_index(codec, "START");
+    long done = path_codec_state_index(codec, "DONE");
+    if (start == -1 || done == -1) goto fail;
+    codec->start = start;
+    codec->done = done;
+
+    codec->child_start[0] = 0;
+    for (uint32_t s = 0; s < num_states; s++){
+        uint32_t first = codec->child_start[s];
+        for (uint32_t c = 0; c < states[s].num_children; c++){
+            long t = path_codec_state_index(codec, states[s].next_states[c]);
+            if (t == -1) goto fail;
+            codec->next[first + c] = t;
+            // insertion sort by state index; init only, and most states have a few children.
+            uint32_t k = first + c;
+            for ( ; k > first && codec->sorted_next[k-1] > (uint32_t) t; k--){
+                codec->sorted_next[k] = codec->sorted_next[k-1];
+                codec->sorted_child[k] = codec->sorted_child[k-1];
+            }
+            codec->sorted_next[k] = t;
+            codec->sorted_child[k] = c;
+        }
+        codec->child_start[s+1] = first + states[s].num_children;
+        codec->child_bits[s] = bits_to_index(states[s].num_children);
+        if (codec->child_bits[s] > codec->max_child_bits) codec->max_child_bits = codec->child_bits[s];
+    }
+    return true;
+
+fail:
+    arena_release(arena, mark);
+    memset(codec, 0, sizeof(path_codec_t));
+    return false;
+}
+
+void path_codec_free(path_codec_t *codec){
+    free(codec->block);
+    memset(codec, 0, sizeof(path_codec_t));
+}
+
+// position of state 'to' among the next states of 'from', or -1.
+static long child_index(const path_codec_t *codec, uint32_t from, uint32_t to){
+    uint32_t lo = codec->child_start[from], hi = codec->child_start[from+1];
+    while (lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (codec->sorted_next[mid] < to) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == codec->child_start[from+1] || codec->sorted_next[lo] != to) return -1;
+    return codec->sorted_child[lo];
+}
+
+size_t path_codec_max_size(const path_codec_t *codec, size_t max_len){
+    size_t bytes = ((max_len > 0 ? max_len - 1 : 0) * codec->max_child_bits + 7) / 8;
+    uint8_t header[10];
+    return varint_put(header, sizeof(header), bytes) + bytes;
+}
+
+// path_codec_encode, less its trace span.
+static size_t encode(const path_codec_t *codec, const uint32_t *states, size_t len, uint8_t *buf, size_t cap){
+    // the byte count goes first, so add up the bits before writing any.
+    if (len < 1 || states[0] != codec->start || states[len-1] != codec->done) return 0;
+    size_t bits = 0;
+    for (size_t i = 0; i + 1 < len; i++){
+        if (states[i] >= codec->num_states || states[i] == codec->done) return 0;
+        bits += codec->child_bits[states[i]];
+    }
+    size_t bytes = (bits + 7) / 8;
+    size_t header = varint_put(buf, cap, bytes);
+    if (header == 0 || bytes > cap - header) return 0;
+
+    bit_writer_t writer;
+    bit_writer_init(&writer, &buf[header], bytes);
+    for (size_t i = 0; i + 1 < len; i++){
+        long child_idx = child_index(codec, states[i], states[i+1]);
+        if (child_idx == -1) return 0; // child is not in children
+        bit_writer_put(&writer, child_idx, codec->child_bits[states[i]]);
+    }
+    return header + bytes;
+}
+
+size_t path_codec_encode(const path_codec_t *codec, const uint32_t *states, size_t len, uint8_t *buf, size_t cap){
+    TRACE_BEGIN("path_codec_encode");
+    size_t bytes = encode(codec, states, len, buf, cap);
+    TRACE_END("path_codec_encode");
+    return bytes;
+}
+
+size_t path_codec_decode(const path_codec_t *codec, const uint8_t *buf, size_t buf_len,
+    uint32_t *states, size_t max_len, size_t *len){
+    *len = 0;
+    uint64_t bytes;
+    size_t header = varint_get(buf, buf_len, &bytes);
+    if (header == 0 || bytes > buf_len - header) return 0;
+
+    // walk the graph by state index; states with one child take no bits, so the walk ends at
+    // DONE, not when the bits run out.
+    bit_reader_t reader;
+    bit_reader_init(&reader, &buf[header], bytes);
+    uint32_t curr = codec->start;
+    while (*len < max_len){
+        states[(*len)++] = curr;
+        if (curr == codec->done) return header + bytes;
+        int bits_needed_to_index = codec->child_bits[curr];
+        if (bits_needed_to_index > bit_reader_left(&reader)) return 0; // ends before DONE
+        uint64_t child_idx = bit_reader_get(&reader, bits_needed_to_index);
+        if (child_idx >= codec->child_start[curr+1] - codec->child_start[curr]) return 0;
+        curr = codec->next[codec->child_start[curr] + child_idx];
+    }
+    return 0;
+}
+
+size_t varint_put(uint8_t *buf, size_t cap, uint64_t value){
+    size_t n = 0;
+    do {
+        if (n == cap) return 0;
+        buf[n] = value & 0x7F;
+        value >>= 7;
+        if (value != 0) buf[n] |= 0x80;
+        n++;
+    } while (value != 0);
+    return n;
+}
+
+size_t varint_get(const uint8_t *buf, size_t len, uint64_t *value){
+    *value = 0;
+    for (size_t n = 0; n < len && n < 10; n++){
+        *value |= (uint64_t) (buf[n] & 0x7F) << (7 * n);
+        if ((buf[n] & 0x80) == 0) return n + 1;
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#ifndef PATH_CODEC_H_
+#define PATH_CODEC_H_
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "../common/arena.h"
+
+// Path encoder sized at run time, for state graphs and paths past the MAX_STATES, MAX_CHILDREN
+// and MAX_PATH_LEN limits of state_encoder_soln.c.
+//
+// The encoding is implementation 4's: each transition is the child index of the next state, in
+// BITS_TO_INDEX(num_children) bits, packed low order bit first. The length byte in front becomes
+// an unsigned LEB128 varint byte count, 7 bits per byte with the high bit set on all but the
+// last, so a path of any length fits and the usual short path still pays one byte:
+//   [ varint n ][ n bytes of child indexes ]
+//
+// path_codec_init copies the graph into tables allocated in one block, and nothing is allocated
+// after that: encode and decode work in the caller's buffers. path_codec_init_in takes the block
+// from the caller's arena instead, so a codec can live in static memory with no malloc at all.
+//
+// A codec is the whole encoder for one graph, and is never written after path_codec_init: every
+// other function takes it const and keeps its working state on the stack. So a process can hold
+// a codec per controller, and any number of threads can share one, each with its own buffers,
+// with no locks.
+
+typedef struct {
+    const char *name;
+    uint32_t num_children;
+    const char * const *next_states;   // num_children names
+} path_codec_state_t;
+
+typedef struct {
+    uint32_t num_states;
+    uint32_t start;
+    uint32_t done;
+    uint32_t max_child_bits;
+    // children of state s are next[child_start[s], child_start[s+1]), in graph order.
+    uint32_t *child_start;
+    uint32_t *next;
+    // the same children sorted by state index, each with its child index, for encoding.
+    uint32_t *sorted_next;
+    uint32_t *sorted_child;
+    uint8_t *child_bits;               // BITS_TO_INDEX(num_children) of every state
+    // name lookup: open addressing on the FNV-1a hash, 1 + state index, 0 if empty.
+    uint32_t *name_slots;
+    uint32_t name_mask;
+    const char **names;                // into the block, copies of the graph's names
+    void *block;                       // path_codec_init's allocation; NULL if from an arena
+} path_codec_t;
+
+/* path_codec_init
+ * build 'codec' for the 'num_states' states of 'states'. START and DONE must be among them, and
+ * every next state must name one of them. return false if not, or if memory runs out.
+*/
+bool path_codec_init(path_codec_t *codec, const path_codec_state_t *states, uint32_t num_states);
+
+// the same, with the tables from 'arena'. return false also if they do not fit; the arena is then as it was.
+bool path_codec_init_in(path_codec_t *codec, const path_codec_state_t *states, uint32_t num_states, arena_t *arena);
+
+// bytes of arena path_codec_init_in takes for these states, wherever the arena starts.
+size_t path_codec_bytes(const path_codec_state_t *states, uint32_t num_states);
+
+// give back the tables of path_codec_init. Those from an arena go back with the arena.
+void path_codec_free(path_codec_t *codec);
+
+// index of the state called 'name', or -1.
+long path_codec_state_index(const path_codec_t *codec, const char *name);
+
+// bytes an encoding of a path of up to 'max_len' states can take.
+size_t path_codec_max_size(const path_codec_t *codec, size_t max_len);
+
+/* path_codec_encode
+ * write the encoding of the 'len' state indexes in 'states' (START to DONE) to 'buf', which has
+ * room for 'cap' bytes.
+ * return the number of bytes written, or 0 if a transition is not in the graph or 'buf' is too small.
+*/
+size_t path_codec_encode(const path_codec_t *codec, const uint32_t *states, size_t len, uint8_t *buf, size_t cap);
+
+/* path_codec_decode
+ * decode the encoding at the start of the 'buf_len' bytes of 'buf' into 'states', which has room
+ * for 'max_len' indexes, and set '*len' to their number. return the number of bytes the encoding
+ * takes, so the next one can be read after it, or 0 if it is malformed, cut short, or too long.
+*/
+size_t path_codec_decode(const path_codec_t *codec, const uint8_t *buf, size_t buf_len,
+    uint32_t *states, size_t max_len, size_t *len);
+
+// write 'value' as an unsigned LEB128 varint (at most 10 bytes). return the bytes written, 0 if it does not fit.
+size_t varint_put(uint8_t *buf, size_t cap, uint64_t value);
+
+// read an unsigned LEB128 varint into '*value'. return the bytes read, 0 if it is cut short or too long.
+size_t varint_get(const uint8_t *buf, size_t len, uint64_t *value);
+
+#endif  // PATH_CODEC_H_
@@ -0,0 +1,302 @@
+/*
+Encodes paths with path_codec for the example graph of state_encoder_soln.c, then for a random
+graph far past its limits: thousands of states, hundreds of children on some of them, and paths
+thousands of steps long. The encodings are written back to back into one buffer and read back
+in order, the way a log would hold them.
+
+Then logs for several controllers at once: each has its own codec, shared read only by the
+threads encoding its paths, and each thread writes its own log. Every thread does the same
+work, so the total throughput should grow with the number of threads, up to the number of cores.
+
+compile:
+make path_codec_demo
+
+run:
+./path_codec_demo [max threads]
+*/
+
+#include "pthread.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/time.h"
+#include "time.h"
+#include "unistd.h"
+
+#include "path_codec.h"
+
+#define RANDOM_STATES 2000
+#define RANDOM_PATHS 1000
+#define RANDOM_PATH_LEN 3000     // steps of random walk, before heading for DONE
+#define WIDE_STATES 8            // states with num_states / 4 children
+
+#define CONTROLLERS 4
+#define CONTROLLER_STATES 300
+#define CONTROLLER_PATHS 4000
+#define CONTROLLER_PATH_LEN 200
+#define THREAD_ROUNDS 5
+
+typedef struct {
+    int num_states;
+    char (*names)[16];
+    path_codec_state_t *graph;
+    const char **children;
+    size_t num_children;
+} random_graph_t;
+
+// a random graph: state s has s + 1 as its first child, so DONE can always be reached, then up
+// to 32 random children, or num_states / 4 for 'wide' of them.
+void random_graph(random_graph_t *random, int num_states, int wide){
+    random->num_states = num_states;
+    random->names = malloc(num_states * sizeof(random->names[0]));
+    random->graph = malloc(num_states * sizeof(path_codec_state_t));
+    random->children = malloc((num_states * 32 + wide * num_states / 4) * sizeof(char *));
+    random->num_children = 0;
+    for (int s = 0; s < num_states; s++){
+        if (s == 0) strcpy(random->names[s], "START");
+        else if (s == num_states - 1) strcpy(random->names[s], "DONE");
+        else sprintf(random->names[s], "state_%d", s);
+    }
+    for (int s = 0; s < num_states; s++){
+        uint32_t n = s == num_states - 1 ? 0 : s % (num_states / wide) == 1 ? num_states / 4 : 1 + rand() % 32;
+        random->graph[s] = (path_codec_state_t) { random->names[s], n, &random->children[random->num_children] };
+        for (uint32_t c = 0; c < n; c++){
+            random->children[random->num_children++] = random->names[c == 0 ? s + 1 : rand() % num_states];
+        }
+    }
+}
+
+void random_graph_free(random_graph_t *random){
+    free(random->names);
+    free(random->graph);
+    free(random->children);
+}
+
+// a random walk of 'steps' steps from START, then along child 0 (state s -> s + 1) to DONE.
+size_t random_path(const path_codec_t *codec, uint32_t *states, size_t steps){
+    size_t len = 0;
+    uint32_t curr = codec->start;
+    while (curr != codec->done){
+        states[len++] = curr;
+        uint32_t n = codec->child_start[curr+1] - codec->child_start[curr];
+        uint32_t child_idx = len < steps ? (uint32_t) rand() % n : 0;
+        curr = codec->next[codec->child_start[curr] + child_idx];
+    }
+    states[len++] = curr;
+    return len;
+}
+
+double now(void){
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+bool example(void){
+    const char *start[] = {"A", "B", "C"}, *a[] = {"B", "C", "FAILED"}, *b[] = {"D"};
+    const char *c[] = {"DONE", "FAILED", "A", "D"}, *d[] = {"A", "B", "C", "FAILED"}, *failed[] = {"DONE"};
+    path_codec_state_t graph[] = {
+        {"START", 3, start}, {"A", 3, a}, {"B", 1, b}, {"C", 4, c}, {"D", 4, d}, {"FAILED", 1, failed}, {"DONE", 0, NULL}
+    };
+    const char *names[] = {"START", "B", "D", "A", "C", "D", "C", "A", "B", "D", "FAILED", "DONE"};
+    size_t len = sizeof(names) / sizeof(names[0]);
+    // the tables in memory of our own, as a controller with no heap would have them.
+    static uint64_t codec_memory[64];
+    arena_t arena;
+    arena_init(&arena, codec_memory, sizeof(codec_memory));
+    path_codec_t codec;
+    if (!path_codec_init_in(&codec, graph, sizeof(graph) / sizeof(graph[0]), &arena)) return false;
+    uint32_t path[16], decoded[16];
+    for (size_t i = 0; i < len; i++){
+        path[i] = path_codec_state_index(&codec, names[i]);
+    }
+    uint8_t encoding[16];
+    size_t bytes = path_codec_encode(&codec, path, len, encoding, sizeof(encoding));
+    printf("example: Length %d. Value:", encoding[0]);
+    for (size_t i = 1; i < bytes; i++){
+        printf(" %d", encoding[i]);
+    }
+    size_t decoded_len;
+    bool ok = bytes > 0 && bytes == path_codec_decode(&codec, encoding, bytes, decoded, 16, &decoded_len)
+        && decoded_len == len && 0 == memcmp(path, decoded, len * sizeof(uint32_t));
+    printf(", round trip %s; tables %zu of %zu bytes\n", ok ? "ok" : "FAILED", arena_mark(&arena), sizeof(codec_memory));
+    return ok;
+}
+
+bool large_graph(void){
+    random_graph_t random;
+    random_graph(&random, RANDOM_STATES, WIDE_STATES);
+    path_codec_t codec;
+    clock_t start = clock();
+    if (!path_codec_init(&codec, random.graph, RANDOM_STATES)){
+        printf("random graph: init failed\n");
+        return false;
+    }
+    printf("random graph: %d states, %zu transitions, up to %u bits per transition, init %.1f ms\n",
+        RANDOM_STATES, random.num_children, codec.max_child_bits, 1e3 * (clock() - start) / CLOCKS_PER_SEC);
+
+    // every buffer is allocated here; encode and decode allocate nothing.
+    size_t max_len = RANDOM_PATH_LEN + RANDOM_STATES;
+    uint32_t *paths = malloc(RANDOM_PATHS * max_len * sizeof(uint32_t));
+    size_t *lens = malloc(RANDOM_PATHS * sizeof(size_t));
+    size_t cap = RANDOM_PATHS * path_codec_max_size(&codec, max_len);
+    uint8_t *log = malloc(cap);
+    uint32_t *decoded = malloc(max_len * sizeof(uint32_t));
+    size_t total_states = 0, longest = 0;
+    for (int p = 0; p < RANDOM_PATHS; p++){
+        lens[p] = random_path(&codec, &paths[p * max_len], 1 + rand() % RANDOM_PATH_LEN);
+        total_states += lens[p];
+        if (lens[p] > longest) longest = lens[p];
+    }
+
+    start = clock();
+    size_t pos = 0;
+    int bad = 0;
+    for (int p = 0; p < RANDOM_PATHS; p++){
+        size_t bytes = path_codec_encode(&codec, &paths[p * max_len], lens[p], &log[pos], cap - pos);
+        if (bytes == 0){
+            printf("path %d: encode failed\n", p);
+            bad++;
+            break;
+        }
+        pos += bytes;
+    }
+    double encode_seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    size_t read = 0;
+    for (int p = 0; p < RANDOM_PATHS && bad == 0; p++){
+        size_t len;
+        size_t bytes = path_codec_decode(&codec, &log[read], pos - read, decoded, max_len, &len);
+        if (bytes == 0 || len != lens[p] || 0 != memcmp(decoded, &paths[p * max_len], len * sizeof(uint32_t))) bad++;
+        if (bytes == 0) break;
+        read += bytes;
+    }
+    double decode_seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("random paths: %d paths of up to %zu states, %.2f bits per transition, %zu bytes\n",
+        RANDOM_PATHS, longest, 8.0 * pos / (total_states - RANDOM_PATHS), pos);
+    printf("encode %.1f M states/s, decode %.1f M states/s, %d bad round trips\n",
+        total_states / encode_seconds / 1e6, total_states / decode_seconds / 1e6, bad);
+
+    free(paths);
+    free(lens);
+    free(log);
+    free(decoded);
+    path_codec_free(&codec);
+    random_graph_free(&random);
+    return bad == 0;
+}
+
+typedef struct {
+    random_graph_t random;
+    path_codec_t codec;
+    uint32_t *paths;             // CONTROLLER_PATHS paths, max_len apart
+    size_t *lens;
+    size_t max_len;
+    long num_states;             // in all the paths
+} controller_t;
+
+typedef struct {
+    const controller_t *controller;  // shared, read only
+    uint8_t *log;                    // this thread's own, as are the rest
+    size_t cap;
+    uint32_t *decoded;
+    long states;                     // encoded and decoded, over all rounds
+    int bad;
+} worker_t;
+
+// encode all the controller's paths into this thread's log, then decode and check them.
+void *log_paths(void *arg){
+    worker_t *worker = arg;
+    const controller_t *controller = worker->controller;
+    const path_codec_t *codec = &controller->codec;
+    for (int round = 0; round < THREAD_ROUNDS; round++){
+        size_t pos = 0, read = 0;
+        for (int p = 0; p < CONTROLLER_PATHS; p++){
+            pos += path_codec_encode(codec, &controller->paths[p * controller->max_len], controller->lens[p],
+                &worker->log[pos], worker->cap - pos);
+        }
+        for (int p = 0; p < CONTROLLER_PATHS; p++){
+            size_t len;
+            size_t bytes = path_codec_decode(codec, &worker->log[read], pos - read, worker->decoded, controller->max_len, &len);
+            if (bytes == 0 || len != controller->lens[p] ||
+                0 != memcmp(worker->decoded, &controller->paths[p * controller->max_len], len * sizeof(uint32_t))){
+                worker->bad++;
+                break;
+            }
+            read += bytes;
+        }
+        worker->states += controller->num_states;
+    }
+    return NULL;
+}
+
+bool threads(int max_threads){
+    static controller_t controllers[CONTROLLERS];
+    for (int i = 0; i < CONTROLLERS; i++){
+        controller_t *controller = &controllers[i];
+        random_graph(&controller->random, CONTROLLER_STATES, 2);
+        if (!path_codec_init(&controller->codec, controller->random.graph, CONTROLLER_STATES)) return false;
+        controller->max_len = CONTROLLER_PATH_LEN + CONTROLLER_STATES;
+        controller->paths = malloc(CONTROLLER_PATHS * controller->max_len * sizeof(uint32_t));
+        controller->lens = malloc(CONTROLLER_PATHS * sizeof(size_t));
+        controller->num_states = 0;
+        for (int p = 0; p < CONTROLLER_PATHS; p++){
+            controller->lens[p] = random_path(&controller->codec, &controller->paths[p * controller->max_len],
+                1 + rand() % CONTROLLER_PATH_LEN);
+            controller->num_states += controller->lens[p];
+        }
+    }
+
+    printf("%d controllers of %d states, %d cores online\n", CONTROLLERS, CONTROLLER_STATES, (int) sysconf(_SC_NPROCESSORS_ONLN));
+    double one_thread = 0;
+    bool ok = true;
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2){
+        pthread_t *ids = malloc(num_threads * sizeof(pthread_t));
+        worker_t *workers = malloc(num_threads * sizeof(worker_t));
+        for (int t = 0; t < num_threads; t++){
+            const controller_t *controller = &controllers[t % CONTROLLERS];
+            size_t cap = CONTROLLER_PATHS * path_codec_max_size(&controller->codec, controller->max_len);
+            workers[t] = (worker_t) { controller, malloc(cap), cap, malloc(controller->max_len * sizeof(uint32_t)), 0, 0 };
+        }
+        double start = now();
+        for (int t = 0; t < num_threads; t++){
+            pthread_create(&ids[t], NULL, log_paths, &workers[t]);
+        }
+        long states = 0;
+        int bad = 0;
+        for (int t = 0; t < num_threads; t++){
+            pthread_join(ids[t], NULL);
+            states += workers[t].states;
+            bad += workers[t].bad;
+            free(workers[t].log);
+            free(workers[t].decoded);
+        }
+        double rate = states / (now() - start) / 1e6;
+        if (num_threads == 1) one_thread = rate;
+        printf("%3d threads: %7.1f M states/s encoded and decoded, %.2fx one thread, %d bad round trips\n",
+            num_threads, rate, rate / one_thread, bad);
+        ok = ok && bad == 0;
+        free(ids);
+        free(workers);
+    }
+
+    for (int i = 0; i < CONTROLLERS; i++){
+        free(controllers[i].paths);
+        free(controllers[i].lens);
+        path_codec_free(&controllers[i].codec);
+        random_graph_free(&controllers[i].random);
+    }
+    return ok;
+}
+
+int main(int argc, char **argv){
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    if (max_threads < 1) max_threads = 8;
+    srand(1);
+    bool ok = example();
+    ok = large_graph() && ok;
+    ok = threads(max_threads) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+#include "path_log.h"
+
+#include "string.h"
+#include "flash.h"
+#include "../common/trace.h"
+
+#define PATH_LOG_MAGIC 0x504C // "PL"
+#define PATH_LOG_MAGIC_COMPRESSED 0x5A50 // "PZ"
+
+static uint16_t get_u16(const uint8_t *buf){
+    return buf[0] | buf[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *buf){
+    return buf[0] | buf[1] << 8 | (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+static void put_u16(uint8_t *buf, uint16_t value){
+    buf[0] = value;
+    buf[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *buf, uint32_t value){
+    for (int i = 0; i < 4; i++){
+        buf[i] = value >> (8 * i);
+    }
+}
+
+static void fletcher16(const uint8_t *buf, int len, uint16_t *sum1, uint16_t *sum2){
+    for (int i = 0; i < len; i++){
+        *sum1 = (*sum1 + buf[i]) % 255;
+        *sum2 = (*sum2 + *sum1) % 255;
+    }
+}
+
+// Fletcher-16 over seq, used and the records: everything but the magic and the checksum itself.
+// A compressed page's magic is summed too, so a bit flip cannot make its records read as plain.
+static uint16_t page_checksum(const uint8_t *page, uint16_t used, bool compressed){
+    uint16_t sum1 = 0, sum2 = 0;
+    if (compressed) fletcher16(&page[0], 8, &sum1, &sum2);
+    else fletcher16(&page[2], 6, &sum1, &sum2);
+    fletcher16(&page[PATH_LOG_HEADER_SIZE], used, &sum1, &sum2);
+    return sum2 << 8 | sum1;
+}
+
+static uint32_t page_address(const path_log_t *log, uint32_t seq){
+    return log->base + (seq % log->num_pages) * PATH_LOG_PAGE_SIZE;
+}
+
+// read page 'slot' into 'page'. return true if it holds a whole page written by this log.
+static bool read_page(const path_log_t *log, uint32_t slot, uint8_t *page, uint32_t *seq, uint16_t *used, bool *compressed){
+    if (!flash_read(log->base + slot * PATH_LOG_PAGE_SIZE, page, PATH_LOG_PAGE_SIZE)) return false;
+    *seq = get_u32(&page[2]);
+    *used = get_u16(&page[6]);
+    *compressed = get_u16(&page[0]) == PATH_LOG_MAGIC_COMPRESSED;
+    return (*compressed || get_u16(&page[0]) == PATH_LOG_MAGIC) && *used <= PATH_LOG_MAX_RECORD &&
+        *seq % log->num_pages == slot && get_u16(&page[8]) == page_checksum(page, *used, *compressed);
+}
+
+// index of the entry of 'dict' equal to 'record', or -1.
+static int dict_find(const path_log_dict_t *dict, const uint8_t *record){
+    for (int k = 0; k < dict->count; k++){
+        if (dict->records[k][0] == record[0] && 0 == memcmp(dict->records[k], record, record[0] + 1)) return k;
+    }
+    return -1;
+}
+
+// move entry 'k' of 'dict' (or, for -1, a new entry) to the front, holding 'record'.
+// records too long for an entry are not listed.
+static void dict_update(path_log_dict_t *dict, const uint8_t *record, int k){
+    if (k == -1){
+        if (record[0] + 1 > PATH_LOG_DICT_RECORD) return;
+        k = dict->count < PATH_LOG_DICT_ENTRIES ? dict->count++ : PATH_LOG_DICT_ENTRIES - 1;
+    }
+    memmove(dict->records[1], dict->records[0], k * PATH_LOG_DICT_RECORD);
+    memcpy(dict->records[0], record, record[0] + 1);
+}
+
+// code 'record' against 'dict' into 'out' (room for PATH_LOG_MAX_RECORD + 1 bytes), and set
+// '*k' to the entry it repeats, or -1. return the number of bytes.
+static int compress_record(const path_log_dict_t *dict, const uint8_t *record, uint8_t *out, int *k){
+    *k = dict_find(dict, record);
+    if (*k != -1){
+        out[0] = 0x80 | *k;
+        return 1;
+    }
+    int prefix = 0;
+    if (dict->count > 0){
+        const uint8_t *latest = dict->records[0];
+        while (prefix < 127 && prefix < record[0] && prefix < latest[0] && latest[1 + prefix] == record[1 + prefix]){
+            prefix++;
+        }
+    }
+    out[0] = prefix;
+    out[1] = record[0] - prefix;
+    memcpy(&out[2], &record[1 + prefix], out[1]);
+    return 2 + out[1];
+}
+
+// inverse of compress_record for the 'len' bytes at 'in': fill 'record' (room for
+// PATH_LOG_MAX_RECORD bytes) and set '*k' as compress_record did. return the number of bytes
+// read, or 0 if they do not make a record.
+static int decompress_record(const path_log_dict_t *dict, const uint8_t *in, int len, uint8_t *record, int *k){
+    if (len < 1) return 0;
+    if (in[0] & 0x80){
+        *k = in[0] & 0x7F;
+        if (*k >= dict->count) return 0;
+        memcpy(record, dict->records[*k], dict->records[*k][0] + 1);
+        return 1;
+    }
+    *k = -1;
+    int prefix = in[0];
+    if (len < 2 || len < 2 + in[1] || prefix + in[1] + 1 > PATH_LOG_MAX_RECORD) return 0;
+    if (prefix > 0 && (dict->count == 0 || prefix > dict->records[0][0])) return 0;
+    record[0] = prefix + in[1];
+    if (prefix > 0) memcpy(&record[1], &dict->records[0][1], prefix);
+    memcpy(&record[1 + prefix], &in[2], in[1]);
+    return 2 + in[1];
+}
+
+bool path_log_init(path_log_t *log, uint32_t base, uint32_t size, bool compressed){
+    log->base = base;
+    log->num_pages = size / PATH_LOG_PAGE_SIZE;
+    log->seq = 0;
+    log->used = 0;
+    log->compressed = compressed;
+    log->dict.count = 0;
+    // the pages are read and written straight through flash.h, which does not check addresses.
+    if (base > FLASH_MEMORY_SIZE || size > FLASH_MEMORY_SIZE - base) return false;
+    if (log->num_pages < 2) return false;
+    // find the newest page. seq is not expected to wrap: 2^32 pages is decades of logging.
+    bool found = false;
+    for (uint32_t slot = 0; slot < log->num_pages; slot++){
+        uint32_t seq;
+        uint16_t used;
+        bool page_compressed;
+        if (read_page(log, slot, log->page, &seq, &used, &page_compressed) && (!found || seq >= log->seq)){
+            log->seq = seq;
+            found = true;
+        }
+    }
+    // pages are never rewritten, so start a fresh one after the newest.
+    if (found) log->seq++;
+    return true;
+}
+
+bool path_log_flush(path_log_t *log){
+    if (log->used == 0) return true;
+    put_u16(&log->page[0], log->compressed ? PATH_LOG_MAGIC_COMPRESSED : PATH_LOG_MAGIC);
+    put_u32(&log->page[2], log->seq);
+    put_u16(&log->page[6], log->used);
+    put_u16(&log->page[8], page_checksum(log->page, log->used, log->compressed));
+    // leave no stale records after 'used' in flash.
+    memset(&log->page[PATH_LOG_HEADER_SIZE + log->used], 0, PATH_LOG_MAX_RECORD - log->used);
+    if (!flash_write(page_address(log, log->seq), log->page, PATH_LOG_PAGE_SIZE)) return false;
+    log->seq++;
+    log->used = 0;
+    log->dict.count = 0; // a page only refers to its own records
+    return true;
+}
+
+bool path_log_append(path_log_t *log, const uint8_t *record){
+    TRACE_COUNT("path_log records", 1);
+    if (!log->compressed){
+        int len = record[0] + 1;
+        if (len > PATH_LOG_MAX_RECORD) return false;
+        if (log->used + len > PATH_LOG_MAX_RECORD && !path_log_flush(log)) return false;
+        memcpy(&log->page[PATH_LOG_HEADER_SIZE + log->used], record, len);
+        log->used += len;
+        return true;
+    }
+    if (record[0] + 2 > PATH_LOG_MAX_RECORD) return false;
+    uint8_t coded[PATH_LOG_MAX_RECORD + 1];
+    int k;
+    int len = compress_record(&log->dict, record, coded, &k);
+    if (log->used + len > PATH_LOG_MAX_RECORD){
+        // a new page starts with an empty list, so code the record again.
+        if (!path_log_flush(log)) return false;
+        len = compress_record(&log->dict, record, coded, &k);
+    }
+    memcpy(&log->page[PATH_LOG_HEADER_SIZE + log->used], coded, len);
+    log->used += len;
+    dict_update(&log->dict, record, k);
+    return true;
+}
+
+uint32_t path_log_oldest(const path_log_t *log){
+    // the page being filled will overwrite the slot of seq - num_pages.
+    return log->seq + 1 >= log->num_pages ? log->seq + 1 - log->num_pages : 0;
+}
+
+void path_log_reader_init(path_log_reader_t *reader, const path_log_t *log, uint32_t seq){
+    reader->log = log;
+    reader->seq = seq;
+    reader->offset = PATH_LOG_HEADER_SIZE;
+    reader->used = 0;
+    reader->loaded = false;
+    reader->compressed = false;
+    reader->skipped = 0;
+    reader->dict.count = 0;
+}
+
+int path_log_read(path_log_reader_t *reader, uint8_t *record, int size){
+    const path_log_t *log = reader->log;
+    for (;;){
+        uint32_t oldest = path_log_oldest(log);
+        if (reader->seq < oldest){
+            reader->skipped += oldest - reader->seq;
+            reader->seq = oldest;
+            reader->offset = PATH_LOG_HEADER_SIZE;
+            reader->loaded = false;
+            reader->dict.count = 0;
+        }
+        if (reader->seq > log->seq) return 0; // asked to start past the end
+
+        // the page being filled is read from RAM, so a reader keeps up with the writer.
+        const uint8_t *page = log->page;
+        uint16_t used = log->used;
+        bool compressed = log->compressed;
+        if (reader->seq != log->seq){
+            if (!reader->loaded){
+                uint32_t seq;
+                reader->loaded = read_page(log, reader->seq % log->num_pages, reader->page, &seq, &reader->used,
+                    &reader->compressed) && seq == reader->seq;
+                if (!reader->loaded){
+                    reader->skipped++; // torn, or never written
+                    reader->used = 0;
+                    reader->loaded = true;
+                }
+            }
+            page = reader->page;
+            used = reader->used;
+            compressed = reader->compressed;
+        }
+
+        if (reader->offset < PATH_LOG_HEADER_SIZE + used && !compressed){
+            int len = page[reader->offset] + 1;
+            if (len > size) return -1;
+            memcpy(record, &page[reader->offset], len);
+            reader->offset += len;
+            return len;
+        }
+        if (reader->offset < PATH_LOG_HEADER_SIZE + used){
+            uint8_t decoded[PATH_LOG_MAX_RECORD];
+            int k;
+            int coded = decompress_record(&reader->dict, &page[reader->offset],
+                PATH_LOG_HEADER_SIZE + used - reader->offset, decoded, &k);
+            if (coded > 0){
+                int len = decoded[0] + 1;
+                if (len > size) return -1;
+                memcpy(record, decoded, len);
+                reader->offset += coded;
+                dict_update(&reader->dict, decoded, k);
+                return len;
+            }
+            // not a record: drop the rest of the page, unless it is still being filled.
+            if (reader->seq == log->seq) return 0;
+            reader->skipped++;
+        }
+        if (reader->seq == log->seq) return 0;
+        reader->seq++;
+        reader->offset = PATH_LOG_HEADER_SIZE;
+        reader->loaded = false;
+        reader->dict.count = 0;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef PATH_LOG_H_
+#define PATH_LOG_H_
+
+#include "stdbool.h"
+#include "stdint.h"
+
+// Circular log of encoded paths in a region of flash (see ../access_reader/flash.h).
+//
+// A record is a path encoding as path_encoder_encode writes it: record[0] is the number of
+// bytes that follow. Records are gathered in a RAM page and written a page at a time. Each page
+// starts with a header:
+//   [ uint16 magic ][ uint32 seq ][ uint16 used ][ uint16 checksum ]
+// 'seq' counts pages since the log was created and page seq lives in slot seq % num_pages, so
+// the newest data overwrites the oldest. After a power loss, path_log_init finds the highest valid
+// seq and carries on from there; a torn page fails its checksum and is skipped by readers.
+// Records still in the RAM page are lost on power loss unless path_log_flush was called.
+//
+// A compressed page (its own magic) codes each record against the records before it in the
+// same page, never across pages, so every page still decodes on its own and a lost page loses
+// only its records. The page keeps a move-to-front list of its last PATH_LOG_DICT_ENTRIES
+// distinct records of up to PATH_LOG_DICT_RECORD bytes, and each record is one of:
+//   [ 1kkkkkkk ]                         the same as list entry k, in 1 byte
+//   [ 0ppppppp ][ uint8 n ][ n bytes ]   the first p bytes after the length byte of entry 0
+//                                        (the latest listed record), then n more
+// The encodings of a controller's paths repeat a lot, so most records take 1 byte.
+// Readers handle plain and compressed pages alike.
+
+#define PATH_LOG_PAGE_SIZE 256
+#define PATH_LOG_HEADER_SIZE 10
+#define PATH_LOG_MAX_RECORD (PATH_LOG_PAGE_SIZE - PATH_LOG_HEADER_SIZE)
+#define PATH_LOG_DICT_ENTRIES 16
+#define PATH_LOG_DICT_RECORD 32
+
+// the records a compressed page can refer back to, most recent first.
+typedef struct {
+    uint8_t count;
+    uint8_t records[PATH_LOG_DICT_ENTRIES][PATH_LOG_DICT_RECORD];
+} path_log_dict_t;
+
+typedef struct {
+    uint32_t base;       // flash address of the first page
+    uint32_t num_pages;
+    uint32_t seq;        // seq of the page being filled
+    uint16_t used;       // bytes of records in 'page'
+    bool compressed;     // write compressed pages
+    path_log_dict_t dict;
+    uint8_t page[PATH_LOG_PAGE_SIZE];
+} path_log_t;
+
+/* path_log_init
+ * mount the log in the 'size' bytes of flash from 'base' (both multiples of PATH_LOG_PAGE_SIZE).
+ * if the region holds valid pages, continue after the newest one, else start an empty log.
+ * new pages are written compressed if 'compressed'. return false if the region is too small or
+ * does not fit in flash.
+*/
+bool path_log_init(path_log_t *log, uint32_t base, uint32_t size, bool compressed);
+
+// append 'record' (record[0] + 1 bytes, one less at most in a compressed log).
+// return false if it is too long or the flash write fails.
+bool path_log_append(path_log_t *log, const uint8_t *record);
+
+// write the partly filled page to flash, so its records survive a power loss.
+bool path_log_flush(path_log_t *log);
+
+// seq of the oldest page still in flash.
+uint32_t path_log_oldest(const path_log_t *log);
+
+// Reads records in the order they were appended, starting from any page.
+typedef struct {
+    const path_log_t *log;
+    uint32_t seq;        // page being read
+    uint16_t offset;     // next record in 'page'
+    uint16_t used;
+    bool loaded;         // 'page' holds page 'seq'
+    bool compressed;     // and it is compressed
+    uint32_t skipped;    // pages lost to overwriting or failed checksums
+    path_log_dict_t dict;
+    uint8_t page[PATH_LOG_PAGE_SIZE];
+} path_log_reader_t;
+
+// start reading at page 'seq', or at the oldest page if 'seq' has been overwritten.
+void path_log_reader_init(path_log_reader_t *reader, const path_log_t *log, uint32_t seq);
+
+/* path_log_read
+ * copy the next record into 'record', which has room for 'size' bytes.
+ * return the record's size in bytes (record[0] + 1), 0 at the end of the log, or -1 if it does not fit.
+ * records still in the log's RAM page are included.
+*/
+int path_log_read(path_log_reader_t *reader, uint8_t *record, int size);
+
+#endif  // PATH_LOG_H_
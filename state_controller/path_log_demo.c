@@ -0,0 +1,194 @@
+/*
+Fills the 1 MB flash with path_log records several times over, then checks what a reader
+gets back after a simulated power loss, and after a torn page. Runs once with plain pages and
+once with compressed pages.
+
+Records are stand-ins for path encodings: a length byte, a record counter, and 0 to 3 bytes of
+padding, so the reader can tell whether any record went missing.
+
+Then logs real path encodings (path_codec, for the example graph of state_encoder_soln.c) of
+random walks that mostly take each state's usual transition, as a controller's paths do, and
+compares how many fit in flash with plain and compressed pages.
+
+compile:
+make path_log_demo
+
+run:
+./path_log_demo
+*/
+
+#include "stdbool.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#include "flash.h"
+#include "path_codec.h"
+#include "path_log.h"
+
+#define NUM_RECORDS 1000000
+#define NUM_PATHS 200000
+#define USUAL_PERCENT 90     // chance a path takes a state's first transition
+
+// start from blank flash, as if erased.
+void clear_flash(void){
+    uint8_t zeros[PATH_LOG_PAGE_SIZE] = { 0 };
+    for (uint32_t address = 0; address < FLASH_MEMORY_SIZE; address += sizeof(zeros)){
+        flash_write(address, zeros, sizeof(zeros));
+    }
+}
+
+void make_record(uint32_t counter, uint8_t *record){
+    record[0] = 4 + counter % 4;
+    for (int i = 0; i < record[0]; i++){
+        record[1 + i] = i < 4 ? counter >> (8 * i) : 0;
+    }
+}
+
+// read every record from page 'seq' on. return the number read, or -1 if a record went missing
+// anywhere but a page the reader reports as skipped.
+long check_log(const path_log_t *log, uint32_t seq, uint32_t *first, uint32_t *last, uint32_t *skipped){
+    path_log_reader_t reader;
+    path_log_reader_init(&reader, log, seq);
+    uint8_t record[PATH_LOG_MAX_RECORD];
+    long count = 0;
+    uint32_t skipped_before = 0;
+    while (path_log_read(&reader, record, sizeof(record)) > 0){
+        uint32_t counter = record[1] | record[2] << 8 | (uint32_t) record[3] << 16 | (uint32_t) record[4] << 24;
+        if (count == 0) *first = counter;
+        else if (counter != *last + 1 && reader.skipped == skipped_before) return -1;
+        skipped_before = reader.skipped;
+        *last = counter;
+        count++;
+    }
+    *skipped = reader.skipped;
+    return count;
+}
+
+bool counter_records(bool compressed){
+    static path_log_t log;
+    uint8_t record[8];
+    const char *mode = compressed ? "compressed" : "plain";
+    clear_flash();
+    path_log_init(&log, 0, FLASH_MEMORY_SIZE, compressed);
+
+    clock_t start = clock();
+    for (uint32_t counter = 0; counter < NUM_RECORDS; counter++){
+        make_record(counter, record);
+        if (!path_log_append(&log, record)){
+            printf("%s: append failed at record %u\n", mode, counter);
+            return false;
+        }
+    }
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    path_log_flush(&log);
+    printf("%s: appended %d records (%.1f MB of flash) in %.3f s, %.1f M records/s\n",
+        mode, NUM_RECORDS, (double) log.seq * PATH_LOG_PAGE_SIZE / (1 << 20), seconds, NUM_RECORDS / seconds / 1e6);
+
+    // power loss: mount the log again from flash alone.
+    static path_log_t mounted;
+    path_log_init(&mounted, 0, FLASH_MEMORY_SIZE, compressed);
+    uint32_t first = 0, last = 0, skipped = 0;
+    long count = check_log(&mounted, 0, &first, &last, &skipped);
+    printf("%s: after remount: next page %u (was %u), %ld records in order, counters %u to %u, %u pages overwritten\n",
+        mode, mounted.seq, log.seq, count, first, last, skipped);
+    bool ok = count > 0 && mounted.seq == log.seq && last == NUM_RECORDS - 1;
+
+    // stream from the middle of the log.
+    uint32_t middle = path_log_oldest(&mounted) + mounted.num_pages / 2;
+    count = check_log(&mounted, middle, &first, &last, &skipped);
+    printf("%s: from page %u: %ld records in order, counters %u to %u\n", mode, middle, count, first, last);
+    ok = ok && count > 0;
+
+    // tear a page, as if power was lost while writing it.
+    uint8_t garbage[PATH_LOG_PAGE_SIZE / 2] = { 0xA5 };
+    flash_write((middle % mounted.num_pages) * PATH_LOG_PAGE_SIZE + PATH_LOG_PAGE_SIZE / 2, garbage, sizeof(garbage));
+    count = check_log(&mounted, middle - 1, &first, &last, &skipped);
+    printf("%s: with page %u torn: %ld records in order, counters %u to %u, %u page skipped\n",
+        mode, middle, count, first, last, skipped);
+    return ok && count > 0 && skipped == 1;
+}
+
+// a walk from START that takes each state's first transition USUAL_PERCENT of the time.
+size_t usual_path(const path_codec_t *codec, uint32_t *states, size_t max_len){
+    size_t len = 0;
+    uint32_t curr = codec->start;
+    while (curr != codec->done && len + 1 < max_len){
+        states[len++] = curr;
+        uint32_t n = codec->child_start[curr+1] - codec->child_start[curr];
+        uint32_t child_idx = rand() % 100 < USUAL_PERCENT ? 0 : (uint32_t) rand() % n;
+        curr = codec->next[codec->child_start[curr] + child_idx];
+    }
+    if (curr != codec->done) return 0;
+    states[len++] = curr;
+    return len;
+}
+
+// log NUM_PATHS path encodings (they all fit in flash), read them back, and set '*bytes' to the
+// flash they take.
+bool path_records(const path_codec_t *codec, bool compressed, long *bytes){
+    static path_log_t log;
+    clear_flash();
+    path_log_init(&log, 0, FLASH_MEMORY_SIZE, compressed);
+    srand(2);
+    uint32_t states[64];
+    uint8_t record[PATH_LOG_MAX_RECORD];
+    long records = 0;
+    *bytes = 0;
+    for (int p = 0; p < NUM_PATHS; p++){
+        size_t len = usual_path(codec, states, 64);
+        // varint byte counts below 128 are one byte, the same as a length byte.
+        if (len == 0 || path_codec_encode(codec, states, len, record, sizeof(record)) == 0) continue;
+        if (!path_log_append(&log, record)) return false;
+        *bytes += record[0] + 1;
+        records++;
+    }
+    path_log_flush(&log);
+
+    // the same walks again, against what a reader gets back.
+    srand(2);
+    path_log_reader_t reader;
+    path_log_reader_init(&reader, &log, path_log_oldest(&log));
+    uint8_t expected[PATH_LOG_MAX_RECORD];
+    long read = 0, wrong = 0;
+    for (int p = 0; p < NUM_PATHS; p++){
+        size_t len = usual_path(codec, states, 64);
+        if (len == 0 || path_codec_encode(codec, states, len, expected, sizeof(expected)) == 0) continue;
+        if (path_log_read(&reader, record, sizeof(record)) <= 0) break;
+        wrong += 0 != memcmp(record, expected, expected[0] + 1);
+        read++;
+    }
+    printf("%-10s pages: %ld paths, %.2f bytes each, in %u pages (%.1f paths per page), %ld read back, %ld wrong\n",
+        compressed ? "compressed" : "plain", records, (double) *bytes / records, log.seq,
+        (double) records / log.seq, read, wrong);
+    *bytes = (long) log.seq * PATH_LOG_PAGE_SIZE;
+    return read == records && wrong == 0;
+}
+
+int main(void){
+    bool ok = counter_records(false);
+    ok = counter_records(true) && ok;
+
+    const char *start[] = {"A", "B", "C"}, *a[] = {"B", "C", "FAILED"}, *b[] = {"D"};
+    const char *c[] = {"DONE", "FAILED", "A", "D"}, *d[] = {"C", "A", "B", "FAILED"}, *failed[] = {"DONE"};
+    path_codec_state_t graph[] = {
+        {"START", 3, start}, {"A", 3, a}, {"B", 1, b}, {"C", 4, c}, {"D", 4, d}, {"FAILED", 1, failed}, {"DONE", 0, NULL}
+    };
+    path_codec_t codec;
+    if (!path_codec_init(&codec, graph, sizeof(graph) / sizeof(graph[0]))) return 1;
+    long plain_bytes, compressed_bytes;
+    ok = path_records(&codec, false, &plain_bytes) && ok;
+    ok = path_records(&codec, true, &compressed_bytes) && ok;
+    printf("compressed pages hold %.2fx the paths\n", (double) plain_bytes / compressed_bytes);
+
+    // a region that runs past the end of flash is refused, not read out of bounds.
+    static path_log_t outside;
+    bool refused = !path_log_init(&outside, FLASH_MEMORY_SIZE - PATH_LOG_PAGE_SIZE, 2 * PATH_LOG_PAGE_SIZE, false) &&
+        !path_log_init(&outside, UINT32_MAX - PATH_LOG_PAGE_SIZE + 1, 2 * PATH_LOG_PAGE_SIZE, false);
+    printf("region past the end of flash refused: %d\n", refused);
+    ok = refused && ok;
+    path_codec_free(&codec);
+    return ok ? 0 : 1;
+}
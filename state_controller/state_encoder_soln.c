@@ -56,13 +56,25 @@ gcc -g3 -std=c99 -pedantic -Wall -D IMPLEMENTATION=3 -o state_encoder_soln state
 run:
 ./state_encoder_soln
 
+benchmark every implementation over random graphs and paths (ns per path, bytes, round trips):
+make state_bench
+
+benchmark implementation 4 against the encoder state_gen generates from states.def:
+make state_gen_bench
+./state_gen_bench
+
 */
 
 
 #include "stdbool.h"
 #include "stdint.h"
 #include "stdio.h"
+#include "stdlib.h"
 #include "string.h"
+#include "time.h"
+
+#include "bit_stream.h"
+#include "../common/trace.h"
 
 // do not change:
 #define MAX_STATE_NAME_SIZE 16
@@ -85,8 +97,8 @@ typedef char path_t[MAX_PATH_LEN][MAX_STATE_NAME_SIZE];
 #define ENCODING_LEN (MAX_PATH_LEN * (1 + MAX_STATE_NAME_SIZE))
 // 50 * 17 
 #elif IMPLEMENTATION==2
-#define ENCODING_LEN MAX_PATH_LEN
-// 50. implicit assumption is LOG2(MAX_STATES) <= 8
+#define ENCODING_LEN (1 + MAX_PATH_LEN)
+// 51. implicit assumption is LOG2(MAX_STATES) <= 8
 #elif IMPLEMENTATION==3
 #define ENCODING_LEN MAX_PATH_LEN
 // 50. implicit assumption is LOG2(MAX_CHILDREN) <= 8
@@ -100,8 +112,14 @@ typedef char path_t[MAX_PATH_LEN][MAX_STATE_NAME_SIZE];
 // Can also be thought of as the base 2 "information" of a number.
 // Note that n=0 and n=1 return 0, having no information to index these.
 #define BITS_TO_INDEX(n) (((n) > 1) ? 1 + LOG(n-1) : 0)
-#define ENCODING_LEN (1 + MAX_PATH_LEN * BITS_TO_INDEX(MAX_CHILDREN) / 8)
-// 50*2 / 8 = 12
+#define ENCODING_LEN (1 + ((MAX_PATH_LEN - 1) * BITS_TO_INDEX(MAX_CHILDREN) + 7) / 8)
+// 1 + (49*2 + 7) / 8 = 14: a path of MAX_PATH_LEN states has MAX_PATH_LEN - 1 transitions.
+#elif IMPLEMENTATION==5
+// Each state's weights are scaled to sum to 2^PROB_BITS, with every next state getting at least 1,
+// so a transition costs at most PROB_BITS bits (plus rounding), and the coder flushes at most 2 bits.
+#define PROB_BITS 12
+#define ENCODING_LEN (1 + (MAX_PATH_LEN * (PROB_BITS + 1) + 2 + 7) / 8)
+// (50*13 + 9) / 8 + 1 = 83. A likely path takes a fraction of a bit per transition.
 #endif
 
 // do not change:
@@ -109,68 +127,398 @@ typedef uint8_t path_encoding_t[ENCODING_LEN];
 
 // structures used in implementations 2, 3, 4
 char state_names[MAX_STATES][MAX_STATE_NAME_SIZE];
+int num_states;
+// false if path_encoder_init was given a table it cannot index: a name too long or the hash
+// cannot place, or in implementations 3, 4, 5 a next state that is not a state, too many
+// children, or no START or DONE.
+// Encoding and decoding then fail rather than follow the half-built tables.
+bool encoder_ready;
+
+// Perfect hash from state name to index in state_names, built by path_encoder_init.
+// A name's FNV-1a hash picks a bucket; each bucket has a displacement, chosen at init so
+// that mixing the hash with it sends every name to its own slot. A lookup is one pass over
+// the name and one compare against the only name that can be in its slot.
+#define STATE_HASH_BUCKETS 64
+#define STATE_HASH_SLOTS 256
+uint8_t state_hash_displacement[STATE_HASH_BUCKETS];
+uint8_t state_hash_slots[STATE_HASH_SLOTS]; // 1 + state index, 0 if empty
+
+uint32_t state_name_hash(const char *state){
+    uint32_t hash = 2166136261u;
+    for ( ; *state != '\0'; state++){
+        hash = (hash ^ (uint8_t) *state) * 16777619u;
+    }
+    return hash;
+}
+
+int state_hash_slot(uint32_t hash, uint8_t displacement){
+    // murmur3 finalizer, so every displacement gives an unrelated slot.
+    hash += displacement * 0x9E3779B9u;
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return hash % STATE_HASH_SLOTS;
+}
+
 int state_index(char *state){
-    for (int i = 0; i < MAX_STATES; i++){
-        if (0 == strcmp(state_names[i], state)) return i;
+    uint32_t hash = state_name_hash(state);
+    int slot = state_hash_slot(hash, state_hash_displacement[hash % STATE_HASH_BUCKETS]);
+    int i = state_hash_slots[slot] - 1;
+    if (i == -1 || 0 != strcmp(state_names[i], state)) return -1;
+    return i;
+}
+
+// fill the hash tables for state_names[0, num_states). Buckets are placed largest first,
+// each at the first displacement where all its names land in empty, distinct slots.
+bool state_hash_init(void){
+    uint32_t hashes[MAX_STATES];
+    int bucket_sizes[STATE_HASH_BUCKETS] = { 0 };
+    int max_bucket_size = 0;
+    memset(state_hash_slots, 0, sizeof(state_hash_slots));
+    memset(state_hash_displacement, 0, sizeof(state_hash_displacement));
+    for (int i = 0; i < num_states; i++){
+        hashes[i] = state_name_hash(state_names[i]);
+        int size = ++bucket_sizes[hashes[i] % STATE_HASH_BUCKETS];
+        if (size > max_bucket_size) max_bucket_size = size;
     }
-    return -1;
+    for (int size = max_bucket_size; size > 0; size--){
+        for (int bucket = 0; bucket < STATE_HASH_BUCKETS; bucket++){
+            if (bucket_sizes[bucket] != size) continue;
+            bool placed = false;
+            for (int displacement = 0; displacement < 256 && !placed; displacement++){
+                placed = true;
+                for (int i = 0; i < num_states; i++){
+                    if (hashes[i] % STATE_HASH_BUCKETS != bucket) continue;
+                    int slot = state_hash_slot(hashes[i], displacement);
+                    if (state_hash_slots[slot] != 0) placed = false; // taken by another bucket, or by this one
+                    if (placed) state_hash_slots[slot] = i + 1;
+                }
+                if (!placed){
+                    // undo this attempt
+                    for (int slot = 0; slot < STATE_HASH_SLOTS; slot++){
+                        int i = state_hash_slots[slot] - 1;
+                        if (i != -1 && hashes[i] % STATE_HASH_BUCKETS == bucket) state_hash_slots[slot] = 0;
+                    }
+                    continue;
+                }
+                state_hash_displacement[bucket] = displacement;
+            }
+            if (!placed) return false;
+        }
+    }
+    return true;
 }
 
-// structures used in implementations 3, 4
+// structures used in implementations 3, 4, 5
 state_graph_t _state_graph;
-int child_index(state_t state, char *child){
-    for (int i = 0; i < state.num_children; i++){
-        if (0 == strcmp(state.next_states[i], child)) return i;
+int start_state, done_state;
+// child_indexes[s][t] is the position of state t among the next states of state s, or -1.
+int8_t child_indexes[MAX_STATES][MAX_STATES];
+// next_state_indexes[s][c] is the state index of the c'th next state of state s.
+uint8_t next_state_indexes[MAX_STATES][MAX_CHILDREN];
+int child_index(int state_idx, int child_state_idx){
+    return child_indexes[state_idx][child_state_idx];
+}
+#if IMPLEMENTATION == 4
+// BITS_TO_INDEX(num_children) of every state.
+uint8_t child_bits[MAX_STATES];
+#elif IMPLEMENTATION == 5
+// The next states of state s split 2^PROB_BITS into slots, most likely first: slot k holds
+// next state child_order[s][k] and covers [child_cum[s][k], child_cum[s][k+1]). child_slot[s][c]
+// is the slot of next state c. Keeping the likely transitions at the bottom keeps 'low' at 0, so
+// a run of them only adds zero bits, which the encoding can leave off its end.
+uint16_t child_cum[MAX_STATES][MAX_CHILDREN + 1];
+uint8_t child_order[MAX_STATES][MAX_CHILDREN];
+uint8_t child_slot[MAX_STATES][MAX_CHILDREN];
+// weights[s][c] is the relative frequency of the c'th next state of state s, by position in the
+// state graph. A state whose weights are all zero has every next state equally likely.
+typedef uint16_t state_weights_t[MAX_STATES][MAX_CHILDREN];
+state_weights_t state_weights;
+
+// scale the weights of state i to sum to 2^PROB_BITS, none below 1, and order its slots.
+void child_cum_init(int i){
+    int n = _state_graph[i].num_children;
+    uint32_t freqs[MAX_CHILDREN];
+    uint32_t sum = 0, scaled_sum = 0;
+    for (int c = 0; c < n; c++){
+        sum += state_weights[i][c];
+    }
+    for (int c = 0; c < n; c++){
+        uint32_t weight = sum == 0 ? 1 : state_weights[i][c];
+        freqs[c] = (uint64_t) weight * (1 << PROB_BITS) / (sum == 0 ? n : sum);
+        if (freqs[c] == 0) freqs[c] = 1;
+        scaled_sum += freqs[c];
+    }
+    // insertion sort by decreasing frequency; ties keep graph order.
+    for (int k = 0; k < n; k++){
+        int c = k;
+        for ( ; c > 0 && freqs[child_order[i][c-1]] < freqs[k]; c--){
+            child_order[i][c] = child_order[i][c-1];
+        }
+        child_order[i][c] = k;
+    }
+    // give the rounding error to the most likely next state, where it costs the least.
+    if (n > 0) freqs[child_order[i][0]] += (1 << PROB_BITS) - scaled_sum;
+    child_cum[i][0] = 0;
+    for (int k = 0; k < n; k++){
+        child_slot[i][child_order[i][k]] = k;
+        child_cum[i][k+1] = child_cum[i][k] + freqs[child_order[i][k]];
     }
-    return -1;
 }
+#endif
 
 // This will be called once. You may store any global variables that may be helpful for efficent encode/decode.
 void path_encoder_init(state_graph_t state_graph){
     #if IMPLEMENTATION == 1
-    #elif IMPLEMENTATION == 2 || IMPLEMENTATION == 3 || IMPLEMENTATION == 4
-    // memset(state_names, 0, sizeof(state_names));
-    for (int i=0; state_graph[i].name != NULL; i++){
-        strcpy(state_names[i], state_graph[i].name);
+    #elif IMPLEMENTATION == 2 || IMPLEMENTATION == 3 || IMPLEMENTATION == 4 || IMPLEMENTATION == 5
+    memset(state_names, 0, sizeof(state_names));
+    encoder_ready = true;
+    for (num_states = 0; num_states < MAX_STATES && state_graph[num_states].name != NULL; num_states++){
+        if (strlen(state_graph[num_states].name) >= MAX_STATE_NAME_SIZE){
+            encoder_ready = false;
+            continue;
+        }
+        strcpy(state_names[num_states], state_graph[num_states].name);
     }
+    encoder_ready = encoder_ready && state_hash_init();
     #endif
-    #if IMPLEMENTATION == 3 || IMPLEMENTATION == 4
+    #if IMPLEMENTATION == 3 || IMPLEMENTATION == 4 || IMPLEMENTATION == 5
     memcpy(&_state_graph, state_graph, sizeof(state_graph_t));
+    memset(child_indexes, -1, sizeof(child_indexes));
+    memset(next_state_indexes, 0, sizeof(next_state_indexes));
+    #if IMPLEMENTATION == 5
+    memset(state_weights, 0, sizeof(state_weights));
+    #endif
+    for (int i = 0; i < num_states; i++){
+        if (_state_graph[i].num_children < 0 || _state_graph[i].num_children > MAX_CHILDREN){
+            encoder_ready = false;
+            continue;
+        }
+        for (int j = 0; j < _state_graph[i].num_children; j++){
+            char *name = _state_graph[i].next_states[j];
+            int child_state_idx = name == NULL ? -1 : state_index(name);
+            if (child_state_idx == -1){
+                encoder_ready = false;
+                continue;
+            }
+            next_state_indexes[i][j] = child_state_idx;
+            child_indexes[i][child_state_idx] = j;
+        }
+        #if IMPLEMENTATION == 4
+        child_bits[i] = BITS_TO_INDEX(_state_graph[i].num_children);
+        #elif IMPLEMENTATION == 5
+        child_cum_init(i);
+        #endif
+    }
+    start_state = state_index("START");
+    done_state = state_index("DONE");
+    encoder_ready = encoder_ready && start_state != -1 && done_state != -1;
     #endif
 }
 
-// store num_bits low order bits from value into bit index idx of the bit_array.
-bool bit_array_set(uint8_t * bit_array, uint8_t idx, uint8_t num_bits, uint8_t value){
-    int byte_position = idx / 8;
-    int bit_position = idx % 8; // e.g. 14 is remainder 6 into second byte
-    if (num_bits > 8) return false;
-    uint8_t value_low_order_bits = value & ((1 << num_bits) - 1);
-    uint8_t value_shifted = value_low_order_bits << bit_position;
+#if IMPLEMENTATION == 5
+/* path_encoder_set_weights
+ * give the next states of every state relative frequencies (see state_weights_t), so likely
+ * transitions take fewer bits. Call after path_encoder_init, which makes them all equally likely.
+ * A path encoded with one set of weights only decodes with the same set.
+*/
+void path_encoder_set_weights(state_weights_t weights){
+    memcpy(state_weights, weights, sizeof(state_weights_t));
+    for (int i = 0; i < num_states; i++){
+        if (_state_graph[i].num_children >= 0 && _state_graph[i].num_children <= MAX_CHILDREN) child_cum_init(i);
+    }
+}
+
+/* Implementation 5: arithmetic coding of the child indexes.
+ * Implementation 4 spends BITS_TO_INDEX(num_children) bits on every transition. Here each
+ * transition narrows an interval [low, high] in proportion to the next state's weight, so a
+ * transition taken 95% of the time costs about 0.07 bits, and one with a single next state
+ * costs nothing. The coder starts afresh for every path and flushes at the end, so each
+ * encoding still stands alone; a path made of likely transitions encodes in zero bytes.
+ * Bits are stored from bit 8 on, low order bit first, as in implementation 4; the decoder reads
+ * zeros past the end.
+*/
+#define CODE_HALF (1u << 31)
+#define CODE_QUARTER (1u << 30)
+
+typedef struct {
+    uint32_t low;
+    uint32_t high;
+    uint32_t value;   // decoder only: the code bits under the interval
+    int pending;      // encoder only: straddling bits waiting for the next decided bit
+    bit_writer_t writer;
+    bit_reader_t reader;
+} arith_coder_t;
 
-    // store the first 8 - bit_position bits of value in the bit_position and above high order bits of byte_position.
-    bit_array[byte_position] &= (1 << bit_position) - 1; // clear the high order bits of byte_position
-    bit_array[byte_position] |= value_shifted;
+// write 'bit', then the pending bits, which are its opposite, a word at a time.
+bool arith_put_bits(arith_coder_t *coder, int bit){
+    bool ok = bit_writer_put(&coder->writer, bit, 1);
+    for ( ; coder->pending > 0 && ok; coder->pending -= BIT_STREAM_MAX_WIDTH){
+        int width = coder->pending < BIT_STREAM_MAX_WIDTH ? coder->pending : BIT_STREAM_MAX_WIDTH;
+        ok = bit_writer_put(&coder->writer, bit ? 0 : UINT64_MAX, width);
+    }
+    coder->pending = 0;
+    return ok;
+}
 
-    int num_bits_remaining = num_bits - (8 - bit_position);
-    if (num_bits_remaining <= 0) return true; // done
+// narrow the interval to [cum_low, cum_high) out of 2^PROB_BITS.
+void arith_narrow(arith_coder_t *coder, uint32_t cum_low, uint32_t cum_high){
+    uint64_t range = (uint64_t) coder->high - coder->low + 1;
+    coder->high = coder->low + (uint32_t) ((range * cum_high) >> PROB_BITS) - 1;
+    coder->low = coder->low + (uint32_t) ((range * cum_low) >> PROB_BITS);
+}
 
-    value_shifted = value_low_order_bits >> (8 - bit_position);
+bool arith_encode(arith_coder_t *coder, uint32_t cum_low, uint32_t cum_high){
+    arith_narrow(coder, cum_low, cum_high);
+    for (;;){
+        if (coder->high < CODE_HALF){
+            if (!arith_put_bits(coder, 0)) return false;
+        } else if (coder->low >= CODE_HALF){
+            if (!arith_put_bits(coder, 1)) return false;
+            coder->low -= CODE_HALF;
+            coder->high -= CODE_HALF;
+        } else if (coder->low >= CODE_QUARTER && coder->high < CODE_HALF + CODE_QUARTER){
+            coder->pending++;
+            coder->low -= CODE_QUARTER;
+            coder->high -= CODE_QUARTER;
+        } else {
+            return true;
+        }
+        coder->low <<= 1;
+        coder->high = coder->high << 1 | 1;
+    }
+}
 
-    bit_array[byte_position + 1] = bit_array[byte_position + 1] >> num_bits_remaining << num_bits_remaining; // clear the low order bits of this position
-    bit_array[byte_position + 1] |= value_shifted;
+// write the fewest bits that, followed by the zeros the decoder reads past the end, give a value
+// inside [low, high]. At most 2 bits past the pending ones, and often none: a likely path keeps
+// low at 0, so its encoding can end with the last decided bit.
+bool arith_encode_finish(arith_coder_t *coder){
+    int k = 0;
+    uint64_t value = coder->low;
+    for ( ; k < 32; k++){
+        uint64_t step = (uint64_t) 1 << (32 - k);
+        value = (coder->low + step - 1) / step * step; // low rounded up to k significant bits
+        if (value <= coder->high) break;
+    }
+    if (coder->pending > 0 && k == 0) k = 1; // the pending bits follow a decided bit
+    for (int i = 0; i < k; i++){
+        int bit = (value >> (31 - i)) & 1;
+        if (!(i == 0 ? arith_put_bits(coder, bit) : bit_writer_put(&coder->writer, bit, 1))) return false;
+    }
     return true;
 }
 
-uint8_t bit_array_get(uint8_t * bit_array, uint8_t idx, uint8_t num_bits){
-    int byte_position = idx / 8;
-    int bit_position = idx % 8;
-    int num_bits_remaining = num_bits - (8 - bit_position);
+void arith_decode_start(arith_coder_t *coder){
+    for (int i = 0; i < 32; i++){
+        coder->value = coder->value << 1 | bit_reader_get(&coder->reader, 1);
+    }
+}
+
+// return the slot whose range holds the current value, given the cumulative weights of 'num_children' slots.
+int arith_decode(arith_coder_t *coder, const uint16_t *cum, int num_children){
+    uint64_t range = (uint64_t) coder->high - coder->low + 1;
+    uint32_t count = ((((uint64_t) coder->value - coder->low + 1) << PROB_BITS) - 1) / range;
+    int c = 0;
+    while (c + 1 < num_children && count >= cum[c+1]) c++;
+    arith_narrow(coder, cum[c], cum[c+1]);
+    for (;;){
+        if (coder->high < CODE_HALF){
+        } else if (coder->low >= CODE_HALF){
+            coder->low -= CODE_HALF;
+            coder->high -= CODE_HALF;
+            coder->value -= CODE_HALF;
+        } else if (coder->low >= CODE_QUARTER && coder->high < CODE_HALF + CODE_QUARTER){
+            coder->low -= CODE_QUARTER;
+            coder->high -= CODE_QUARTER;
+            coder->value -= CODE_QUARTER;
+        } else {
+            return c;
+        }
+        coder->low <<= 1;
+        coder->high = coder->high << 1 | 1;
+        coder->value = coder->value << 1 | bit_reader_get(&coder->reader, 1);
+    }
+}
+#endif
+
+// path_encoder_encode_ids, less its trace span.
+static bool encode_ids(const uint8_t *states, int len, path_encoding_t encoding){
+    memset(encoding, 0, sizeof(path_encoding_t));
+    #if IMPLEMENTATION == 1
+    return false;
+    #else
+    if (!encoder_ready || len < 1 || len > MAX_PATH_LEN) return false;
+    for (int i = 0; i < len; i++){
+        if (states[i] >= num_states){
+            printf("state index %d not found in _state_graph\n", states[i]);
+            return false;
+        }
+    }
+    #endif
+    #if IMPLEMENTATION == 2
+    if (len > sizeof(path_encoding_t) - 1) return false;
+    for (int i = 0; i < len; i++){
+        encoding[i+1] = states[i];
+    }
+    encoding[0] = len;
+    #elif IMPLEMENTATION == 3
+    for (int i = 0; i + 1 < len; i++){
+        int child_idx = child_index(states[i], states[i+1]);
+        if (child_idx == -1) {
+            printf("state %s in path is not a next state of %s\n", state_names[states[i+1]], state_names[states[i]]);
+            return false; // child is not in children
+        }
+        encoding[i+1] = child_idx;
+    }
+    encoding[0] = len - 1;
+    #elif IMPLEMENTATION == 4
+    bit_writer_t writer;
+    bit_writer_init(&writer, &encoding[1], sizeof(path_encoding_t) - 1);
+    for (int i = 0; i + 1 < len; i++){
+        int child_idx = child_index(states[i], states[i+1]);
+        if (child_idx == -1) {
+            printf("state %s in path is not a next state of %s\n", state_names[states[i+1]], state_names[states[i]]);
+            return false; // child is not in children
+        }
+        if (!bit_writer_put(&writer, child_idx, child_bits[states[i]])) return false;
+    }
+    encoding[0] = (bit_writer_bits(&writer) + 7) / 8; // ceiling division by 8, not floor division.
+    #elif IMPLEMENTATION == 5
+    arith_coder_t coder = { .low = 0, .high = UINT32_MAX };
+    bit_writer_init(&coder.writer, &encoding[1], sizeof(path_encoding_t) - 1);
+    for (int i = 0; i + 1 < len; i++){
+        int child_idx = child_index(states[i], states[i+1]);
+        if (child_idx == -1) {
+            printf("state %s in path is not a next state of %s\n", state_names[states[i+1]], state_names[states[i]]);
+            return false; // child is not in children
+        }
+        if (_state_graph[states[i]].num_children < 2) continue; // no choice, no bits
+        int slot = child_slot[states[i]][child_idx];
+        if (!arith_encode(&coder, child_cum[states[i]][slot], child_cum[states[i]][slot+1])) return false;
+    }
+    if (!arith_encode_finish(&coder)) return false;
+    // the decoder reads zeros past the end, so trailing zero bytes need not be stored.
+    int bytes = (bit_writer_bits(&coder.writer) + 7) / 8;
+    while (bytes > 0 && encoding[bytes] == 0) bytes--;
+    encoding[0] = bytes;
+    #endif
 
-    uint8_t low_order_bits = bit_array[byte_position] >> bit_position;
-    if (num_bits_remaining <= 0) return low_order_bits & ((1 << num_bits) - 1); // clear the high order bits not asked for, then done.
-    uint8_t high_order_bits = bit_array[byte_position+1] & ((1 << num_bits_remaining) - 1); // keep the low order bits of the second byte.
+    return true;
+}
 
-    return (high_order_bits << (8 - bit_position)) | low_order_bits;
+/* path_encoder_encode_ids
+ * fast path for callers that already know state indexes: the position of each state in the
+ * state graph given to path_encoder_init. fills 'encoding' with the encoding of the 'len'
+ * states in 'states', in the same format path_encoder_encode produces. No names are touched.
+ * return true if successful, else false. Not available in implementation 1, which stores names.
+*/
+bool path_encoder_encode_ids(const uint8_t *states, int len, path_encoding_t encoding){
+    TRACE_BEGIN("path_encoder_encode_ids");
+    bool ok = encode_ids(states, len, encoding);
+    TRACE_END("path_encoder_encode_ids");
+    return ok;
 }
 
 // fills the encoding variable with the encoding of path.
@@ -179,64 +527,109 @@ bool path_encoder_encode(path_t path, path_encoding_t encoding){
     memset(encoding, 0, sizeof(path_encoding_t));
     #if IMPLEMENTATION == 1
     int j = 1;
-    for (int i=0, len=0; 0 != strcmp(path[i], ""); i++){
+    for (int i=0, len=0; i < MAX_PATH_LEN && 0 != strcmp(path[i], ""); i++){
         len = strlen(path[i]);
         if (j + len + 1 > sizeof(path_encoding_t)) return false;
         memcpy(&encoding[j], path[i], len+1);
         j += len+1;
     }
     encoding[0] = j-1;
-    #elif IMPLEMENTATION == 2
-    int i = 0;
-    for ( ; 0 != strcmp(path[i], ""); i++){
-        int state_idx = state_index(path[i]);
+    return true;
+    #else
+    // hash every name once, then encode by index.
+    uint8_t states[MAX_PATH_LEN];
+    int len = 0;
+    for ( ; len < MAX_PATH_LEN && path[len][0] != '\0'; len++){
+        int state_idx = state_index(path[len]);
         if (state_idx == -1){
-            printf("state %s not found in _state_graph\n", path[i]);
+            printf("state %s not found in _state_graph\n", path[len]);
             return false;
         }
-        encoding[i+1] = state_index(path[i]);
-        if (i > sizeof(path_encoding_t)) return false;
+        states[len] = state_idx;
     }
-    encoding[0] = i;
-    #elif IMPLEMENTATION == 3
-    int i = 0;
-    for ( ; 0 != strcmp(path[i+1], ""); i++){
-        int state_idx = state_index(path[i]);
-        if (state_idx == -1){
-            printf("state %s not found in _state_graph\n", path[i]);
+    return path_encoder_encode_ids(states, len, encoding);
+    #endif
+}
+
+/* path_encoder_decode_ids
+ * inverse of path_encoder_encode_ids: fill 'states' (room for MAX_PATH_LEN) with the state indexes
+ * encoded by 'encoding' and set '*len' to their number. On failure '*len' covers the states decoded
+ * before the error. return true if successful, else false. Not available in implementation 1.
+*/
+bool path_encoder_decode_ids(path_encoding_t encoding, uint8_t *states, int *len){
+    *len = 0;
+    #if IMPLEMENTATION == 1
+    return false;
+    #else
+    if (!encoder_ready) return false;
+    #endif
+    #if IMPLEMENTATION == 2
+    for (int i=0; i < encoding[0] && i < MAX_PATH_LEN; i++){
+        if (encoding[i+1] >= num_states){
+            printf("encoded digit does not name a state: %d\n", encoding[i+1]);
             return false;
         }
-        int child_idx = child_index(_state_graph[state_idx], path[i+1]);
-        if (child_idx == -1) {
-            printf("state %s in path is not a next state of %s\n", path[i+1], path[i]);
-            return false; // child is not in children
+        states[(*len)++] = encoding[i+1];
+    }
+    return true;
+    #elif IMPLEMENTATION == 3
+    // walk the graph by state index.
+    int curr = start_state;
+    for (int i = 0; i < MAX_PATH_LEN; i++){
+        states[(*len)++] = curr;
+        if (i == encoding[0]) return true;
+        int child_idx = encoding[i+1];
+        if (child_idx >= _state_graph[curr].num_children) {
+            printf("encoded digit breaks state semantics: %d\n", encoding[i+1]);
+            return false;
         }
-        encoding[i+1] = child_idx;
+        curr = next_state_indexes[curr][child_idx];
     }
-    encoding[0] = i;
+    return false;
     #elif IMPLEMENTATION == 4
-    int j = 8;
-    for (int i = 0; 0 != strcmp(path[i+1], ""); i++){
-        int state_idx = state_index(path[i]);
-        if (state_idx == -1){
-            printf("state %s not found in _state_graph\n", path[i]);
+    // walk the graph by state index. States with one child take no bits, so the walk ends
+    // at DONE, not when the bits run out.
+    bit_reader_t reader;
+    bit_reader_init(&reader, &encoding[1], encoding[0]);
+    int curr = start_state;
+    for (int i = 0; i < MAX_PATH_LEN; i++){
+        states[(*len)++] = curr;
+        if (curr == done_state) return true;
+        int bits_needed_to_index = child_bits[curr];
+        if (bits_needed_to_index > bit_reader_left(&reader)){
+            printf("encoding ends before DONE\n");
             return false;
         }
-        int child_idx = child_index(_state_graph[state_idx], path[i+1]);
-        if (child_idx == -1) {
-            printf("state %s in path is not a next state of %s\n", path[i+1], path[i]);
-            return false; // child is not in children
+        int child_idx = bit_reader_get(&reader, bits_needed_to_index);
+        if (child_idx >= _state_graph[curr].num_children) {
+            printf("encoded digit breaks state semantics: %d\n", encoding[1 + (reader.pos - 1) / 8]);
+            return false;
         }
-        int bits_needed_to_index = BITS_TO_INDEX(_state_graph[state_idx].num_children);
-        if (bits_needed_to_index > 0){
-            bit_array_set(encoding, j, bits_needed_to_index, child_idx);
-            j += bits_needed_to_index;
+        curr = next_state_indexes[curr][child_idx];
+    }
+    return false;
+    #elif IMPLEMENTATION == 5
+    // walk the graph by state index, decoding a child wherever there is a choice.
+    arith_coder_t coder = { .low = 0, .high = UINT32_MAX };
+    bit_reader_init(&coder.reader, &encoding[1], encoding[0]);
+    arith_decode_start(&coder);
+    int curr = start_state;
+    for (int i = 0; i < MAX_PATH_LEN; i++){
+        states[(*len)++] = curr;
+        if (curr == done_state) return true;
+        int num_children = _state_graph[curr].num_children;
+        if (num_children == 0){
+            printf("state %s has no next state before DONE\n", state_names[curr]);
+            return false;
         }
+        int child_idx = 0;
+        if (num_children > 1){
+            child_idx = child_order[curr][arith_decode(&coder, child_cum[curr], num_children)];
+        }
+        curr = next_state_indexes[curr][child_idx];
     }
-    encoding[0] = (j-8 + 7) / 8; // -8 is because j started at 8; +7 is because we want ceiling division by 8, not floor division.
+    return false;
     #endif
-
-    return true;
 }
 
 // fill path with the state history encoded by encoding. Assume encoding was produced by path_encoder_encode.
@@ -244,64 +637,188 @@ bool path_encoder_decode(path_encoding_t encoding, path_t path){
     memset(path, 0, sizeof(path_t));
     #if IMPLEMENTATION == 1
     int i, j, len;
-    for (i=1, j=0, len=0; i < encoding[0]; i++, len++){
+    for (i=1, j=0, len=0; i <= encoding[0]; i++, len++){
         if (encoding[i] == 0){
-            if (len > MAX_STATE_NAME_SIZE) return false;
+            if (len > MAX_STATE_NAME_SIZE || j == MAX_PATH_LEN) return false;
             memcpy(path[j++], &encoding[i-len], len);
             len = -1;
             // if (encoding[i+1] == 0) break;
         }
     }
-    strcpy(path[j], "");
-    #elif IMPLEMENTATION == 2
-    for (int i=0; i < encoding[0]; i++){ // sizeof(path_encoding_t) && encoding[i] != 0
-        if (0 == strcmp("",state_names[encoding[i+1]])){
-            printf("encoded digit does not name a state: %d\n", encoding[i+1]);
-            return false;
+    if (j < MAX_PATH_LEN) strcpy(path[j], ""); // a full path has no room for the end marker
+    return true;
+    #else
+    // decode by index, then copy the names out.
+    uint8_t states[MAX_PATH_LEN];
+    int len;
+    bool ok = path_encoder_decode_ids(encoding, states, &len);
+    for (int i = 0; i < len; i++){
+        strcpy(path[i], state_names[states[i]]);
+    }
+    return ok;
+    #endif
+}
+
+#if IMPLEMENTATION == 4
+/* Batch decoding for offline analysis of implementation 4 logs.
+ * decode_table[s][w] holds what the next BATCH_WINDOW_BITS bits 'w' decode to from state s:
+ * up to BATCH_MAX_STEPS next states, and the bits used up after each. States with one next state
+ * use no bits, so a lookup often covers more transitions than there are bits. Each lookup is one
+ * 64-bit load through bit_reader_peek.
+*/
+#define BATCH_WINDOW_BITS 8
+#define BATCH_MAX_STEPS 8
+
+typedef struct {
+    uint8_t states[BATCH_MAX_STEPS];
+    uint8_t bits[BATCH_MAX_STEPS];    // bits used after states[0..k]
+    uint8_t count;                    // transitions decoded; 0 if the first child index is invalid
+} decode_step_t;
+
+decode_step_t decode_table[MAX_STATES][1 << BATCH_WINDOW_BITS];
+
+// fill decode_table. Call after path_encoder_init.
+void path_encoder_batch_init(void){
+    if (!encoder_ready) return; // decode_packed fails every path
+    for (int s = 0; s < num_states; s++){
+        for (int w = 0; w < (1 << BATCH_WINDOW_BITS); w++){
+            decode_step_t *entry = &decode_table[s][w];
+            int curr = s, used = 0;
+            entry->count = 0;
+            while (entry->count < BATCH_MAX_STEPS && curr != done_state && _state_graph[curr].num_children > 0){
+                int bits_needed_to_index = child_bits[curr];
+                if (used + bits_needed_to_index > BATCH_WINDOW_BITS) break;
+                int child_idx = (w >> used) & ((1 << bits_needed_to_index) - 1);
+                if (child_idx >= _state_graph[curr].num_children) break;
+                used += bits_needed_to_index;
+                curr = next_state_indexes[curr][child_idx];
+                entry->states[entry->count] = curr;
+                entry->bits[entry->count++] = used;
+            }
         }
-        strcpy(path[i], state_names[encoding[i+1]]);
     }
-    #elif IMPLEMENTATION == 3
-    char curr[MAX_STATE_NAME_SIZE] = "START";
-    for (int i = 0; ; i++){
-        strcpy(path[i], curr);
-        if (i == encoding[0]) return true;
-        int child_idx = encoding[i+1];
-        int state_idx = state_index(curr);
-        if (state_idx == -1){
-            printf("encoded state %s not found\n", curr);
-            return false;
+}
+
+// decode the encoding at buf[pos] with decode_table into 'out' (room for MAX_PATH_LEN).
+// return the path length, or -1 where path_encoder_decode_ids would fail.
+int decode_packed(const uint8_t *buf, size_t buf_len, size_t pos, uint8_t *out){
+    if (!encoder_ready) return -1;
+    size_t payload = pos + 1;
+    uint32_t limit = 8 * buf[pos]; // payload bits
+    int len = 0, curr = start_state;
+    // read on into the following encodings rather than stop at the payload's end.
+    bit_reader_t reader;
+    bit_reader_init(&reader, &buf[payload], buf_len - payload);
+    out[len++] = curr;
+    while (curr != done_state && len < MAX_PATH_LEN){
+        const decode_step_t *entry = &decode_table[curr][bit_reader_peek(&reader, BATCH_WINDOW_BITS)];
+        if (entry->count > 0 && len + BATCH_MAX_STEPS <= MAX_PATH_LEN && reader.pos + entry->bits[entry->count-1] <= limit){
+            // the usual case: take every step at once.
+            memcpy(&out[len], entry->states, BATCH_MAX_STEPS);
+            len += entry->count;
+            bit_reader_skip(&reader, entry->bits[entry->count-1]);
+            curr = out[len-1];
+            continue;
         }
-        if (_state_graph[state_idx].next_states[child_idx] == NULL) {
-            printf("encoded digit breaks state semantics: %d\n", encoding[i+1]);
-            return false;
+        // bits past the payload belong to the next encoding: stop before the steps that use them.
+        int k = 0;
+        while (k < entry->count && len < MAX_PATH_LEN && reader.pos + entry->bits[k] <= limit){
+            out[len++] = entry->states[k++];
         }
-        strcpy(curr, _state_graph[state_idx].next_states[child_idx]);
+        if (k == 0) break; // invalid child index, or the encoding ends before DONE
+        bit_reader_skip(&reader, entry->bits[k-1]);
+        curr = out[len-1];
     }
-    #elif IMPLEMENTATION == 4
-    char curr[MAX_STATE_NAME_SIZE] = "START";
-    for (int i = 0, j = 8; ; i++){
-        strcpy(path[i], curr);
-        if (j / 8 >= encoding[0] + 1 || 0 == strcmp(curr, "DONE")) return true;
-        int state_idx = state_index(curr);
-        if (state_idx == -1){
-            printf("encoded state %s not found\n", curr);
-            return false;
+    return curr == done_state ? len : -1;
+}
+
+/* path_encoder_decode_batch
+ * decode the encodings stored back to back in 'buf' (each encoding[0] + 1 bytes, as path_log
+ * records them), at most 'max_paths' of them. Path p's state indexes go to
+ * states[p * MAX_PATH_LEN, ...) and its length to lens[p], or -1 where path_encoder_decode_ids
+ * would fail. return the number of encodings read.
+*/
+int path_encoder_decode_batch(const uint8_t *buf, size_t buf_len, uint8_t *states, int *lens, int max_paths){
+    size_t pos = 0;
+    int p = 0;
+    for ( ; p < max_paths && pos < buf_len && pos + buf[pos] < buf_len; p++){
+        lens[p] = decode_packed(buf, buf_len, pos, &states[(size_t) p * MAX_PATH_LEN]);
+        pos += buf[pos] + 1;
+    }
+    return p;
+}
+
+/* Log queries: what happened across many logged paths, for SLA and stuck controller checks.
+ * path_stats_add scans a buffer of encodings in one pass, decoding each path into a
+ * MAX_PATH_LEN scratch array and folding it into fixed size counters, so any amount of log can
+ * be streamed through, a buffer (or a path_log page) at a time.
+*/
+typedef struct {
+    long paths;
+    long bad_paths;                                   // not decodable; left out of the counts below
+    long failed_paths;                                // paths through FAILED
+    long visits[MAX_STATES];                          // paths through a state count once per visit
+    long transitions[MAX_STATES][MAX_CHILDREN];       // [state][child index]
+    long lengths[MAX_PATH_LEN + 1];                   // paths by number of states
+} path_stats_t;
+
+void path_stats_init(path_stats_t *stats){
+    memset(stats, 0, sizeof(path_stats_t));
+}
+
+// add the encodings stored back to back in 'buf'. return the number added.
+long path_stats_add(path_stats_t *stats, const uint8_t *buf, size_t buf_len){
+    int failed_state = state_index("FAILED");
+    uint8_t states[MAX_PATH_LEN];
+    long count = 0;
+    for (size_t pos = 0; pos < buf_len && pos + buf[pos] < buf_len; pos += buf[pos] + 1, count++){
+        stats->paths++;
+        int len = decode_packed(buf, buf_len, pos, states);
+        if (len == -1){
+            stats->bad_paths++;
+            continue;
         }
-        int bits_needed_to_index = BITS_TO_INDEX(_state_graph[state_idx].num_children);
-        int child_idx = bit_array_get(encoding, j, bits_needed_to_index);
-        j += bits_needed_to_index;
-        if (child_idx >= _state_graph[state_idx].num_children) {
-            printf("encoded digit breaks state semantics: %d\n", encoding[j/8]);
-            return false;
+        stats->lengths[len]++;
+        bool failed = false;
+        stats->visits[states[0]]++;
+        for (int i = 1; i < len; i++){
+            stats->visits[states[i]]++;
+            stats->transitions[states[i-1]][child_index(states[i-1], states[i])]++;
+            failed |= states[i] == failed_state;
         }
-        strcpy(curr, _state_graph[state_idx].next_states[child_idx]);
+        stats->failed_paths += failed;
     }
-    #endif
+    return count;
+}
 
-    return true;
+// smallest path length with at least 'fraction' of the decodable paths at or below it.
+int path_stats_length_percentile(const path_stats_t *stats, double fraction){
+    long good = stats->paths - stats->bad_paths, seen = 0;
+    for (int len = 0; len <= MAX_PATH_LEN; len++){
+        seen += stats->lengths[len];
+        if (good > 0 && seen >= fraction * good) return len;
+    }
+    return 0;
+}
+
+void path_stats_print(const path_stats_t *stats){
+    long good = stats->paths - stats->bad_paths;
+    printf("paths: %ld, not decodable: %ld, through FAILED: %ld (%.2f%%)\n", stats->paths, stats->bad_paths,
+        stats->failed_paths, good > 0 ? 100.0 * stats->failed_paths / good : 0.0);
+    printf("path length: p50 %d, p90 %d, p99 %d, max %d states\n", path_stats_length_percentile(stats, 0.5),
+        path_stats_length_percentile(stats, 0.9), path_stats_length_percentile(stats, 0.99),
+        path_stats_length_percentile(stats, 1.0));
+    for (int s = 0; s < num_states; s++){
+        printf("%-*s visits %9ld", MAX_STATE_NAME_SIZE, state_names[s], stats->visits[s]);
+        for (int c = 0; c < _state_graph[s].num_children; c++){
+            printf("  -> %s %ld", state_names[next_state_indexes[s][c]], stats->transitions[s][c]);
+        }
+        printf("\n");
+    }
 }
+#endif
 
+#ifndef BENCH
 int main(void){
     state_graph_t state_graph = {
         {.name = "START", .num_children = 3, .next_states = {"A", "B", "C"}},
@@ -315,6 +832,16 @@ int main(void){
 
     printf("encoder init\n");
     path_encoder_init(state_graph);
+    #if IMPLEMENTATION == 5
+    // how often each next state is taken, by position in state_graph.
+    state_weights_t weights = {
+        [0] = {3, 95, 2},
+        [1] = {95, 4, 1},
+        [3] = {95, 1, 2, 2},
+        [4] = {1, 2, 95, 2}
+    };
+    path_encoder_set_weights(weights);
+    #endif
     printf("States: ");
     for (int i=0; 0 != strcmp(state_names[i], ""); i++){
         printf("%s,", state_names[i]);
@@ -345,6 +872,121 @@ int main(void){
     }
     printf("\n");
 
+    #if IMPLEMENTATION != 1
+    // the same path by state index, as a controller that knows its state numbers would log it.
+    uint8_t states[MAX_PATH_LEN];
+    int len;
+    path_encoding_t id_encoding;
+    for (len = 0; 0 != strcmp("", path[len]); len++){
+        states[len] = state_index(path[len]);
+    }
+    path_encoder_encode_ids(states, len, id_encoding);
+    printf("ID encoding matches: %d\n", 0 == memcmp(encoding, id_encoding, sizeof(path_encoding_t)));
+    path_encoder_decode_ids(id_encoding, states, &len);
+    printf("Decoded state indexes: ");
+    for (int i = 0; i < len; i++){
+        printf("%d ", states[i]);
+    }
+    printf("\n");
+    #endif
+
+    #if IMPLEMENTATION == 4
+    // batch decode of a log of random paths, and of random bytes, against path_encoder_decode_ids.
+    #define BATCH_PATHS 200000
+    static uint8_t log_buf[BATCH_PATHS * sizeof(path_encoding_t)];
+    static uint8_t batch_states[BATCH_PATHS * MAX_PATH_LEN];
+    static int batch_lens[BATCH_PATHS];
+    size_t log_len = 0;
+    srand(1);
+    for (int p = 0; p < BATCH_PATHS; p++){
+        int curr = start_state;
+        for (len = 0; len < MAX_PATH_LEN - 1 && curr != done_state; len++){
+            states[len] = curr;
+            curr = next_state_indexes[curr][rand() % _state_graph[curr].num_children];
+        }
+        states[len++] = curr;
+        if (curr != done_state || !path_encoder_encode_ids(states, len, id_encoding)){
+            for (int i = 0; i < 4; i++) log_buf[log_len++] = rand(); // some garbage too
+            log_buf[log_len - 4] = 3;
+            continue;
+        }
+        memcpy(&log_buf[log_len], id_encoding, id_encoding[0] + 1);
+        log_len += id_encoding[0] + 1;
+    }
+    path_encoder_batch_init();
+    clock_t batch_start = clock();
+    int num_paths = path_encoder_decode_batch(log_buf, log_len, batch_states, batch_lens, BATCH_PATHS);
+    double batch_seconds = (double) (clock() - batch_start) / CLOCKS_PER_SEC;
+
+    int mismatches = 0;
+    long num_states_decoded = 0;
+    clock_t single_start = clock();
+    for (size_t pos = 0, p = 0; pos < log_len; pos += log_buf[pos] + 1, p++){
+        memset(id_encoding, 0, sizeof(path_encoding_t));
+        memcpy(id_encoding, &log_buf[pos], log_buf[pos] + 1 > sizeof(path_encoding_t) ? sizeof(path_encoding_t) : log_buf[pos] + 1);
+        bool ok = path_encoder_decode_ids(id_encoding, states, &len);
+        if (!ok) len = -1;
+        if (len != batch_lens[p] || (ok && 0 != memcmp(states, &batch_states[p * MAX_PATH_LEN], len))) mismatches++;
+        num_states_decoded += ok ? len : 0;
+    }
+    double single_seconds = (double) (clock() - single_start) / CLOCKS_PER_SEC;
+    clock_t string_start = clock();
+    for (size_t pos = 0; pos < log_len; pos += log_buf[pos] + 1){
+        memset(id_encoding, 0, sizeof(path_encoding_t));
+        memcpy(id_encoding, &log_buf[pos], log_buf[pos] + 1 > sizeof(path_encoding_t) ? sizeof(path_encoding_t) : log_buf[pos] + 1);
+        path_encoder_decode(id_encoding, decoded_path);
+    }
+    double string_seconds = (double) (clock() - string_start) / CLOCKS_PER_SEC;
+    printf("Batch decoded %d encodings, %d differ from path_encoder_decode_ids\n", num_paths, mismatches);
+    printf("M states/s: batch %.1f, path_encoder_decode_ids %.1f, path_encoder_decode %.1f\n",
+        num_states_decoded / batch_seconds / 1e6, num_states_decoded / single_seconds / 1e6,
+        num_states_decoded / string_seconds / 1e6);
+
+    // the same log through the query layer.
+    static path_stats_t stats;
+    path_stats_init(&stats);
+    clock_t stats_start = clock();
+    path_stats_add(&stats, log_buf, log_len);
+    double stats_seconds = (double) (clock() - stats_start) / CLOCKS_PER_SEC;
+    path_stats_print(&stats);
+    printf("Stats: %.1f M paths/s\n", stats.paths / stats_seconds / 1e6);
+    #endif
+
+    #if IMPLEMENTATION == 5
+    // log fill rate: random paths drawn from the weights, against implementation 4's fixed width bits.
+    long total_bits = 0, fixed_bits = 0, total_bytes = 0, fixed_bytes = 0;
+    int num_paths = 0, mismatches = 0;
+    srand(1);
+    for (int p = 0; p < 100000; p++){
+        int curr = start_state, bits = 0;
+        for (len = 0; len < MAX_PATH_LEN - 1 && curr != done_state; len++){
+            states[len] = curr;
+            int r = rand() % (1 << PROB_BITS), k = 0;
+            while (r >= child_cum[curr][k+1]) k++;
+            int c = child_order[curr][k];
+            for (int n = 1; n < _state_graph[curr].num_children; n <<= 1) bits++;
+            curr = next_state_indexes[curr][c];
+        }
+        if (curr != done_state) continue;
+        states[len++] = curr;
+        uint8_t decoded[MAX_PATH_LEN];
+        int decoded_len;
+        path_encoder_encode_ids(states, len, id_encoding);
+        path_encoder_decode_ids(id_encoding, decoded, &decoded_len);
+        if (decoded_len != len || 0 != memcmp(states, decoded, len)) mismatches++;
+        num_paths++;
+        total_bits += 8 * id_encoding[0];
+        fixed_bits += 8 * ((bits + 7) / 8);
+        total_bytes += 1 + id_encoding[0];
+        fixed_bytes += 1 + (bits + 7) / 8;
+    }
+    printf("%d random paths, %d decoded wrong\n", num_paths, mismatches);
+    printf("Average bits stored per path after the length byte: %.2f, implementation 4 would take %.2f\n",
+        (double) total_bits / num_paths, (double) fixed_bits / num_paths);
+    printf("Average bytes per path: %.2f, implementation 4 would take %.2f\n",
+        (double) total_bytes / num_paths, (double) fixed_bytes / num_paths);
+    #endif
+
     // simulate data storage malfunction
     encoding[1] = (1 << 8) - 1;
     path_encoder_decode(encoding, decoded_path);
@@ -355,9 +997,291 @@ int main(void){
     }
     printf("\n");
 
+    #if IMPLEMENTATION >= 3
+    // a malformed table: B's next state is not a state. Its paths are refused, not half encoded.
+    state_graph[2].next_states[0] = "E";
+    path_encoder_init(state_graph);
+    printf("Malformed table refused: %d\n", !path_encoder_encode(path, encoding) && !path_encoder_decode(encoding, decoded_path));
+    #endif
+
     return 0;
 }
 
+#else
+#include "sys/time.h"
+#ifdef PATH_GEN
+#include "path_gen.h"
+#endif
+
+// Benchmark and round trip check over random valid paths, for the example graph and for random
+// graphs up to MAX_STATES states. 'make state_bench' builds and runs every implementation.
+// The controller logs a path every millisecond (1 kHz), so encoding has a budget of 1e6 ns.
+#define BENCH_PATHS 1000000
+#define BENCH_ROUNDS 3
+#define BENCH_NAMED_PATHS 4096        // paths also kept as names, for the name API
+#define BENCH_BUDGET_NS 1e6
+#define FLASH_BYTES (1 << 20)
+#if IMPLEMENTATION == 1
+#define BENCH_ID_PATHS 1              // no id API, and 1M encodings would take 850 MB
+#else
+#define BENCH_ID_PATHS BENCH_PATHS
+#endif
+
+uint8_t paths[(size_t) BENCH_PATHS * MAX_PATH_LEN];
+int lens[BENCH_PATHS];
+path_encoding_t encodings[BENCH_ID_PATHS];
+path_t named_paths[BENCH_NAMED_PATHS];
+path_encoding_t named_encodings[BENCH_NAMED_PATHS];
+// the graph by state index, built here since implementation 1 keeps no tables.
+// dist[s]: transitions on the shortest way from state s to DONE.
+int bench_num_states, bench_start, bench_done;
+int bench_num_children[MAX_STATES];
+uint8_t bench_next[MAX_STATES][MAX_CHILDREN];
+char *bench_names[MAX_STATES];
+int dist[MAX_STATES];
+
+double now(void){
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// a random graph of 'n' states, START first and DONE last. The first next state of every other
+// state is a later state, so every state can reach DONE; the rest are any state but START.
+void random_graph(state_graph_t graph, int n, char names[MAX_STATES][MAX_STATE_NAME_SIZE]){
+    memset(graph, 0, sizeof(state_graph_t));
+    for (int s = 0; s < n; s++){
+        if (s == 0) strcpy(names[s], "START");
+        else if (s == n - 1) strcpy(names[s], "DONE");
+        else snprintf(names[s], MAX_STATE_NAME_SIZE, "S%d", s);
+        graph[s].name = names[s];
+    }
+    for (int s = 0; s < n - 1; s++){
+        graph[s].num_children = 1 + rand() % MAX_CHILDREN;
+        graph[s].next_states[0] = names[s + 1 + rand() % (n - 1 - s)];
+        for (int c = 1; c < graph[s].num_children; c++){
+            graph[s].next_states[c] = names[1 + rand() % (n - 1)];
+        }
+    }
+}
+
+int bench_state_index(const char *name){
+    for (int s = 0; s < bench_num_states; s++){
+        if (0 == strcmp(bench_names[s], name)) return s;
+    }
+    return -1;
+}
+
+// fill the bench tables and dist for 'graph'. return false if START cannot reach DONE within
+// MAX_PATH_LEN states.
+bool bench_graph_init(state_graph_t graph){
+    for (bench_num_states = 0; bench_num_states < MAX_STATES && graph[bench_num_states].name != NULL; bench_num_states++){
+        bench_names[bench_num_states] = graph[bench_num_states].name;
+    }
+    for (int s = 0; s < bench_num_states; s++){
+        bench_num_children[s] = graph[s].num_children;
+        for (int c = 0; c < graph[s].num_children; c++){
+            bench_next[s][c] = bench_state_index(graph[s].next_states[c]);
+        }
+    }
+    bench_start = bench_state_index("START");
+    bench_done = bench_state_index("DONE");
+    for (int s = 0; s < bench_num_states; s++){
+        dist[s] = s == bench_done ? 0 : MAX_PATH_LEN;
+    }
+    for (bool changed = true; changed; ){
+        changed = false;
+        for (int s = 0; s < bench_num_states; s++){
+            for (int c = 0; c < bench_num_children[s]; c++){
+                int d = dist[bench_next[s][c]] + 1;
+                if (d < dist[s]){
+                    dist[s] = d;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return dist[bench_start] < MAX_PATH_LEN - 1;
+}
+
+// random valid paths of up to MAX_PATH_LEN states, MAX_PATH_LEN state indexes apart. Each walks
+// at random to a random target length, never where DONE would be out of reach, then takes the
+// shortest way to DONE. return the total number of states.
+long random_paths(int num_paths){
+    long total = 0;
+    for (int p = 0; p < num_paths; p++){
+        uint8_t *states = &paths[(size_t) p * MAX_PATH_LEN];
+        int target = 2 + rand() % (MAX_PATH_LEN - 1);
+        int curr = bench_start, len = 0;
+        while (curr != bench_done){
+            states[len++] = curr;
+            int num_children = bench_num_children[curr];
+            int next = bench_next[curr][rand() % num_children];
+            if (len >= target || len + dist[next] + 1 > MAX_PATH_LEN){
+                for (int c = 0; c < num_children; c++){
+                    if (dist[bench_next[curr][c]] < dist[next]) next = bench_next[curr][c];
+                }
+            }
+            curr = next;
+        }
+        states[len++] = curr;
+        lens[p] = len;
+        total += len;
+    }
+    return total;
+}
+
+void to_names(const uint8_t *states, int len, path_t path){
+    memset(path, 0, sizeof(path_t));
+    for (int i = 0; i < len; i++){
+        strcpy(path[i], bench_names[states[i]]);
+    }
+}
+
+// the best time over BENCH_ROUNDS rounds, in ns per path.
+typedef struct {
+    double encode_ids;
+    double decode_ids;
+    double encode;
+    double decode;
+} bench_times_t;
+
+// return false if any path failed to encode or decoded wrong.
+bool bench_graph(const char *label, state_graph_t state_graph){
+    path_encoder_init(state_graph);
+    if (!bench_graph_init(state_graph)){
+        printf("%s: DONE is too far from START\n", label);
+        return false;
+    }
+    long num_states_total = random_paths(BENCH_PATHS);
+    for (int p = 0; p < BENCH_NAMED_PATHS; p++){
+        to_names(&paths[(size_t) p * MAX_PATH_LEN], lens[p], named_paths[p]);
+    }
+
+    // round trips through the name API, which every implementation has, for every path.
+    long bytes = 0, failed = 0, bad = 0;
+    path_t path, decoded;
+    path_encoding_t encoding;
+    for (int p = 0; p < BENCH_PATHS; p++){
+        to_names(&paths[(size_t) p * MAX_PATH_LEN], lens[p], path);
+        if (!path_encoder_encode(path, encoding)){
+            failed++;
+            continue;
+        }
+        bytes += 1 + encoding[0];
+        if (!path_encoder_decode(encoding, decoded) || 0 != memcmp(path, decoded, sizeof(path_t))) bad++;
+    }
+
+    bench_times_t best = { 1e9, 1e9, 1e9, 1e9 };
+    #if IMPLEMENTATION != 1
+    uint8_t states[MAX_PATH_LEN];
+    int len;
+    #endif
+    for (int round = 0; round < BENCH_ROUNDS; round++){
+        double start = now();
+        #if IMPLEMENTATION != 1
+        for (int p = 0; p < BENCH_PATHS; p++){
+            path_encoder_encode_ids(&paths[(size_t) p * MAX_PATH_LEN], lens[p], encodings[p]);
+        }
+        double middle = now();
+        for (int p = 0; p < BENCH_PATHS; p++){
+            path_encoder_decode_ids(encodings[p], states, &len);
+        }
+        double end = now();
+        if (middle - start < best.encode_ids) best.encode_ids = middle - start;
+        if (end - middle < best.decode_ids) best.decode_ids = end - middle;
+        #endif
+        start = now();
+        for (int p = 0; p < BENCH_PATHS; p++){
+            path_encoder_encode(named_paths[p % BENCH_NAMED_PATHS], named_encodings[p % BENCH_NAMED_PATHS]);
+        }
+        double named_middle = now();
+        for (int p = 0; p < BENCH_PATHS; p++){
+            path_encoder_decode(named_encodings[p % BENCH_NAMED_PATHS], decoded);
+        }
+        double named_end = now();
+        if (named_middle - start < best.encode) best.encode = named_middle - start;
+        if (named_end - named_middle < best.decode) best.decode = named_end - named_middle;
+    }
+
+    double mean_bytes = failed == BENCH_PATHS ? 0 : (double) bytes / (BENCH_PATHS - failed);
+    printf("%s: %d states, %d paths, %.1f states and %.2f bytes per path, %ld failed, %ld bad round trips\n",
+        label, bench_num_states, BENCH_PATHS, (double) num_states_total / BENCH_PATHS, mean_bytes, failed, bad);
+    if (IMPLEMENTATION != 1){
+        printf("    ids:   encode %7.1f ns/path, decode %7.1f ns/path\n",
+            best.encode_ids * 1e9 / BENCH_PATHS, best.decode_ids * 1e9 / BENCH_PATHS);
+    }
+    double encode_ns = best.encode * 1e9 / BENCH_PATHS;
+    printf("    names: encode %7.1f ns/path, decode %7.1f ns/path\n", encode_ns, best.decode * 1e9 / BENCH_PATHS);
+    printf("    at 1 kHz: encoding takes %.4f%% of the budget, 1 MB of flash holds %.1f minutes\n",
+        100 * encode_ns / BENCH_BUDGET_NS, FLASH_BYTES / mean_bytes / 1000 / 60);
+
+    #ifdef PATH_GEN
+    // the generated code must produce the same bytes and paths.
+    static uint8_t gen_encodings[BENCH_PATHS][PATH_GEN_ENCODING_LEN];
+    int mismatches = 0;
+    for (int p = 0; p < BENCH_PATHS; p++){
+        uint8_t *path = &paths[(size_t) p * MAX_PATH_LEN];
+        if (!path_gen_encode_ids(path, lens[p], gen_encodings[p]) ||
+            0 != memcmp(gen_encodings[p], encodings[p], encodings[p][0] + 1) ||
+            !path_gen_decode_ids(gen_encodings[p], states, &len) || len != lens[p] || 0 != memcmp(states, path, len)){
+            mismatches++;
+        }
+    }
+    double best_encode = 1e9, best_decode = 1e9;
+    for (int round = 0; round < BENCH_ROUNDS; round++){
+        double start = now();
+        for (int p = 0; p < BENCH_PATHS; p++){
+            path_gen_encode_ids(&paths[(size_t) p * MAX_PATH_LEN], lens[p], gen_encodings[p]);
+        }
+        double middle = now();
+        for (int p = 0; p < BENCH_PATHS; p++){
+            path_gen_decode_ids(gen_encodings[p], states, &len);
+        }
+        double end = now();
+        if (middle - start < best_encode) best_encode = middle - start;
+        if (end - middle < best_decode) best_decode = end - middle;
+    }
+    printf("    state_gen from states.def: encode %7.1f ns/path, decode %7.1f ns/path, differs on %d paths\n",
+        best_encode * 1e9 / BENCH_PATHS, best_decode * 1e9 / BENCH_PATHS, mismatches);
+    if (mismatches > 0) return false;
+    #endif
+    return failed == 0 && bad == 0;
+}
+
+int main(void){
+    char label[64];
+    bool ok = true;
+    srand(1);
+    #ifdef PATH_GEN
+    state_graph_t state_graph = PATH_GEN_STATE_GRAPH;
+    snprintf(label, sizeof(label), "implementation %d, states.def", IMPLEMENTATION);
+    ok = bench_graph(label, state_graph);
+    #else
+    state_graph_t state_graph = {
+        {.name = "START", .num_children = 3, .next_states = {"A", "B", "C"}},
+        {.name = "A", .num_children = 3, .next_states = {"B", "C", "FAILED"}},
+        {.name = "B", .num_children = 1, .next_states = {"D"}},
+        {.name = "C", .num_children = 4, .next_states = {"DONE", "FAILED", "A", "D"}},
+        {.name = "D", .num_children = 4, .next_states = {"A", "B", "C", "FAILED"}},
+        {.name = "FAILED", .num_children = 1, .next_states = {"DONE"}},
+        {.name = "DONE", .num_children = 0}
+    };
+    snprintf(label, sizeof(label), "implementation %d, example", IMPLEMENTATION);
+    ok = bench_graph(label, state_graph);
+
+    static char names[MAX_STATES][MAX_STATE_NAME_SIZE];
+    int sizes[] = { 16, MAX_STATES };
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+        random_graph(state_graph, sizes[i], names);
+        snprintf(label, sizeof(label), "implementation %d, random graph", IMPLEMENTATION);
+        ok = bench_graph(label, state_graph) && ok;
+    }
+    #endif
+    return ok ? 0 : 1;
+}
+#endif
+
 /*
 Path: START:3 -> B:1 -> D:4 -> A:3 -> C:4 -> D:4 -> C:4 -> A:3 -> B:1 -> D:4 -> FAILED:1 -> DONE:0
 indexes:      1       0      0     1      3       2      2      0      0      3          0
@@ -0,0 +1,371 @@
+#include "state_enum.h"
+
+#include "string.h"
+
+static int enum_state_index(state_enum_t *engine, const char *name, bool add){
+    for (int s = 0; s < engine->num_states; s++){
+        if (0 == strcmp(engine->names[s], name)) return s;
+    }
+    if (!add || engine->num_states == MAX_ENUM_STATES) return -1;
+    engine->names[engine->num_states] = name;
+    return engine->num_states++;
+}
+
+/* shortest_path
+ * breadth first search from 'from' to 'to' through states not in 'blocked'.
+ * fill 'path' (room for MAX_ENUM_STATES) and return its length, or 0 if there is none.
+*/
+static int shortest_path(const state_enum_t *engine, int from, int to, const bool *blocked, uint8_t *path){
+    int parent[MAX_ENUM_STATES];
+    uint8_t queue[MAX_ENUM_STATES];
+    int head = 0, tail = 0;
+    if (blocked[from] || blocked[to]) return 0;
+    for (int s = 0; s < engine->num_states; s++){
+        parent[s] = -1;
+    }
+    parent[from] = from;
+    queue[tail++] = from;
+    while (head < tail && parent[to] == -1){
+        int s = queue[head++];
+        for (int k = engine->out_start[s]; k < engine->out_start[s+1]; k++){
+            int next = engine->to[engine->out_edges[k]];
+            if (parent[next] != -1 || blocked[next]) continue;
+            parent[next] = s;
+            queue[tail++] = next;
+        }
+    }
+    if (parent[to] == -1) return 0;
+    int len = 0;
+    for (int s = to; s != from; s = parent[s]){
+        len++;
+    }
+    len++;
+    for (int i = len - 1, s = to; i >= 0; i--, s = parent[s]){
+        path[i] = s;
+    }
+    return len;
+}
+
+/* path_through
+ * a simple START -> DONE path using transition 'e': the shortest way to its source avoiding its
+ * target, then the shortest way on to DONE avoiding that prefix. If that fails, the same the other
+ * way round. return the path length, or 0 if neither works.
+*/
+static int path_through(const state_enum_t *engine, int e, uint8_t *path){
+    int u = engine->from[e], v = engine->to[e];
+    bool blocked[MAX_ENUM_STATES] = { false };
+    uint8_t part[MAX_ENUM_STATES];
+    if (u == v || u == engine->done || v == engine->start) return 0; // would revisit a state
+
+    blocked[v] = true;
+    int prefix = shortest_path(engine, engine->start, u, blocked, path);
+    if (prefix > 0){
+        memset(blocked, 0, sizeof(blocked));
+        for (int i = 0; i < prefix; i++){
+            blocked[path[i]] = true;
+        }
+        int suffix = shortest_path(engine, v, engine->done, blocked, part);
+        if (suffix > 0){
+            memcpy(&path[prefix], part, suffix);
+            return prefix + suffix;
+        }
+    }
+
+    memset(blocked, 0, sizeof(blocked));
+    blocked[u] = true;
+    blocked[engine->start] = true;
+    int suffix = shortest_path(engine, v, engine->done, blocked, part);
+    if (suffix == 0) return 0;
+    memset(blocked, 0, sizeof(blocked));
+    for (int i = 0; i < suffix; i++){
+        blocked[part[i]] = true;
+    }
+    prefix = shortest_path(engine, engine->start, u, blocked, path);
+    if (prefix == 0) return 0;
+    memcpy(&path[prefix], part, suffix);
+    return prefix + suffix;
+}
+
+// number of transitions from 's' to 't' that no path covers yet.
+static int uncovered_between(const state_enum_t *engine, const int *counts, int s, int t){
+    int n = 0;
+    for (int k = engine->out_start[s]; k < engine->out_start[s+1]; k++){
+        int e = engine->out_edges[k];
+        n += engine->to[e] == t && counts[e] == 0;
+    }
+    return n;
+}
+
+static int uncovered_on(const state_enum_t *engine, const int *counts, const uint8_t *path, int len){
+    int n = 0;
+    for (int i = 0; i + 1 < len; i++){
+        n += uncovered_between(engine, counts, path[i], path[i+1]);
+    }
+    return n;
+}
+
+/* detour
+ * a way through the uncovered transition 'e' that leaves 'path' at some path[i] and rejoins it at
+ * a later path[j], through states off the path: breadth first from the path to the source of 'e',
+ * then from its target back to the path. 'pos[s]' is the position of state s on the path, or -1.
+ * fill 'out' (room for MAX_ENUM_STATES) with path[i], the states between, path[j], set '*i' and
+ * '*j', and return its length, or 0 if there is none.
+*/
+static int detour(const state_enum_t *engine, const uint8_t *path, int len, const int *pos, int e,
+    uint8_t *out, int *i, int *j){
+    int a = engine->from[e], b = engine->to[e];
+    int parent[MAX_ENUM_STATES];
+    uint8_t queue[MAX_ENUM_STATES];
+    bool used[MAX_ENUM_STATES] = { false };
+    int head = 0, tail = 0, n = 0;
+    if (a == b || (pos[a] != -1 && pos[b] != -1 && pos[b] <= pos[a] + 1)) return 0;
+
+    // from the path to 'a': from a path state before where 'b' is on it, or before DONE.
+    if (pos[a] != -1){
+        *i = pos[a];
+        out[n++] = a;
+    } else {
+        int limit = pos[b] != -1 ? pos[b] : len - 1;
+        for (int s = 0; s < engine->num_states; s++){
+            parent[s] = -1;
+        }
+        for (int k = 0; k < limit; k++){
+            parent[path[k]] = path[k];
+            queue[tail++] = path[k];
+        }
+        while (head < tail && parent[a] == -1){
+            int s = queue[head++];
+            for (int k = engine->out_start[s]; k < engine->out_start[s+1]; k++){
+                int next = engine->to[engine->out_edges[k]];
+                if (parent[next] != -1 || pos[next] != -1 || next == b) continue;
+                parent[next] = s;
+                queue[tail++] = next;
+            }
+        }
+        if (parent[a] == -1) return 0;
+        int s = a;
+        for ( ; pos[s] == -1; s = parent[s]){
+            n++;
+        }
+        *i = pos[s];
+        n++;
+        for (int k = n - 1, t = a; k >= 0; k--, t = parent[t]){
+            out[k] = t;
+            used[t] = true;
+        }
+    }
+
+    // from 'b' back to the path after path[i].
+    if (pos[b] != -1){
+        if (pos[b] <= *i) return 0;
+        *j = pos[b];
+        out[n++] = b;
+        return n;
+    }
+    for (int s = 0; s < engine->num_states; s++){
+        parent[s] = -1;
+    }
+    head = tail = 0;
+    parent[b] = b;
+    queue[tail++] = b;
+    int end = -1;
+    while (head < tail && end == -1){
+        int s = queue[head++];
+        for (int k = engine->out_start[s]; k < engine->out_start[s+1] && end == -1; k++){
+            int next = engine->to[engine->out_edges[k]];
+            if (pos[next] > *i){
+                parent[next] = s;
+                end = next;
+            } else if (pos[next] == -1 && parent[next] == -1 && !used[next]){
+                parent[next] = s;
+                queue[tail++] = next;
+            }
+        }
+    }
+    if (end == -1) return 0;
+    int m = 0;
+    for (int t = end; t != b; t = parent[t]){
+        m++;
+    }
+    m++;
+    for (int k = n + m - 1, t = end; k >= n; k--, t = parent[t]){
+        out[k] = t;
+    }
+    *j = pos[end];
+    return n + m;
+}
+
+/* reroute
+ * take 'path' through more transitions that no path covers yet: while some detour (see above)
+ * covers more of them than the stretch of the path it replaces, replace that stretch, so long as
+ * the stretch does not hold transition 'keep'. return the new length.
+*/
+static int reroute(const state_enum_t *engine, const int *counts, int keep, uint8_t *path, int len){
+    int pos[MAX_ENUM_STATES];
+    uint8_t way[MAX_ENUM_STATES];
+    for (bool rerouted = true; rerouted; ){
+        rerouted = false;
+        for (int s = 0; s < engine->num_states; s++){
+            pos[s] = -1;
+        }
+        for (int k = 0; k < len; k++){
+            pos[path[k]] = k;
+        }
+        for (int e = 0; e < engine->num_transitions && !rerouted; e++){
+            int i, j;
+            if (counts[e] > 0) continue;
+            int n = detour(engine, path, len, pos, e, way, &i, &j);
+            if (n == 0 || (i <= pos[engine->from[keep]] && pos[engine->from[keep]] < j)) continue;
+            if (uncovered_on(engine, counts, way, n) <= uncovered_on(engine, counts, &path[i], j - i + 1)) continue;
+            memmove(&path[i + n], &path[j + 1], len - j - 1);
+            memcpy(&path[i], way, n);
+            len += n - (j - i + 1);
+            rerouted = true;
+        }
+    }
+    return len;
+}
+
+// call mark(e, counts) for every transition on 'path'.
+static void for_each_transition(const state_enum_t *engine, const uint8_t *path, int len,
+    void (*mark)(int e, int *counts), int *counts){
+    for (int i = 0; i + 1 < len; i++){
+        for (int k = engine->out_start[path[i]]; k < engine->out_start[path[i]+1]; k++){
+            if (engine->to[engine->out_edges[k]] == path[i+1]) mark(engine->out_edges[k], counts);
+        }
+    }
+}
+
+static void count_up(int e, int *counts){
+    counts[e]++;
+}
+
+static void count_down(int e, int *counts){
+    counts[e]--;
+}
+
+bool state_enum_init(state_enum_t *engine, state_table_t table){
+    memset(engine, 0, sizeof(state_enum_t));
+    int out_count[MAX_ENUM_STATES] = { 0 };
+    for (int e = 0; e < MAX_TRANSITIONS && table[e][0] != NULL; e++){
+        int from = enum_state_index(engine, table[e][0], true);
+        int to = enum_state_index(engine, table[e][1], true);
+        if (from == -1 || to == -1) return false;
+        engine->from[e] = from;
+        engine->to[e] = to;
+        out_count[from]++;
+        engine->num_transitions++;
+    }
+    engine->start = enum_state_index(engine, "START", false);
+    engine->done = enum_state_index(engine, "DONE", false);
+    if (engine->start == -1 || engine->done == -1) return false;
+
+    // group transitions by source state, keeping table order within a state.
+    int fill[MAX_ENUM_STATES];
+    for (int s = 0; s < engine->num_states; s++){
+        engine->out_start[s+1] = engine->out_start[s] + out_count[s];
+        fill[s] = engine->out_start[s];
+    }
+    for (int e = 0; e < engine->num_transitions; e++){
+        engine->out_edges[fill[engine->from[e]]++] = e;
+    }
+
+    // greedy cover: for each transition the paths so far miss, a path through it, rerouted through
+    // as many other missed ones as it can take. Keep the one that covers the most; repeat.
+    int counts[MAX_TRANSITIONS] = { 0 };
+    uint8_t path[MAX_ENUM_STATES], best[MAX_ENUM_STATES];
+    bool coverable[MAX_TRANSITIONS];
+    for (int e = 0; e < engine->num_transitions; e++){
+        coverable[e] = path_through(engine, e, path) > 0;
+        if (!coverable[e]) engine->uncoverable[engine->num_uncoverable++] = e;
+    }
+    for (;;){
+        int best_len = 0, best_gain = 0;
+        for (int e = 0; e < engine->num_transitions; e++){
+            if (counts[e] > 0 || !coverable[e]) continue;
+            int len = reroute(engine, counts, e, path, path_through(engine, e, path));
+            int gain = uncovered_on(engine, counts, path, len);
+            if (gain <= best_gain) continue;
+            best_gain = gain;
+            best_len = len;
+            memcpy(best, path, len);
+        }
+        if (best_len == 0) break;
+        int at = engine->path_start[engine->num_paths];
+        memcpy(&engine->paths[at], best, best_len);
+        engine->path_start[++engine->num_paths] = at + best_len;
+        for_each_transition(engine, best, best_len, count_up, counts);
+    }
+
+    // later paths often cover what earlier ones were planned for: drop paths nothing needs.
+    for (int i = engine->num_paths - 1; i >= 0; i--){
+        const uint8_t *states = &engine->paths[engine->path_start[i]];
+        int len = engine->path_start[i+1] - engine->path_start[i];
+        bool needed = false;
+        for (int j = 0; j + 1 < len && !needed; j++){
+            for (int k = engine->out_start[states[j]]; k < engine->out_start[states[j]+1]; k++){
+                int e = engine->out_edges[k];
+                if (engine->to[e] == states[j+1] && counts[e] == 1) needed = true;
+            }
+        }
+        if (needed) continue;
+        for_each_transition(engine, states, len, count_down, counts);
+        memmove(&engine->paths[engine->path_start[i]], &engine->paths[engine->path_start[i+1]],
+            engine->path_start[engine->num_paths] - engine->path_start[i+1]);
+        for (int j = i; j < engine->num_paths; j++){
+            engine->path_start[j] = engine->path_start[j+1] - len;
+        }
+        engine->num_paths--;
+    }
+    return true;
+}
+
+int state_enum_count(const state_enum_t *engine){
+    return engine->num_paths;
+}
+
+int state_enum_path(const state_enum_t *engine, int i, uint8_t *states){
+    if (i < 0 || i >= engine->num_paths) return 0;
+    int len = engine->path_start[i+1] - engine->path_start[i];
+    memcpy(states, &engine->paths[engine->path_start[i]], len);
+    return len;
+}
+
+int state_enum_table(const state_enum_t *engine, int i, state_table_t pruned_table){
+    uint8_t path[MAX_ENUM_STATES];
+    int len = state_enum_path(engine, i, path);
+    int choice[MAX_ENUM_STATES];
+    for (int s = 0; s < engine->num_states; s++){
+        int n = engine->out_start[s+1] - engine->out_start[s];
+        choice[s] = n > 0 ? engine->out_edges[engine->out_start[s] + i % n] : -1;
+    }
+    for (int j = 0; j + 1 < len; j++){
+        for (int k = engine->out_start[path[j]]; k < engine->out_start[path[j]+1]; k++){
+            if (engine->to[engine->out_edges[k]] == path[j+1]) choice[path[j]] = engine->out_edges[k];
+        }
+    }
+    int num = 0;
+    for (int s = 0; s < engine->num_states; s++){
+        if (choice[s] == -1) continue;
+        pruned_table[num][0] = (char *) engine->names[s];
+        pruned_table[num++][1] = (char *) engine->names[engine->to[choice[s]]];
+    }
+    if (num < MAX_TRANSITIONS) pruned_table[num][0] = pruned_table[num][1] = NULL;
+    return num;
+}
+
+int state_enum_lower_bound(const state_enum_t *engine){
+    int in[MAX_ENUM_STATES] = { 0 }, out[MAX_ENUM_STATES] = { 0 };
+    int bound = 0;
+    for (int e = 0, u = 0; e < engine->num_transitions; e++){
+        while (u < engine->num_uncoverable && engine->uncoverable[u] < e) u++;
+        if (u < engine->num_uncoverable && engine->uncoverable[u] == e) continue;
+        in[engine->to[e]]++;
+        out[engine->from[e]]++;
+    }
+    for (int s = 0; s < engine->num_states; s++){
+        if (in[s] > bound) bound = in[s];
+        if (out[s] > bound) bound = out[s];
+    }
+    return bound;
+}
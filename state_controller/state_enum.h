@@ -0,0 +1,70 @@
+#ifndef STATE_ENUM_H_
+#define STATE_ENUM_H_
+
+#include "stdbool.h"
+#include "stdint.h"
+
+// Transition coverage for testing a state machine, the job of enum_state_tables in scrap.c.
+//
+// A pruned table keeps one transition per state, so a controller run on it walks one fixed path
+// from START. To exercise a transition, that walk has to reach it and still end at DONE without
+// coming back to a state (it would loop forever). So coverage is planned as a set of simple
+// START -> DONE paths that together use every transition, and each pruned table is one of
+// those paths, plus, for the states off the path, their (index mod number of choices)'th
+// transition.
+//
+// state_enum_init plans the cover greedily. For each transition not yet covered it takes the
+// shortest simple path through it, then reroutes the path through detours off it wherever a
+// detour picks up more uncovered transitions than the stretch it replaces. The candidate that
+// covers the most is kept, and the rest are planned again against it. Last, paths whose
+// transitions are all covered by others are dropped. The paths are stored in the engine, and
+// state_enum_path only copies one out, so callers can hand index ranges [0, state_enum_count)
+// to as many threads as they like.
+
+#define MAX_TRANSITIONS 200
+#define MAX_ENUM_STATES 255
+// every path is planned for a transition, and no path visits a state twice.
+#define MAX_COVER_STATES (MAX_TRANSITIONS * MAX_ENUM_STATES)
+
+// transitions as {from, to} name pairs, NULL terminated, as in scrap.c.
+// DONE loops back to START on its own, so that transition is never listed.
+typedef char * state_table_t [MAX_TRANSITIONS][2];
+
+typedef struct {
+    int num_states;
+    int num_transitions;
+    const char *names[MAX_ENUM_STATES];
+    uint8_t from[MAX_TRANSITIONS];
+    uint8_t to[MAX_TRANSITIONS];
+    // transitions leaving state s: out_edges[out_start[s], out_start[s+1])
+    uint8_t out_edges[MAX_TRANSITIONS];
+    uint8_t out_start[MAX_ENUM_STATES + 1];
+    int start;
+    int done;
+    int num_paths;
+    // path i is paths[path_start[i], path_start[i+1])
+    uint16_t path_start[MAX_TRANSITIONS + 1];
+    uint8_t paths[MAX_COVER_STATES];
+    int num_uncoverable;                // transitions on no simple START -> DONE path
+    uint8_t uncoverable[MAX_TRANSITIONS];
+} state_enum_t;
+
+// plan the cover for 'table'. return false if START or DONE is missing or the table is too big.
+bool state_enum_init(state_enum_t *engine, state_table_t table);
+
+// number of paths (and pruned tables).
+int state_enum_count(const state_enum_t *engine);
+
+// fill 'states' (room for MAX_ENUM_STATES) with the state indexes of path 'i', from START to DONE.
+// engine->names[s] is the name of state s. return the path length.
+int state_enum_path(const state_enum_t *engine, int i, uint8_t *states);
+
+// fill 'pruned_table' with pruned table 'i': one transition for every state that has any,
+// NULL terminated. return the number of transitions.
+int state_enum_table(const state_enum_t *engine, int i, state_table_t pruned_table);
+
+// a lower bound on the number of paths any cover needs: a simple path enters and leaves each
+// state at most once, so a state with k coverable transitions in or out needs k paths.
+int state_enum_lower_bound(const state_enum_t *engine);
+
+#endif  // STATE_ENUM_H_
@@ -0,0 +1,160 @@
+/*
+Plans transition coverage with state_enum for the example tables of scrap.c and for a large
+random state machine, then checks the cover with several threads, each taking a range of path
+indexes.
+
+compile:
+make state_enum_demo
+
+run:
+./state_enum_demo [threads]
+*/
+
+#include "pthread.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "state_enum.h"
+
+#define RANDOM_STATES 200
+#define RANDOM_TRANSITIONS 199
+
+typedef struct {
+    const state_enum_t *engine;
+    int first;
+    int last;
+    int bad_paths;
+    bool *covered;        // shared: written with __atomic_store_n
+} worker_t;
+
+// check paths [first, last): each a simple START -> DONE walk along the table's transitions.
+void *check_paths(void *arg){
+    worker_t *worker = arg;
+    const state_enum_t *engine = worker->engine;
+    uint8_t path[MAX_ENUM_STATES];
+    for (int i = worker->first; i < worker->last; i++){
+        int len = state_enum_path(engine, i, path);
+        bool seen[MAX_ENUM_STATES] = { false };
+        bool ok = len >= 2 && path[0] == engine->start && path[len-1] == engine->done;
+        for (int j = 0; j < len && ok; j++){
+            ok = !seen[path[j]];
+            seen[path[j]] = true;
+        }
+        for (int j = 0; j + 1 < len && ok; j++){
+            bool found = false;
+            for (int e = 0; e < engine->num_transitions; e++){
+                if (engine->from[e] == path[j] && engine->to[e] == path[j+1]){
+                    __atomic_store_n(&worker->covered[e], true, __ATOMIC_RELAXED);
+                    found = true;
+                }
+            }
+            ok = found;
+        }
+        if (!ok) worker->bad_paths++;
+    }
+    return NULL;
+}
+
+void check_cover(const char *label, const state_enum_t *engine, int num_threads){
+    bool covered[MAX_TRANSITIONS] = { false };
+    pthread_t threads[64];
+    worker_t workers[64];
+    int count = state_enum_count(engine), bad_paths = 0, missed = 0;
+    for (int t = 0; t < num_threads; t++){
+        workers[t] = (worker_t) { engine, count * t / num_threads, count * (t + 1) / num_threads, 0, covered };
+        pthread_create(&threads[t], NULL, check_paths, &workers[t]);
+    }
+    for (int t = 0; t < num_threads; t++){
+        pthread_join(threads[t], NULL);
+        bad_paths += workers[t].bad_paths;
+    }
+    for (int e = 0; e < engine->num_transitions; e++){
+        missed += !covered[e];
+    }
+    printf("%s: %d states, %d transitions, %d paths (lower bound %d), %d bad paths, %d transitions missed, %d on no simple path\n",
+        label, engine->num_states, engine->num_transitions, count, state_enum_lower_bound(engine), bad_paths,
+        missed - engine->num_uncoverable, engine->num_uncoverable);
+}
+
+void print_enumeration(const state_enum_t *engine){
+    state_table_t pruned_table;
+    uint8_t path[MAX_ENUM_STATES];
+    for (int i = 0; i < state_enum_count(engine); i++){
+        int len = state_enum_path(engine, i, path);
+        printf("%d path: ", i);
+        for (int j = 0; j < len; j++){
+            printf("%s%s", j > 0 ? " -> " : "", engine->names[path[j]]);
+        }
+        printf("\n  table:");
+        state_enum_table(engine, i, pruned_table);
+        for (int j = 0; pruned_table[j][0] != NULL; j++){
+            printf(" %s>%s", pruned_table[j][0], pruned_table[j][1]);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv){
+    int num_threads = argc > 1 ? atoi(argv[1]) : 4;
+    if (num_threads < 1 || num_threads > 64) num_threads = 4;
+    static state_enum_t engine;
+
+    state_table_t state_table = {
+        {"START", "A"},
+        {"START", "B"},
+        {"START", "C"},
+        {"A", "B"},
+        {"A", "C"},
+        {"A", "FAILED"},
+        {"B", "D"},
+        {"D", "DONE"},
+        {"D", "A"},
+        {"FAILED", "DONE"}
+    };
+    state_enum_init(&engine, state_table);
+    print_enumeration(&engine);
+    check_cover("scrap.c example", &engine, num_threads);
+
+    state_table_t robot_table = {
+        {"START", "forward"},
+        {"forward", "jump"},
+        {"jump", "turn"},
+        {"jump", "duck"},
+        {"jump", "forward"},
+        {"jump", "DONE"},
+        {"duck", "backward"},
+        {"backward", "DONE"}
+    };
+    state_enum_init(&engine, robot_table);
+    print_enumeration(&engine);
+    check_cover("robot example", &engine, num_threads);
+
+    // a random state machine: a chain START -> S1 -> ... -> DONE so everything is reachable,
+    // plus random transitions, forward and back.
+    static char names[RANDOM_STATES][16];
+    state_table_t random_table;
+    memset(random_table, 0, sizeof(random_table));
+    srand(1);
+    for (int s = 0; s < RANDOM_STATES; s++){
+        if (s == 0) strcpy(names[s], "START");
+        else if (s == RANDOM_STATES - 1) strcpy(names[s], "DONE");
+        else sprintf(names[s], "S%d", s);
+    }
+    int e = 0;
+    for (int s = 0; s + 1 < RANDOM_STATES / 2; s++){
+        random_table[e][0] = names[s];
+        random_table[e++][1] = names[s + 1];
+    }
+    random_table[e][0] = names[RANDOM_STATES / 2 - 1];
+    random_table[e++][1] = names[RANDOM_STATES - 1];
+    while (e < RANDOM_TRANSITIONS){
+        int from = rand() % (RANDOM_STATES / 2), to = 1 + rand() % (RANDOM_STATES / 2 - 1);
+        if (from == to) continue;
+        random_table[e][0] = names[from];
+        random_table[e++][1] = names[to];
+    }
+    state_enum_init(&engine, random_table);
+    check_cover("random", &engine, num_threads);
+    return 0;
+}
@@ -0,0 +1,312 @@
+/*
+Generates a path encoder and decoder specialized to one state table.
+
+path_encoder_init in state_encoder_soln.c builds lookup tables at run time, and every encode and
+decode goes through them. When the state table is known at build time, this tool writes C code
+with it baked in: a switch on the current state, then a switch on the next state (encode) or on
+the bits read (decode), with every bit width a constant. The encoding is the same as
+IMPLEMENTATION 4's: encoding[0] is the byte count, then the child index of every transition in
+BITS_TO_INDEX(num_children) bits, low order bit first.
+
+The state table definition has one state per line, its name, a colon and its next states:
+    START: A B C
+    DONE:
+Blank lines and text after '#' are ignored. Generated state indexes follow the order of the file,
+as path_encoder_init's follow the state graph's.
+
+compile:
+make state_gen
+
+run:
+./state_gen states.def path_gen
+writes path_gen.h and path_gen.c, declaring path_gen_encode_ids and path_gen_decode_ids
+*/
+
+#include "ctype.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define MAX_GEN_STATES 255
+#define MAX_GEN_CHILDREN 256
+#define MAX_GEN_NAME_SIZE 16 // same as MAX_STATE_NAME_SIZE
+#define DEFAULT_MAX_PATH_LEN 50
+
+typedef struct {
+    char name[MAX_GEN_NAME_SIZE];
+    int num_children;
+    char next_states[MAX_GEN_CHILDREN][MAX_GEN_NAME_SIZE];
+    int next_indexes[MAX_GEN_CHILDREN];
+} gen_state_t;
+
+gen_state_t gen_states[MAX_GEN_STATES];
+int num_gen_states;
+
+// bits required to index n elements, as BITS_TO_INDEX.
+int bits_to_index(int n){
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+    return bits;
+}
+
+// widest child index of any state.
+int max_child_bits(void){
+    int max_bits = 0;
+    for (int i = 0; i < num_gen_states; i++){
+        int bits = bits_to_index(gen_states[i].num_children);
+        if (bits > max_bits) max_bits = bits;
+    }
+    return max_bits;
+}
+
+int gen_state_index(const char *name){
+    for (int i = 0; i < num_gen_states; i++){
+        if (0 == strcmp(gen_states[i].name, name)) return i;
+    }
+    return -1;
+}
+
+// copy the next whitespace separated word of 'line' into 'word'. return false at the end of the line.
+bool next_word(char **line, char *word, int line_num){
+    while (isspace((unsigned char) **line)) (*line)++;
+    if (**line == '\0') return false;
+    int len = 0;
+    while (**line != '\0' && !isspace((unsigned char) **line)){
+        if (len == MAX_GEN_NAME_SIZE - 1){
+            fprintf(stderr, "line %d: state name longer than %d characters\n", line_num, MAX_GEN_NAME_SIZE - 1);
+            exit(1);
+        }
+        word[len++] = *(*line)++;
+    }
+    word[len] = '\0';
+    return true;
+}
+
+void read_definition(FILE *in){
+    char line[4096];
+    for (int line_num = 1; fgets(line, sizeof(line), in) != NULL; line_num++){
+        char *comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+        char *colon = strchr(line, ':');
+        char *rest = line;
+        char word[MAX_GEN_NAME_SIZE];
+        if (colon == NULL){
+            if (next_word(&rest, word, line_num)){
+                fprintf(stderr, "line %d: expected 'NAME: NEXT STATES'\n", line_num);
+                exit(1);
+            }
+            continue; // blank
+        }
+        *colon = '\0';
+        char extra[MAX_GEN_NAME_SIZE];
+        if (!next_word(&rest, word, line_num) || next_word(&rest, extra, line_num)){
+            fprintf(stderr, "line %d: expected one state name before ':'\n", line_num);
+            exit(1);
+        }
+        if (gen_state_index(word) != -1){
+            fprintf(stderr, "line %d: state %s defined twice\n", line_num, word);
+            exit(1);
+        }
+        if (num_gen_states == MAX_GEN_STATES){
+            fprintf(stderr, "line %d: more than %d states\n", line_num, MAX_GEN_STATES);
+            exit(1);
+        }
+        gen_state_t *state = &gen_states[num_gen_states++];
+        strcpy(state->name, word);
+        rest = colon + 1;
+        while (next_word(&rest, word, line_num)){
+            for (int c = 0; c < state->num_children; c++){
+                if (0 == strcmp(state->next_states[c], word)){
+                    fprintf(stderr, "line %d: %s listed twice as a next state of %s\n", line_num, word, state->name);
+                    exit(1);
+                }
+            }
+            if (state->num_children == MAX_GEN_CHILDREN){
+                fprintf(stderr, "line %d: more than %d next states\n", line_num, MAX_GEN_CHILDREN);
+                exit(1);
+            }
+            strcpy(state->next_states[state->num_children++], word);
+        }
+    }
+    for (int i = 0; i < num_gen_states; i++){
+        for (int c = 0; c < gen_states[i].num_children; c++){
+            gen_states[i].next_indexes[c] = gen_state_index(gen_states[i].next_states[c]);
+            if (gen_states[i].next_indexes[c] == -1){
+                fprintf(stderr, "next state %s of %s is not defined\n", gen_states[i].next_states[c], gen_states[i].name);
+                exit(1);
+            }
+        }
+    }
+    if (gen_state_index("START") == -1 || gen_state_index("DONE") == -1){
+        fprintf(stderr, "START and DONE must be defined\n");
+        exit(1);
+    }
+}
+
+void write_header(FILE *out, const char *definition, int max_path_len){
+    int max_bits = max_child_bits();
+    fprintf(out, "// generated by state_gen from %s; do not edit.\n", definition);
+    fprintf(out, "#ifndef PATH_GEN_H_\n#define PATH_GEN_H_\n\n");
+    fprintf(out, "#include \"stdbool.h\"\n#include \"stdint.h\"\n\n");
+    fprintf(out, "#define PATH_GEN_NUM_STATES %d\n", num_gen_states);
+    fprintf(out, "#define PATH_GEN_START %d\n", gen_state_index("START"));
+    fprintf(out, "#define PATH_GEN_DONE %d\n", gen_state_index("DONE"));
+    fprintf(out, "#define PATH_GEN_MAX_PATH_LEN %d\n", max_path_len);
+    fprintf(out, "#define PATH_GEN_ENCODING_LEN %d\n\n", 1 + ((max_path_len - 1) * max_bits + 7) / 8);
+    fprintf(out, "// the table as a state_graph_t initializer, for path_encoder_init.\n");
+    fprintf(out, "#define PATH_GEN_STATE_GRAPH { \\\n");
+    for (int i = 0; i < num_gen_states; i++){
+        fprintf(out, "    {.name = \"%s\", .num_children = %d", gen_states[i].name, gen_states[i].num_children);
+        for (int c = 0; c < gen_states[i].num_children; c++){
+            fprintf(out, "%s\"%s\"", c > 0 ? ", " : ", .next_states = {", gen_states[i].next_states[c]);
+        }
+        fprintf(out, "%s}, \\\n", gen_states[i].num_children > 0 ? "}" : "");
+    }
+    fprintf(out, "}\n\n");
+    fprintf(out, "extern const char *const path_gen_state_names[PATH_GEN_NUM_STATES];\n\n");
+    fprintf(out, "// same as path_encoder_encode_ids with IMPLEMENTATION 4. 'encoding' has PATH_GEN_ENCODING_LEN bytes.\n");
+    fprintf(out, "bool path_gen_encode_ids(const uint8_t *states, int len, uint8_t *encoding);\n");
+    fprintf(out, "// same as path_encoder_decode_ids with IMPLEMENTATION 4. 'states' has room for PATH_GEN_MAX_PATH_LEN.\n");
+    fprintf(out, "bool path_gen_decode_ids(const uint8_t *encoding, uint8_t *states, int *len);\n\n");
+    fprintf(out, "#endif  // PATH_GEN_H_\n");
+}
+
+void write_source(FILE *out, const char *definition, const char *header){
+    fprintf(out, "// generated by state_gen from %s; do not edit.\n", definition);
+    fprintf(out, "#include \"%s\"\n\n#include \"string.h\"\n\n#include \"bit_stream.h\"\n\n", header);
+
+    fprintf(out, "const char *const path_gen_state_names[PATH_GEN_NUM_STATES] = {");
+    for (int i = 0; i < num_gen_states; i++){
+        fprintf(out, "%s\"%s\"", i > 0 ? ", " : "", gen_states[i].name);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "bool path_gen_encode_ids(const uint8_t *states, int len, uint8_t *encoding){\n");
+    fprintf(out, "    memset(encoding, 0, PATH_GEN_ENCODING_LEN);\n");
+    fprintf(out, "    if (len < 1 || len > PATH_GEN_MAX_PATH_LEN) return false;\n");
+    fprintf(out, "    bit_writer_t writer;\n");
+    fprintf(out, "    bit_writer_init(&writer, &encoding[1], PATH_GEN_ENCODING_LEN - 1);\n");
+    fprintf(out, "    // child indexes gather in 'bits' and go to the writer a word at a time.\n");
+    fprintf(out, "    uint64_t bits = 0;\n");
+    fprintf(out, "    int count = 0;\n");
+    fprintf(out, "    for (int i = 0; i + 1 < len; i++){\n");
+    fprintf(out, "        int next = states[i+1];\n");
+    fprintf(out, "        switch (states[i]){\n");
+    for (int i = 0; i < num_gen_states; i++){
+        gen_state_t *state = &gen_states[i];
+        if (state->num_children == 0) continue;
+        int bits = bits_to_index(state->num_children);
+        fprintf(out, "        case %d: // %s\n", i, state->name);
+        if (bits == 0){
+            fprintf(out, "            if (next != %d) return false;\n", state->next_indexes[0]);
+        } else {
+            fprintf(out, "            switch (next){\n");
+            for (int c = 0; c < state->num_children; c++){
+                fprintf(out, "            case %d: bits |= (uint64_t) %d << count; break; // %s\n",
+                    state->next_indexes[c], c, state->next_states[c]);
+            }
+            fprintf(out, "            default: return false;\n");
+            fprintf(out, "            }\n");
+            fprintf(out, "            count += %d;\n", bits);
+        }
+        fprintf(out, "            break;\n");
+    }
+    fprintf(out, "        default: // no next states\n");
+    fprintf(out, "            return false;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "        if (count > BIT_STREAM_MAX_WIDTH - %d){\n", max_child_bits());
+    fprintf(out, "            bit_writer_put(&writer, bits, count);\n");
+    fprintf(out, "            bits = 0;\n");
+    fprintf(out, "            count = 0;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    bit_writer_put(&writer, bits, count);\n");
+    fprintf(out, "    if (writer.overflow) return false;\n");
+    fprintf(out, "    encoding[0] = (bit_writer_bits(&writer) + 7) / 8;\n");
+    fprintf(out, "    return true;\n");
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "bool path_gen_decode_ids(const uint8_t *encoding, uint8_t *states, int *len){\n");
+    fprintf(out, "    bit_reader_t reader;\n");
+    fprintf(out, "    bit_reader_init(&reader, &encoding[1], encoding[0]);\n");
+    fprintf(out, "    // child indexes are taken from 'bits', reloaded a word at a time.\n");
+    fprintf(out, "    uint64_t bits = bit_reader_peek(&reader, BIT_STREAM_MAX_WIDTH);\n");
+    fprintf(out, "    int used = 0;\n");
+    fprintf(out, "    int curr = PATH_GEN_START;\n");
+    fprintf(out, "    *len = 0;\n");
+    fprintf(out, "    while (*len < PATH_GEN_MAX_PATH_LEN){\n");
+    fprintf(out, "        states[(*len)++] = curr;\n");
+    fprintf(out, "        switch (curr){\n");
+    for (int i = 0; i < num_gen_states; i++){
+        gen_state_t *state = &gen_states[i];
+        if (state->num_children == 0 && 0 != strcmp(state->name, "DONE")) continue;
+        int bits = bits_to_index(state->num_children);
+        fprintf(out, "        case %d: // %s\n", i, state->name);
+        if (0 == strcmp(state->name, "DONE")){
+            fprintf(out, "            return true;\n");
+            continue;
+        }
+        if (bits == 0){
+            fprintf(out, "            curr = %d; // %s\n", state->next_indexes[0], state->next_states[0]);
+        } else {
+            fprintf(out, "            if (used > BIT_STREAM_MAX_WIDTH - %d){\n", bits);
+            fprintf(out, "                bit_reader_skip(&reader, used);\n");
+            fprintf(out, "                bits = bit_reader_peek(&reader, BIT_STREAM_MAX_WIDTH);\n");
+            fprintf(out, "                used = 0;\n");
+            fprintf(out, "            }\n");
+            fprintf(out, "            if (bit_reader_left(&reader) - used < %d) return false;\n", bits);
+            fprintf(out, "            used += %d;\n", bits);
+            fprintf(out, "            switch ((bits >> (used - %d)) & %d){\n", bits, (1 << bits) - 1);
+            for (int c = 0; c < state->num_children; c++){
+                fprintf(out, "            case %d: curr = %d; break; // %s\n", c, state->next_indexes[c], state->next_states[c]);
+            }
+            if (state->num_children < (1 << bits)) fprintf(out, "            default: return false;\n");
+            fprintf(out, "            }\n");
+        }
+        fprintf(out, "            break;\n");
+    }
+    fprintf(out, "        default: // no next states\n");
+    fprintf(out, "            return false;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    return false;\n");
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char **argv){
+    if (argc < 3){
+        fprintf(stderr, "usage: %s DEFINITION OUTPUT [MAX_PATH_LEN]\nwrites OUTPUT.h and OUTPUT.c\n", argv[0]);
+        return 1;
+    }
+    int max_path_len = argc > 3 ? atoi(argv[3]) : DEFAULT_MAX_PATH_LEN;
+    FILE *in = fopen(argv[1], "r");
+    if (in == NULL){
+        perror(argv[1]);
+        return 1;
+    }
+    read_definition(in);
+    fclose(in);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.h", argv[2]);
+    FILE *out = fopen(path, "w");
+    if (out == NULL){
+        perror(path);
+        return 1;
+    }
+    write_header(out, argv[1], max_path_len);
+    fclose(out);
+    snprintf(path, sizeof(path), "%s.c", argv[2]);
+    out = fopen(path, "w");
+    if (out == NULL){
+        perror(path);
+        return 1;
+    }
+    const char *header = strrchr(argv[2], '/');
+    snprintf(path, sizeof(path), "%s.h", header == NULL ? argv[2] : header + 1);
+    write_source(out, argv[1], path);
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,374 @@
+#include "tree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/trace.h"
+
+// Growable stack of ints, used by the traversals below in place of recursion so
+// deep (degenerate) trees cannot overflow the call stack.
+typedef struct {
+    int *items;
+    int len;
+    int cap;
+} int_stack_t;
+
+static bool intStackPush(int_stack_t *stack, int item){
+    if (stack->len == stack->cap){
+        int cap = stack->cap == 0 ? 64 : 2 * stack->cap;
+        int *items = realloc(stack->items, cap * sizeof(int));
+        if (items == NULL) return false;
+        stack->items = items;
+        stack->cap = cap;
+    }
+    stack->items[stack->len++] = item;
+    return true;
+}
+
+// Same, for native node pointers with the array position of the parent whose .right they are.
+typedef struct {
+    node_t *tree;
+    int parent_idx;
+} node_frame_t;
+
+// frames from 'scratch' if it is set, grown in place there, else from malloc.
+typedef struct {
+    node_frame_t *frames;
+    int len;
+    int cap;
+    arena_t *scratch;
+} node_stack_t;
+
+static bool nodeStackPush(node_stack_t *stack, node_t *tree, int parent_idx){
+    if (stack->len == stack->cap){
+        int cap = stack->cap == 0 ? 64 : 2 * stack->cap;
+        if (stack->scratch == NULL){
+            node_frame_t *frames = realloc(stack->frames, cap * sizeof(node_frame_t));
+            if (frames == NULL) return false;
+            stack->frames = frames;
+        } else if (stack->frames == NULL){
+            stack->frames = arena_alloc(stack->scratch, cap * sizeof(node_frame_t), sizeof(void *));
+            if (stack->frames == NULL) return false;
+        } else if (!arena_grow(stack->scratch, stack->frames, cap * sizeof(node_frame_t))){
+            return false;
+        }
+        stack->cap = cap;
+    }
+    stack->frames[stack->len].tree = tree;
+    stack->frames[stack->len].parent_idx = parent_idx;
+    stack->len++;
+    return true;
+}
+
+static void nodeStackFree(node_stack_t *stack){
+    if (stack->scratch == NULL) free(stack->frames);
+}
+
+int serializeTree(node_t *tree, node2_t *tree_array, int idx){
+    return serializeTreeScratch(tree, tree_array, idx, NULL);
+}
+
+int serializeTreeScratch(node_t *tree, node2_t *tree_array, int idx, arena_t *scratch){
+    if (tree == NULL) return -1;
+    TRACE_BEGIN("serializeTree");
+    size_t mark = scratch == NULL ? 0 : arena_mark(scratch);
+    node_stack_t stack = { .scratch = scratch };
+    if (!nodeStackPush(&stack, tree, -1)){
+        TRACE_END("serializeTree");
+        return -1;
+    }
+    bool ok = true;
+    while (stack.len > 0){
+        node_frame_t frame = stack.frames[--stack.len];
+        node_t *node = frame.tree;
+        if (frame.parent_idx != -1) tree_array[frame.parent_idx].right = idx;
+        tree_array[idx].value = node->value;
+        tree_array[idx].left = node->left == NULL ? -1 : idx + 1;
+        tree_array[idx].right = -1;
+        // push right first so the whole left subtree is written before it.
+        if ((node->right != NULL && !nodeStackPush(&stack, node->right, idx)) ||
+            (node->left != NULL && !nodeStackPush(&stack, node->left, -1))){
+            ok = false;
+            break;
+        }
+        idx++;
+    }
+    nodeStackFree(&stack);
+    if (scratch != NULL) arena_release(scratch, mark);
+    TRACE_END("serializeTree");
+    return ok ? idx - 1 : -1;
+}
+
+node_t *deserializeTree(node2_t *tree_array, node_t *tree, int start_idx, int end_idx){
+    for (int i = start_idx; i <= end_idx; i++){
+        int left_idx = tree_array[i].left;
+        int right_idx = tree_array[i].right;
+        tree[i].value = tree_array[i].value;
+        tree[i].left = left_idx == -1 ? NULL : &tree[left_idx];
+        tree[i].right = right_idx == -1 ? NULL : &tree[right_idx];
+    }
+    return &tree[start_idx];
+}
+
+int countTreeNodes(node_t *tree){
+    if (tree == NULL) return 0;
+    node_stack_t stack = { 0 };
+    int count = 0;
+    if (!nodeStackPush(&stack, tree, -1)) return -1;
+    while (stack.len > 0){
+        node_t *node = stack.frames[--stack.len].tree;
+        count++;
+        if ((node->right != NULL && !nodeStackPush(&stack, node->right, -1)) ||
+            (node->left != NULL && !nodeStackPush(&stack, node->left, -1))){
+            count = -1;
+            break;
+        }
+    }
+    nodeStackFree(&stack);
+    return count;
+}
+
+// nodes are pointer aligned, so blocks are sizeof(node_t) apart and a run of them is a node_t array.
+size_t nodeArenaBytes(int cap){
+    return block_pool_bytes(cap, sizeof(node_t), sizeof(void *));
+}
+
+bool nodeArenaInitBuffer(node_arena_t *arena, void *buf, size_t size){
+    arena->block = NULL;
+    return block_pool_init(&arena->pool, buf, size, sizeof(node_t), sizeof(void *));
+}
+
+bool nodeArenaInit(node_arena_t *arena, int cap){
+    void *block = malloc(nodeArenaBytes(cap));
+    if (block == NULL || !nodeArenaInitBuffer(arena, block, nodeArenaBytes(cap))){
+        free(block);
+        return false;
+    }
+    arena->block = block;
+    return true;
+}
+
+node_t *nodeArenaAlloc(node_arena_t *arena, int value){
+    node_t *node = block_pool_alloc(&arena->pool);
+    if (node == NULL) return NULL;
+    node->value = value;
+    node->left = NULL;
+    node->right = NULL;
+    return node;
+}
+
+// 'n' consecutive nodes from the unused end of the arena (never from the free list),
+// so a serialized index can be turned straight into a pointer.
+static node_t *nodeArenaAllocArray(node_arena_t *arena, int n){
+    return block_pool_alloc_run(&arena->pool, n);
+}
+
+void nodeArenaFree(node_arena_t *arena, node_t *node){
+    block_pool_free(&arena->pool, node);
+}
+
+void nodeArenaReset(node_arena_t *arena){
+    block_pool_reset(&arena->pool);
+}
+
+void nodeArenaDestroy(node_arena_t *arena){
+    free(arena->block);
+    memset(arena, 0, sizeof(node_arena_t));
+}
+
+// number of levels below and including the root.
+static int indexTreeHeight(const index_tree_t *itree, int *queue){
+    if (itree->len == 0) return 0;
+    int head = 0, tail = 0, height = 0;
+    queue[tail++] = 0;
+    while (head < tail){
+        // one level per pass: everything queued so far is at the same depth.
+        for (int level_end = tail; head < level_end; head++){
+            node2_t node = itree->nodes[queue[head]];
+            if (node.left != -1) queue[tail++] = node.left;
+            if (node.right != -1) queue[tail++] = node.right;
+        }
+        height++;
+    }
+    return height;
+}
+
+// push the nodes exactly 'depth' levels below 'root' onto 'frontier', left to right.
+static bool collectFrontier(const index_tree_t *itree, int root, int depth, int_stack_t *frontier, int_stack_t *dfs){
+    dfs->len = 0;
+    // pairs of (index, depth). right is pushed before left so left pops first.
+    if (!intStackPush(dfs, root) || !intStackPush(dfs, 0)) return false;
+    while (dfs->len > 0){
+        int d = dfs->items[--dfs->len];
+        int i = dfs->items[--dfs->len];
+        if (d == depth){
+            if (!intStackPush(frontier, i)) return false;
+            continue;
+        }
+        node2_t node = itree->nodes[i];
+        if (node.right != -1 && (!intStackPush(dfs, node.right) || !intStackPush(dfs, d + 1))) return false;
+        if (node.left != -1 && (!intStackPush(dfs, node.left) || !intStackPush(dfs, d + 1))) return false;
+    }
+    return true;
+}
+
+// fill order[k] with the index in 'itree' of the node that goes to position k of 'layout'.
+static bool layoutOrder(const index_tree_t *itree, tree_layout_t layout, int *order){
+    int k = 0;
+    if (itree->len == 0) return true;
+    if (layout == TREE_LAYOUT_BFS){
+        // order doubles as the queue.
+        order[k++] = 0;
+        for (int head = 0; head < k; head++){
+            node2_t node = itree->nodes[order[head]];
+            if (node.left != -1) order[k++] = node.left;
+            if (node.right != -1) order[k++] = node.right;
+        }
+        return true;
+    }
+    int_stack_t work = { 0 };
+    bool ok = true;
+    if (layout == TREE_LAYOUT_PREORDER){
+        ok = intStackPush(&work, 0);
+        while (ok && work.len > 0){
+            int i = work.items[--work.len];
+            node2_t node = itree->nodes[i];
+            order[k++] = i;
+            if (node.right != -1) ok = ok && intStackPush(&work, node.right);
+            if (node.left != -1) ok = ok && intStackPush(&work, node.left);
+        }
+        free(work.items);
+        return ok;
+    }
+    // van Emde Boas. Work items are (subtree root, levels); a subtree of h levels is laid out
+    // as its top h/2 levels, then each subtree hanging below them, left to right. The top is
+    // pushed last so it is expanded first.
+    int_stack_t frontier = { 0 }, dfs = { 0 };
+    ok = intStackPush(&work, 0) && intStackPush(&work, indexTreeHeight(itree, order));
+    while (ok && work.len > 0){
+        int h = work.items[--work.len];
+        int i = work.items[--work.len];
+        if (h == 1){
+            order[k++] = i;
+            continue;
+        }
+        int top = h / 2;
+        frontier.len = 0;
+        ok = collectFrontier(itree, i, top, &frontier, &dfs);
+        for (int f = frontier.len - 1; ok && f >= 0; f--){
+            ok = intStackPush(&work, frontier.items[f]) && intStackPush(&work, h - top);
+        }
+        ok = ok && intStackPush(&work, i) && intStackPush(&work, top);
+    }
+    free(work.items);
+    free(frontier.items);
+    free(dfs.items);
+    return ok;
+}
+
+bool indexTreeRelayout(const index_tree_t *src, index_tree_t *dst, tree_layout_t layout){
+    int n = src->len;
+    int *order = malloc((n + 1) * sizeof(int));
+    int *new_idx = malloc((n + 1) * sizeof(int));
+    node2_t *nodes = malloc((n + 1) * sizeof(node2_t));
+    if (order == NULL || new_idx == NULL || nodes == NULL || !layoutOrder(src, layout, order)){
+        free(order);
+        free(new_idx);
+        free(nodes);
+        return false;
+    }
+    for (int k = 0; k < n; k++){
+        new_idx[order[k]] = k;
+    }
+    for (int k = 0; k < n; k++){
+        node2_t node = src->nodes[order[k]];
+        nodes[k].value = node.value;
+        nodes[k].left = node.left == -1 ? -1 : new_idx[node.left];
+        nodes[k].right = node.right == -1 ? -1 : new_idx[node.right];
+    }
+    free(order);
+    free(new_idx);
+    dst->layout = layout;
+    dst->len = n;
+    dst->nodes = nodes;
+    dst->owned = true;
+    return true;
+}
+
+bool indexTreeFromTree(index_tree_t *itree, node_t *tree, tree_layout_t layout){
+    int n = countTreeNodes(tree);
+    if (n < 0) return false;
+    index_tree_t preorder = {
+        .layout = TREE_LAYOUT_PREORDER,
+        .len = n,
+        .nodes = malloc((n + 1) * sizeof(node2_t)),
+        .owned = true
+    };
+    if (preorder.nodes == NULL) return false;
+    if (n > 0 && serializeTree(tree, preorder.nodes, 0) != n - 1){
+        indexTreeFree(&preorder);
+        return false;
+    }
+    if (layout == TREE_LAYOUT_PREORDER){
+        *itree = preorder;
+        return true;
+    }
+    bool ok = indexTreeRelayout(&preorder, itree, layout);
+    indexTreeFree(&preorder);
+    return ok;
+}
+
+void indexTreeFree(index_tree_t *itree){
+    if (itree->owned) free(itree->nodes);
+    itree->nodes = NULL;
+    itree->len = 0;
+}
+
+node_t *indexTreeToTree(const index_tree_t *itree, node_arena_t *arena){
+    if (itree->len == 0) return NULL;
+    node_t *tree = nodeArenaAllocArray(arena, itree->len);
+    if (tree == NULL) return NULL;
+    // the arena block is indexed like itree->nodes, so this is deserializeTree.
+    return deserializeTree(itree->nodes, tree, 0, itree->len - 1);
+}
+
+int indexTreeFind(const index_tree_t *itree, int value){
+    int i = itree->len > 0 ? 0 : -1;
+    while (i != -1 && itree->nodes[i].value != value){
+        i = value < itree->nodes[i].value ? itree->nodes[i].left : itree->nodes[i].right;
+    }
+    return i;
+}
+
+void indexTreePrintInOrder(const index_tree_t *itree){
+    int_stack_t stack = { 0 };
+    int i = itree->len > 0 ? 0 : -1;
+    while (i != -1 || stack.len > 0){
+        if (i != -1){
+            if (!intStackPush(&stack, i)) break;
+            i = itree->nodes[i].left;
+            continue;
+        }
+        i = stack.items[--stack.len];
+        printf("%d ", itree->nodes[i].value);
+        i = itree->nodes[i].right;
+    }
+    free(stack.items);
+}
+
+size_t indexTreeBytes(const index_tree_t *itree){
+    return itree->len * sizeof(node2_t);
+}
+
+size_t indexTreeSerialize(const index_tree_t *itree, void *buf){
+    memcpy(buf, itree->nodes, indexTreeBytes(itree));
+    return indexTreeBytes(itree);
+}
+
+void indexTreeView(index_tree_t *itree, void *buf, int len, tree_layout_t layout){
+    itree->layout = layout;
+    itree->len = len;
+    itree->nodes = buf;
+    itree->owned = false;
+}
@@ -0,0 +1,136 @@
+#ifndef TREE_H_
+#define TREE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/arena.h"
+
+// Shared tree types and helpers. tree_serializer_soln.c is the walkthrough of the
+// node2_t serialization; this is the same layout packaged for reuse.
+
+// Native tree interface using a recursive type definition and pointers.
+typedef struct node_t {
+    int value;
+    struct node_t *left;
+    struct node_t *right;
+} node_t;
+
+// Serialized tree interface: children are array indexes, -1 for none.
+typedef struct {
+    int value;
+    int left;
+    int right;
+} node2_t;
+
+/* serializeTree
+ * serialize 'tree' in preorder into 'tree_array', starting at position 'idx'.
+ * same layout as tree_serializer_soln.c, without recursion.
+ * return the index of the final array position of the serialization, or -1 if 'tree' is NULL.
+*/
+int serializeTree(node_t *tree, node2_t *tree_array, int idx);
+
+/* serializeTreeScratch
+ * serializeTree without malloc: the traversal stack comes from 'scratch' and is given back
+ * before it returns. The stack holds a 16 byte frame for every right subtree still to be
+ * written, at most half the nodes. return -1 also if 'scratch' runs out.
+*/
+int serializeTreeScratch(node_t *tree, node2_t *tree_array, int idx, arena_t *scratch);
+
+/* deserializeTree
+ * rebuild the native tree serialized between 'start_idx' and 'end_idx' into 'tree',
+ * which has room for at least end_idx+1 nodes. return a pointer to the root.
+*/
+node_t *deserializeTree(node2_t *tree_array, node_t *tree, int start_idx, int end_idx);
+
+// tree_serializer_soln.c's own serializeTreeIterative, serializeTree and deserializeTree, built
+// with -D TREE_LIB: the same layout as the three above, for cross-checking them.
+int serializeTreeWalkthrough(node_t *tree, node2_t *tree_array, int idx);
+int serializeTreeWalkthroughRecursive(node_t *tree, node2_t *tree_array, int idx);
+node_t *deserializeTreeWalkthrough(node2_t *tree_array, node_t *tree, int start_idx, int end_idx);
+
+// tree_serializer_soln2.c's format: one int per node value, and -1 for every missing child
+// (so -1 cannot be stored as a value). These are that file's own functions, built with
+// -D TREE_LIB; the recursive pair is there for cross-checking, as deep trees overflow the stack.
+
+/* serializeTreeSentinel
+ * serialize 'tree' in preorder into 'tree_array', beginning at position 'idx', without recursion.
+ * return the final array position, or -1 on allocation failure.
+*/
+int serializeTreeSentinel(node_t *tree, int *tree_array, int idx);
+int serializeTreeSentinelRecursive(node_t *tree, int *tree_array, int idx);
+
+/* deserializeTreeSentinel
+ * rebuild the tree serialized at 'start_idx' into 'tree', which has room for the serialization's
+ * length in nodes, without recursion. sets '*end_idx' to the final array position. return the root.
+*/
+node_t *deserializeTreeSentinel(int *tree_array, node_t *tree, int start_idx, int *end_idx);
+node_t *deserializeTreeSentinelRecursive(int *tree_array, node_t *tree, int start_idx, int *end_idx);
+
+// number of nodes in 'tree'.
+int countTreeNodes(node_t *tree);
+
+// Arena for native nodes: a block_pool_t of nodes, in one allocation up front or in the
+// caller's memory. Nodes are handed out in order; freed ones are reused first.
+// nodeArenaReset drops every node at once.
+typedef struct {
+    block_pool_t pool;
+    void *block;           // nodeArenaInit's allocation; NULL in the caller's memory
+} node_arena_t;
+
+bool nodeArenaInit(node_arena_t *arena, int cap);
+// an arena in the caller's 'size' bytes at 'buf'. nodeArenaBytes(cap) bytes hold 'cap' nodes.
+bool nodeArenaInitBuffer(node_arena_t *arena, void *buf, size_t size);
+size_t nodeArenaBytes(int cap);
+// return a node with 'value' and no children, or NULL if the arena is full.
+node_t *nodeArenaAlloc(node_arena_t *arena, int value);
+void nodeArenaFree(node_arena_t *arena, node_t *node);
+void nodeArenaReset(node_arena_t *arena);
+void nodeArenaDestroy(node_arena_t *arena);
+
+// Node order of an index_tree_t.
+//   TREE_LAYOUT_PREORDER: same order as serializeTree.
+//   TREE_LAYOUT_BFS:      level by level (Eytzinger). A complete tree gets children 2i+1, 2i+2,
+//                         and the top levels every search touches share the first cache lines.
+//   TREE_LAYOUT_VEB:      van Emde Boas: the top half of the levels first, then each bottom
+//                         subtree contiguously, recursively. Any root-to-leaf walk crosses
+//                         O(log_B n) cache lines whatever the line size B.
+typedef enum {
+    TREE_LAYOUT_PREORDER,
+    TREE_LAYOUT_BFS,
+    TREE_LAYOUT_VEB
+} tree_layout_t;
+
+// Pointer-free tree: nodes[0] is the root (if len > 0), children are indexes into nodes.
+// Because it holds no pointers, the nodes array is its own serialization: see
+// indexTreeSerialize and indexTreeView.
+typedef struct {
+    tree_layout_t layout;
+    int len;
+    node2_t *nodes;
+    bool owned; // false when 'nodes' points into a caller's buffer (indexTreeView)
+} index_tree_t;
+
+// build an index tree with the given layout from a native tree. return false on allocation failure.
+bool indexTreeFromTree(index_tree_t *itree, node_t *tree, tree_layout_t layout);
+// copy 'src' into 'dst' with another layout.
+bool indexTreeRelayout(const index_tree_t *src, index_tree_t *dst, tree_layout_t layout);
+void indexTreeFree(index_tree_t *itree);
+
+// rebuild the native tree with nodes from 'arena'. return the root, or NULL if empty or the arena is full.
+node_t *indexTreeToTree(const index_tree_t *itree, node_arena_t *arena);
+
+// binary search tree lookup. return the index of the node holding 'value', or -1.
+int indexTreeFind(const index_tree_t *itree, int value);
+// same output as printTreeInOrder.
+void indexTreePrintInOrder(const index_tree_t *itree);
+
+// bytes needed to serialize 'itree'.
+size_t indexTreeBytes(const index_tree_t *itree);
+// copy the nodes into 'buf' (indexTreeBytes long) with a single memcpy. return bytes written.
+size_t indexTreeSerialize(const index_tree_t *itree, void *buf);
+// use 'len' nodes serialized in 'buf' in place, with no copy. 'buf' must outlive 'itree'.
+void indexTreeView(index_tree_t *itree, void *buf, int len, tree_layout_t layout);
+
+#endif  // TREE_H_
@@ -0,0 +1,412 @@
+/*
+Benchmark and round-trip fuzz harness for every tree serialization format:
+    node2      serializeTree / deserializeTree, tree.c's packaging of tree_serializer_soln.c
+    sentinel   serializeTreeSentinel / deserializeTreeSentinel, tree_serializer_soln2.c's own code
+    bfs, veb   index_tree_t in BFS and van Emde Boas layout, serialized with a memcpy
+    file       tree_file.h, written to disk and mmap'ed back
+    varint     tree_varint.h
+The tree_serializer.c stub is the unsolved exercise and has no format of its own.
+
+For each format and tree shape (random, balanced, degenerate, bushy) the benchmark reports
+serialize and deserialize throughput, serialized bytes per node, and the peak memory the
+round trip needed on top of the input tree. Each run is forked so peaks do not carry over.
+
+The fuzz harness round trips random trees of every shape and size up to FUZZ_MAX_NODES through
+every format, and checks that each comes back identical. It also checks serializeTreeParallel
+and tree_serializer_soln.c's own recursive and iterative serializers and its deserializer against
+tree.c's, and tree_serializer_soln2.c's recursive serializer and deserializer against its
+iterative ones.
+
+compile:
+make tree_codec_bench
+
+run:
+./tree_codec_bench [nodes]
+./tree_codec_bench fuzz [iterations]
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tree.h"
+#include "tree_file.h"
+#include "tree_parallel.h"
+#include "tree_varint.h"
+
+#define BENCH_NODES 1000000
+#define FUZZ_ITERATIONS 10000
+#define FUZZ_MAX_NODES 300
+#define FUZZ_THREADS 4
+#define BENCH_FILE "tree_codec_bench.tree"
+
+double now_sec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Tree shapes. Each links nodes[0, n) into a tree rooted at nodes[0].
+typedef enum {
+    SHAPE_RANDOM,     // random binary search tree, no rebalancing
+    SHAPE_BALANCED,   // complete tree
+    SHAPE_DEGENERATE, // linked list, alternating left and right children
+    SHAPE_BUSHY,      // built level by level, each node has two children 90% of the time
+    NUM_SHAPES
+} tree_shape_t;
+
+const char *shape_names[] = {"random", "balanced", "degenerate", "bushy"};
+
+// values avoid -1, which the sentinel format reserves for missing children.
+int randomValue(bool small){
+    int value = small ? rand() % 256 - 128 : (int) ((uint32_t) rand() << 16 ^ (uint32_t) rand());
+    return value == -1 ? 0 : value;
+}
+
+node_t *buildTree(node_t *nodes, int n, tree_shape_t shape, bool small_values){
+    // the random shape inserts by wide keys, so few distinct small values cannot make it a list.
+    for (int i = 0; i < n; i++){
+        nodes[i].value = randomValue(false);
+        nodes[i].left = NULL;
+        nodes[i].right = NULL;
+    }
+    if (shape == SHAPE_RANDOM){
+        for (int i = 1; i < n; i++){
+            node_t *curr = &nodes[0];
+            while (true){
+                node_t **next = nodes[i].value < curr->value ? &curr->left : &curr->right;
+                if (*next == NULL){
+                    *next = &nodes[i];
+                    break;
+                }
+                curr = *next;
+            }
+        }
+    } else if (shape == SHAPE_BALANCED){
+        for (int i = 0; i < n; i++){
+            nodes[i].left = 2 * i + 1 < n ? &nodes[2 * i + 1] : NULL;
+            nodes[i].right = 2 * i + 2 < n ? &nodes[2 * i + 2] : NULL;
+        }
+    } else if (shape == SHAPE_DEGENERATE){
+        for (int i = 0; i + 1 < n; i++){
+            if (i % 2 == 0) nodes[i].left = &nodes[i + 1];
+            else nodes[i].right = &nodes[i + 1];
+        }
+    } else {
+        // nodes[parent] gets children in order; nodes[next] is the next unused node.
+        for (int parent = 0, next = 1; next < n; parent++){
+            bool both = rand() % 10 != 0;
+            if (both || rand() % 2) nodes[parent].left = &nodes[next++];
+            if (next < n && (both || nodes[parent].left == NULL)) nodes[parent].right = &nodes[next++];
+        }
+    }
+    for (int i = 0; small_values && i < n; i++){
+        nodes[i].value = randomValue(true);
+    }
+    return n > 0 ? &nodes[0] : NULL;
+}
+
+// true if 'a' and 'b' have the same shape and values.
+bool sameTree(node_t *a, node_t *b){
+    int len = 0, cap = 64;
+    node_t **stack = malloc(2 * cap * sizeof(node_t *));
+    bool same = stack != NULL;
+    if (same){
+        stack[len++] = a;
+        stack[len++] = b;
+    }
+    while (same && len > 0){
+        node_t *y = stack[--len], *x = stack[--len];
+        if (x == NULL || y == NULL){
+            same = x == y;
+            continue;
+        }
+        if (x->value != y->value){
+            same = false;
+            break;
+        }
+        if (len + 4 > 2 * cap){
+            cap *= 2;
+            node_t **grown = realloc(stack, 2 * cap * sizeof(node_t *));
+            if (grown == NULL){
+                same = false;
+                break;
+            }
+            stack = grown;
+        }
+        stack[len++] = x->right;
+        stack[len++] = y->right;
+        stack[len++] = x->left;
+        stack[len++] = y->left;
+    }
+    free(stack);
+    return same;
+}
+
+// A serialization format. serialize writes 'tree' (n nodes) into a buffer it allocates and
+// returns its size in bytes (0 on failure). deserialize rebuilds the tree from that buffer
+// into 'out', which has room for out_len nodes, and returns the root.
+typedef struct {
+    const char *name;
+    size_t (*serialize)(node_t *tree, int n, void **buf);
+    node_t *(*deserialize)(void *buf, size_t bytes, int n, node_t *out, int out_len);
+    int out_nodes_per_node; // 'out' room needed per tree node
+} tree_format_t;
+
+size_t node2Serialize(node_t *tree, int n, void **buf){
+    node2_t *tree_array = malloc(n * sizeof(node2_t));
+    *buf = tree_array;
+    if (tree_array == NULL || serializeTree(tree, tree_array, 0) != n - 1) return 0;
+    return n * sizeof(node2_t);
+}
+
+node_t *node2Deserialize(void *buf, size_t bytes, int n, node_t *out, int out_len){
+    return deserializeTree(buf, out, 0, n - 1);
+}
+
+size_t sentinelSerialize(node_t *tree, int n, void **buf){
+    int *tree_array = malloc((2 * n + 1) * sizeof(int));
+    *buf = tree_array;
+    if (tree_array == NULL || serializeTreeSentinel(tree, tree_array, 0) != 2 * n) return 0;
+    return (2 * n + 1) * sizeof(int);
+}
+
+node_t *sentinelDeserialize(void *buf, size_t bytes, int n, node_t *out, int out_len){
+    int end_idx;
+    return deserializeTreeSentinel(buf, out, 0, &end_idx);
+}
+
+size_t indexSerialize(node_t *tree, int n, void **buf, tree_layout_t layout){
+    index_tree_t itree;
+    *buf = NULL;
+    if (!indexTreeFromTree(&itree, tree, layout)) return 0;
+    // the index tree's node array is the serialization.
+    *buf = itree.nodes;
+    return indexTreeBytes(&itree);
+}
+
+size_t bfsSerialize(node_t *tree, int n, void **buf){
+    return indexSerialize(tree, n, buf, TREE_LAYOUT_BFS);
+}
+
+size_t vebSerialize(node_t *tree, int n, void **buf){
+    return indexSerialize(tree, n, buf, TREE_LAYOUT_VEB);
+}
+
+node_t *indexDeserialize(void *buf, size_t bytes, int n, node_t *out, int out_len){
+    index_tree_t itree;
+    node_arena_t arena;
+    nodeArenaInitBuffer(&arena, out, out_len * sizeof(node_t));
+    indexTreeView(&itree, buf, n, TREE_LAYOUT_PREORDER);
+    return indexTreeToTree(&itree, &arena);
+}
+
+size_t fileSerialize(node_t *tree, int n, void **buf){
+    index_tree_t itree;
+    *buf = NULL;
+    if (!indexTreeFromTree(&itree, tree, TREE_LAYOUT_PREORDER)) return 0;
+    bool ok = treeFileWrite(BENCH_FILE, &itree);
+    indexTreeFree(&itree);
+    return ok ? TREE_FILE_DATA_OFFSET + n * sizeof(node2_t) : 0;
+}
+
+node_t *fileDeserialize(void *buf, size_t bytes, int n, node_t *out, int out_len){
+    tree_file_t file;
+    node_arena_t arena;
+    nodeArenaInitBuffer(&arena, out, out_len * sizeof(node_t));
+    if (!treeFileOpen(&file, BENCH_FILE, false)) return NULL;
+    node_t *root = indexTreeToTree(treeFileTree(&file), &arena);
+    treeFileClose(&file);
+    return root;
+}
+
+size_t varintSerialize(node_t *tree, int n, void **buf){
+    node2_t *tree_array = malloc(n * sizeof(node2_t));
+    uint8_t *encoded = malloc(treeVarintMaxBytes(n));
+    size_t bytes = 0;
+    *buf = encoded;
+    if (tree_array != NULL && encoded != NULL && serializeTree(tree, tree_array, 0) == n - 1){
+        bytes = treeVarintEncode(tree_array, n, encoded);
+    }
+    free(tree_array);
+    return bytes;
+}
+
+node_t *varintDeserialize(void *buf, size_t bytes, int n, node_t *out, int out_len){
+    node2_t *tree_array = malloc(n * sizeof(node2_t));
+    node_t *root = NULL;
+    if (tree_array != NULL && treeVarintDecode(buf, bytes, tree_array) == n){
+        root = deserializeTree(tree_array, out, 0, n - 1);
+    }
+    free(tree_array);
+    return root;
+}
+
+tree_format_t formats[] = {
+    {"node2", node2Serialize, node2Deserialize, 1},
+    {"sentinel", sentinelSerialize, sentinelDeserialize, 2},
+    {"bfs", bfsSerialize, indexDeserialize, 1},
+    {"veb", vebSerialize, indexDeserialize, 1},
+    {"file", fileSerialize, fileDeserialize, 1},
+    {"varint", varintSerialize, varintDeserialize, 1},
+};
+#define NUM_FORMATS ((int) (sizeof(formats) / sizeof(formats[0])))
+
+// round trip 'tree' through 'format'. return true if it comes back identical.
+bool roundTrip(tree_format_t *format, node_t *tree, int n, double *serialize_sec, double *deserialize_sec, size_t *bytes){
+    void *buf = NULL;
+    int out_len = format->out_nodes_per_node * n + 1;
+    node_t *out = malloc(out_len * sizeof(node_t));
+    if (out == NULL) return false;
+    double start = now_sec();
+    *bytes = format->serialize(tree, n, &buf);
+    *serialize_sec = now_sec() - start;
+    start = now_sec();
+    node_t *root = *bytes == 0 ? NULL : format->deserialize(buf, *bytes, n, out, out_len);
+    *deserialize_sec = now_sec() - start;
+    bool same = *bytes != 0 && sameTree(tree, root);
+    free(buf);
+    free(out);
+    return same;
+}
+
+// peak resident memory so far, in bytes.
+long peakRss(void){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss * 1024L;
+}
+
+typedef struct {
+    double serialize_sec;
+    double deserialize_sec;
+    size_t bytes;
+    long peak_bytes;
+    bool same;
+} bench_result_t;
+
+// runs in a forked child, so that peakRss only sees this round trip.
+bench_result_t benchOne(tree_format_t *format, tree_shape_t shape, int n){
+    bench_result_t result = { 0 };
+    node_t *nodes = malloc(n * sizeof(node_t));
+    if (nodes == NULL) return result;
+    srand(1);
+    node_t *tree = buildTree(nodes, n, shape, true);
+    long base = peakRss();
+    result.same = roundTrip(format, tree, n, &result.serialize_sec, &result.deserialize_sec, &result.bytes);
+    result.peak_bytes = peakRss() - base;
+    free(nodes);
+    return result;
+}
+
+int bench(int n){
+    printf("%-9s %-10s %9s %14s %14s %11s %10s %5s\n",
+        "format", "shape", "nodes", "ser Mnode/s", "deser Mnode/s", "bytes/node", "peak MB", "same");
+    bool all_same = true;
+    for (int f = 0; f < NUM_FORMATS; f++){
+        for (tree_shape_t shape = 0; shape < NUM_SHAPES; shape++){
+            int fds[2];
+            bench_result_t result = { 0 };
+            fflush(stdout);
+            if (pipe(fds) == -1) return 1;
+            pid_t pid = fork();
+            if (pid == 0){
+                result = benchOne(&formats[f], shape, n);
+                ssize_t written = write(fds[1], &result, sizeof(result));
+                _exit(written == sizeof(result) ? 0 : 1);
+            }
+            close(fds[1]);
+            if (pid == -1 || read(fds[0], &result, sizeof(result)) != sizeof(result)) result.same = false;
+            close(fds[0]);
+            waitpid(pid, NULL, 0);
+            all_same = all_same && result.same;
+            printf("%-9s %-10s %9d %14.1f %14.1f %11.2f %10.1f %5d\n",
+                formats[f].name, shape_names[shape], n,
+                n / result.serialize_sec / 1e6, n / result.deserialize_sec / 1e6,
+                (double) result.bytes / n, result.peak_bytes / 1e6, result.same);
+        }
+    }
+    remove(BENCH_FILE);
+    return all_same ? 0 : 1;
+}
+
+int fuzz(int iterations){
+    node_t *nodes = malloc(FUZZ_MAX_NODES * sizeof(node_t));
+    node2_t *expected = malloc(FUZZ_MAX_NODES * sizeof(node2_t));
+    node2_t *parallel = malloc(FUZZ_MAX_NODES * sizeof(node2_t));
+    node2_t *walkthrough = malloc(FUZZ_MAX_NODES * sizeof(node2_t));
+    int *sentinel = malloc((2 * FUZZ_MAX_NODES + 1) * sizeof(int));
+    int *sentinel_recursive = malloc((2 * FUZZ_MAX_NODES + 1) * sizeof(int));
+    node_t *rebuilt = malloc((2 * FUZZ_MAX_NODES + 1) * sizeof(node_t));
+    task_pool_t pool;
+    if (!task_pool_init(&pool, FUZZ_THREADS)){
+        printf("failed to start %d threads\n", FUZZ_THREADS);
+        return 1;
+    }
+    int failures = 0;
+    srand(2);
+    for (int i = 0; i < iterations; i++){
+        tree_shape_t shape = rand() % NUM_SHAPES;
+        int n = 1 + rand() % FUZZ_MAX_NODES;
+        node_t *tree = buildTree(nodes, n, shape, rand() % 2);
+        for (int f = 0; f < NUM_FORMATS; f++){
+            double serialize_sec, deserialize_sec;
+            size_t bytes;
+            if (!roundTrip(&formats[f], tree, n, &serialize_sec, &deserialize_sec, &bytes)){
+                printf("iteration %d: %s tree of %d nodes does not round trip through %s\n", i, shape_names[shape], n, formats[f].name);
+                failures++;
+            }
+        }
+        int end_idx = serializeTree(tree, expected, 0);
+        if (serializeTreeParallel(tree, parallel, 0, &pool) != end_idx ||
+            0 != memcmp(expected, parallel, n * sizeof(node2_t))){
+            printf("iteration %d: serializeTreeParallel differs on a %s tree of %d nodes\n", i, shape_names[shape], n);
+            failures++;
+        }
+        if (serializeTreeWalkthrough(tree, walkthrough, 0) != end_idx ||
+            0 != memcmp(expected, walkthrough, n * sizeof(node2_t)) ||
+            serializeTreeWalkthroughRecursive(tree, walkthrough, 0) != end_idx ||
+            0 != memcmp(expected, walkthrough, n * sizeof(node2_t)) ||
+            !sameTree(tree, deserializeTreeWalkthrough(expected, rebuilt, 0, end_idx))){
+            printf("iteration %d: tree_serializer_soln.c differs from tree.c on a %s tree of %d nodes\n", i, shape_names[shape], n);
+            failures++;
+        }
+        // fuzz trees are shallow enough for the recursive versions.
+        end_idx = serializeTreeSentinel(tree, sentinel, 0);
+        int rebuilt_end_idx = -1;
+        if (serializeTreeSentinelRecursive(tree, sentinel_recursive, 0) != end_idx ||
+            0 != memcmp(sentinel, sentinel_recursive, (end_idx + 1) * sizeof(int)) ||
+            serializeTreeSentinel(deserializeTreeSentinelRecursive(sentinel, rebuilt, 0, &rebuilt_end_idx), sentinel_recursive, 0) != end_idx ||
+            rebuilt_end_idx != end_idx || 0 != memcmp(sentinel, sentinel_recursive, (end_idx + 1) * sizeof(int))){
+            printf("iteration %d: tree_serializer_soln2.c's recursive and iterative versions differ on a %s tree of %d nodes\n", i, shape_names[shape], n);
+            failures++;
+        }
+    }
+    remove(BENCH_FILE);
+    printf("fuzz: %d iterations, %d formats, %d failures\n", iterations, NUM_FORMATS, failures);
+    task_pool_destroy(&pool);
+    free(nodes);
+    free(expected);
+    free(parallel);
+    free(walkthrough);
+    free(sentinel);
+    free(sentinel_recursive);
+    free(rebuilt);
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv){
+    if (argc > 1 && strcmp(argv[1], "fuzz") == 0){
+        return fuzz(argc > 2 ? atoi(argv[2]) : FUZZ_ITERATIONS);
+    }
+    return bench(argc > 1 ? atoi(argv[1]) : BENCH_NODES);
+}
@@ -0,0 +1,163 @@
+/*
+Walkthrough of tree.h: arena-allocated native trees and the pointer-free index_tree_t,
+of tree_file.h: the same trees mmap'ed from disk and read in place,
+and of tree_varint.h: the compressed preorder format.
+
+compile:
+make tree_demo
+
+run:
+./tree_demo
+
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree.h"
+#include "tree_file.h"
+#include "tree_varint.h"
+
+const char *layout_names[] = {"preorder", "bfs", "veb"};
+
+// Helper function to print a tree with an "in order" traversal (left subtree, me, right subtree).
+void printTreeInOrder(node_t *tree){
+    if (tree == NULL) return;
+    printTreeInOrder(tree->left);
+    printf("%d ", tree->value);
+    printTreeInOrder(tree->right);
+    return;
+}
+
+// Insert 'value' into a binary search tree, allocating the new node from 'arena'.
+node_t *insertNode(node_arena_t *arena, node_t *tree, int value){
+    node_t *node = nodeArenaAlloc(arena, value);
+    if (node == NULL || tree == NULL) return node;
+    node_t *curr = tree;
+    while (true){
+        node_t **next = value < curr->value ? &curr->left : &curr->right;
+        if (*next == NULL){
+            *next = node;
+            return tree;
+        }
+        curr = *next;
+    }
+}
+
+int main(void){
+    // the nodes live in memory of our own, no malloc; nodeArenaInit(&arena, 64) would allocate it.
+    static node_t node_memory[64];
+    node_arena_t arena;
+    if (!nodeArenaInitBuffer(&arena, node_memory, sizeof(node_memory))){
+        printf("failed to set up arena\n");
+        return 1;
+    }
+
+    // the test tree from tree_serializer.c, built one node at a time from the arena.
+    // 4
+    //    left:  2
+    //    right: 5
+    //         left:  NULL
+    //         right: 6
+    node_t *tree = NULL;
+    int values[] = {4, 2, 5, 6};
+    for (int i = 0; i < 4; i++){
+        tree = insertNode(&arena, tree, values[i]);
+    }
+    printf("Tree: ");
+    printTreeInOrder(tree);
+    printf("\n");
+
+    // serialized with the traversal stack in a scratch arena on our stack, given back after.
+    uint64_t scratch_memory[128];
+    arena_t scratch;
+    arena_init(&scratch, scratch_memory, sizeof(scratch_memory));
+    node2_t tree_array[4];
+    int end_idx = serializeTreeScratch(tree, tree_array, 0, &scratch);
+    printf("serialized %d nodes, %zu bytes of scratch in use after\n", end_idx + 1, arena_mark(&scratch));
+
+    // and a complete search tree of 15 nodes, where the layouts differ the most.
+    node_t *bst = NULL;
+    int bst_values[] = {8, 4, 12, 2, 6, 10, 14, 1, 3, 5, 7, 9, 11, 13, 15};
+    for (int i = 0; i < 15; i++){
+        bst = insertNode(&arena, bst, bst_values[i]);
+    }
+    printf("Search tree: ");
+    printTreeInOrder(bst);
+    printf("\n");
+
+    for (tree_layout_t layout = TREE_LAYOUT_PREORDER; layout <= TREE_LAYOUT_VEB; layout++){
+        index_tree_t itree;
+        if (!indexTreeFromTree(&itree, bst, layout)){
+            printf("failed to build index tree\n");
+            return 1;
+        }
+        printf("\n%s layout: ", layout_names[layout]);
+        for (int i = 0; i < itree.len; i++){
+            printf("%d ", itree.nodes[i].value);
+        }
+        printf("\nin order: ");
+        indexTreePrintInOrder(&itree);
+        printf("\nfind 11: index %d, find 16: index %d\n", indexTreeFind(&itree, 11), indexTreeFind(&itree, 16));
+
+        // serialization is one memcpy, and the bytes can be used in place with no fix-up.
+        size_t bytes = indexTreeBytes(&itree);
+        void *buf = malloc(bytes);
+        indexTreeSerialize(&itree, buf);
+        index_tree_t view;
+        indexTreeView(&view, buf, itree.len, layout);
+        printf("serialized %d nodes in %zu bytes, view finds 11 at index %d\n", view.len, bytes, indexTreeFind(&view, 11));
+
+        // and back to a native tree, allocated from the arena.
+        node_t *native = indexTreeToTree(&view, &arena);
+        printf("native: ");
+        printTreeInOrder(native);
+        printf("\n");
+        free(buf);
+        indexTreeFree(&itree);
+    }
+
+    // write the search tree to disk and read it back in place.
+    index_tree_t itree;
+    tree_file_t file;
+    const char *path = "tree_demo.tree";
+    if (!indexTreeFromTree(&itree, bst, TREE_LAYOUT_VEB) || !treeFileWrite(path, &itree)){
+        printf("failed to write %s\n", path);
+        return 1;
+    }
+    indexTreeFree(&itree);
+    if (!treeFileOpen(&file, path, true)){
+        printf("failed to open %s\n", path);
+        return 1;
+    }
+    printf("\n%s: %d nodes, root %d (left %d, right %d), find 11: index %d\nin order: ",
+        path, treeFileLen(&file), treeFileValue(&file, 0),
+        treeFileValue(&file, treeFileLeft(&file, 0)), treeFileValue(&file, treeFileRight(&file, 0)),
+        indexTreeFind(treeFileTree(&file), 11));
+    indexTreePrintInOrder(treeFileTree(&file));
+    printf("\n");
+    treeFileClose(&file);
+    remove(path);
+
+    // compressed preorder form.
+    if (!indexTreeFromTree(&itree, bst, TREE_LAYOUT_PREORDER)){
+        printf("failed to build index tree\n");
+        return 1;
+    }
+    uint8_t *compressed = malloc(treeVarintMaxBytes(itree.len));
+    size_t compressed_bytes = treeVarintEncode(itree.nodes, itree.len, compressed);
+    node2_t decoded[15];
+    int decoded_len = treeVarintDecode(compressed, compressed_bytes, decoded);
+    printf("\nvarint: %zu bytes instead of %zu, decoded %d nodes, match %d\n",
+        compressed_bytes, indexTreeBytes(&itree), decoded_len,
+        decoded_len == itree.len && 0 == memcmp(decoded, itree.nodes, indexTreeBytes(&itree)));
+    free(compressed);
+    indexTreeFree(&itree);
+
+    // the arena is dropped all at once; nodeArenaDestroy would free it, had nodeArenaInit allocated it.
+    nodeArenaReset(&arena);
+    return 0;
+}
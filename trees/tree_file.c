@@ -0,0 +1,96 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tree_file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../common/trace.h"
+
+// words summed between modulo reductions; keeps both sums well inside 64 bits.
+#define CHECKSUM_BLOCK_WORDS 1024
+
+uint64_t treeFileChecksum(const void *data, size_t len){
+    const uint8_t *bytes = data;
+    uint64_t a = 0, b = 0;
+    size_t words = len / 4;
+    for (size_t i = 0; i < words; ){
+        size_t block_end = i + CHECKSUM_BLOCK_WORDS < words ? i + CHECKSUM_BLOCK_WORDS : words;
+        for ( ; i < block_end; i++){
+            uint32_t word;
+            memcpy(&word, &bytes[4 * i], sizeof(word));
+            a += word;
+            b += a;
+        }
+        a %= 0xFFFFFFFF;
+        b %= 0xFFFFFFFF;
+    }
+    return (b << 32) | a;
+}
+
+bool treeFileWrite(const char *path, const index_tree_t *itree){
+    uint8_t header_block[TREE_FILE_DATA_OFFSET] = { 0 };
+    tree_file_header_t header = {
+        .version = TREE_FILE_VERSION,
+        .layout = itree->layout,
+        .byte_order = TREE_FILE_BYTE_ORDER,
+        .node_size = sizeof(node2_t),
+        .len = itree->len,
+        .checksum = treeFileChecksum(itree->nodes, indexTreeBytes(itree))
+    };
+    memcpy(header.magic, TREE_FILE_MAGIC, sizeof(header.magic));
+    memcpy(header_block, &header, sizeof(header));
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return false;
+    TRACE_BEGIN("treeFileWrite");
+    bool ok = fwrite(header_block, 1, sizeof(header_block), f) == sizeof(header_block);
+    ok = ok && fwrite(itree->nodes, 1, indexTreeBytes(itree), f) == indexTreeBytes(itree);
+    ok = (fclose(f) == 0) && ok;
+    TRACE_END("treeFileWrite");
+    return ok;
+}
+
+bool treeFileOpen(tree_file_t *file, const char *path, bool verify){
+    memset(file, 0, sizeof(tree_file_t));
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return false;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < TREE_FILE_DATA_OFFSET){
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file alive; the descriptor is no longer needed.
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    file->map = map;
+    file->map_len = st.st_size;
+
+    const tree_file_header_t *header = map;
+    uint8_t *nodes = (uint8_t *) map + TREE_FILE_DATA_OFFSET;
+    size_t nodes_len = st.st_size - TREE_FILE_DATA_OFFSET;
+    if (memcmp(header->magic, TREE_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TREE_FILE_VERSION ||
+        header->byte_order != TREE_FILE_BYTE_ORDER ||
+        header->node_size != sizeof(node2_t) ||
+        header->layout > TREE_LAYOUT_VEB ||
+        header->len > INT32_MAX ||
+        header->len * sizeof(node2_t) != nodes_len ||
+        (verify && treeFileChecksum(nodes, nodes_len) != header->checksum)){
+        treeFileClose(file);
+        return false;
+    }
+    file->header = header;
+    indexTreeView(&file->tree, nodes, (int) header->len, header->layout);
+    return true;
+}
+
+void treeFileClose(tree_file_t *file){
+    if (file->map != NULL) munmap(file->map, file->map_len);
+    memset(file, 0, sizeof(tree_file_t));
+}
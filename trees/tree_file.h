@@ -0,0 +1,60 @@
+#ifndef TREE_FILE_H_
+#define TREE_FILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree.h"
+
+// On-disk index_tree_t that is mmap'ed and read in place: opening a file maps it and
+// checks the header, with no per-node work and no copy. Pages are shared with every
+// other process that maps the same file.
+//
+// File layout:
+// [ tree_file_header_t, padded to TREE_FILE_DATA_OFFSET ][ node2_t x len ]
+// Integers are in host byte order; byte_order lets a reader on another host refuse the file.
+
+#define TREE_FILE_MAGIC "TREE"
+#define TREE_FILE_VERSION 1
+#define TREE_FILE_BYTE_ORDER 0x01020304
+// nodes start on their own cache line.
+#define TREE_FILE_DATA_OFFSET 64
+
+typedef struct {
+    char magic[4];          // TREE_FILE_MAGIC
+    uint16_t version;       // TREE_FILE_VERSION
+    uint16_t layout;        // tree_layout_t
+    uint32_t byte_order;    // TREE_FILE_BYTE_ORDER as written by the producer
+    uint32_t node_size;     // sizeof(node2_t)
+    uint64_t len;           // number of nodes
+    uint64_t checksum;      // treeFileChecksum of the node bytes
+} tree_file_header_t;
+
+typedef struct {
+    void *map;
+    size_t map_len;
+    const tree_file_header_t *header;
+    index_tree_t tree;      // view over the mapped nodes. read only.
+} tree_file_t;
+
+// Fletcher-64 over the node bytes (a multiple of 4 bytes).
+uint64_t treeFileChecksum(const void *data, size_t len);
+
+// write 'itree' to 'path' in the format above. return true if successful.
+bool treeFileWrite(const char *path, const index_tree_t *itree);
+
+// map the tree file at 'path'. Only the header is read, unless 'verify' is set, in which case
+// every node byte is checksummed first (O(n)). return true if successful.
+bool treeFileOpen(tree_file_t *file, const char *path, bool verify);
+void treeFileClose(tree_file_t *file);
+
+// Accessors over the mapped nodes. 'i' is a node index, the root is 0.
+static inline int treeFileLen(const tree_file_t *file){ return file->tree.len; }
+static inline int treeFileValue(const tree_file_t *file, int i){ return file->tree.nodes[i].value; }
+static inline int treeFileLeft(const tree_file_t *file, int i){ return file->tree.nodes[i].left; }
+static inline int treeFileRight(const tree_file_t *file, int i){ return file->tree.nodes[i].right; }
+// the whole mapped tree, for indexTreeFind, indexTreePrintInOrder and friends.
+static inline const index_tree_t *treeFileTree(const tree_file_t *file){ return &file->tree; }
+
+#endif  // TREE_FILE_H_
@@ -0,0 +1,108 @@
+#include "tree_parallel.h"
+
+#include <stdlib.h>
+
+#include "../common/trace.h"
+
+// stop splitting the top of the tree once there are this many subtrees per thread...
+#define SUBTREES_PER_THREAD 8
+// ...or it is this deep. The top levels are walked recursively, so this also bounds the recursion.
+#define MAX_TOP_DEPTH 24
+
+typedef struct {
+    node_t *tree;
+    int start_idx;
+    int size;
+} subtree_t;
+
+typedef struct {
+    subtree_t *subtrees;
+    node2_t *tree_array;
+    bool write;            // pass 2 (serialize) rather than pass 1 (count)
+    bool failed;
+} parallel_job_t;
+
+// count or serialize the subtrees [begin, end).
+static void subtreeRange(task_pool_t *pool, long begin, long end, void *arg){
+    parallel_job_t *job = arg;
+    for (long i = begin; i < end; i++){
+        subtree_t *subtree = &job->subtrees[i];
+        int result = job->write ?
+            serializeTree(subtree->tree, job->tree_array, subtree->start_idx) :
+            countTreeNodes(subtree->tree);
+        if (result < 0){
+            __atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+        } else if (!job->write){
+            subtree->size = result;
+        }
+    }
+}
+
+// the nodes 'depth' levels down, left to right, are the subtrees. 'subtrees' may be NULL to just count them.
+static int collectSubtrees(node_t *tree, int depth, subtree_t *subtrees, int count){
+    if (tree == NULL) return count;
+    if (depth == 0){
+        if (subtrees != NULL) subtrees[count].tree = tree;
+        return count + 1;
+    }
+    count = collectSubtrees(tree->left, depth - 1, subtrees, count);
+    return collectSubtrees(tree->right, depth - 1, subtrees, count);
+}
+
+// serialize the top 'depth' levels at 'idx' and hand each subtree below them its start index,
+// in the same order collectSubtrees found them. return the final array position.
+static int serializeTop(node_t *tree, int depth, node2_t *tree_array, int idx, subtree_t *subtrees, int *next_subtree){
+    if (depth == 0){
+        subtree_t *subtree = &subtrees[(*next_subtree)++];
+        subtree->start_idx = idx;
+        return idx + subtree->size - 1;
+    }
+    int end_idx = idx;
+    tree_array[idx].value = tree->value;
+    tree_array[idx].left = -1;
+    tree_array[idx].right = -1;
+    if (tree->left != NULL){
+        tree_array[idx].left = idx + 1;
+        end_idx = serializeTop(tree->left, depth - 1, tree_array, idx + 1, subtrees, next_subtree);
+    }
+    if (tree->right != NULL){
+        tree_array[idx].right = end_idx + 1;
+        end_idx = serializeTop(tree->right, depth - 1, tree_array, end_idx + 1, subtrees, next_subtree);
+    }
+    return end_idx;
+}
+
+int serializeTreeParallel(node_t *tree, node2_t *tree_array, int idx, task_pool_t *pool){
+    if (tree == NULL) return -1;
+    int num_threads = task_pool_threads(pool);
+    if (num_threads <= 1) return serializeTree(tree, tree_array, idx);
+
+    // find the shallowest level with enough subtrees to keep every thread busy.
+    int depth = 0, num_subtrees = 1;
+    while (num_subtrees < SUBTREES_PER_THREAD * num_threads && depth < MAX_TOP_DEPTH){
+        int below = collectSubtrees(tree, depth + 1, NULL, 0);
+        if (below == 0) break; // the whole tree fits in the top levels
+        depth++;
+        num_subtrees = below;
+    }
+    parallel_job_t job = {
+        .subtrees = malloc(num_subtrees * sizeof(subtree_t)),
+        .tree_array = tree_array,
+    };
+    if (job.subtrees == NULL) return -1;
+    TRACE_BEGIN("serializeTreeParallel");
+    collectSubtrees(tree, depth, job.subtrees, 0);
+
+    // a subtree per task: uneven subtrees are what the idle threads steal.
+    int next_subtree = 0, end_idx = -1;
+    task_parallel_for(pool, 0, num_subtrees, 1, subtreeRange, &job);
+    if (!job.failed){
+        end_idx = serializeTop(tree, depth, tree_array, idx, job.subtrees, &next_subtree);
+        job.write = true;
+        task_parallel_for(pool, 0, num_subtrees, 1, subtreeRange, &job);
+        if (job.failed) end_idx = -1;
+    }
+    free(job.subtrees);
+    TRACE_END("serializeTreeParallel");
+    return end_idx;
+}
@@ -0,0 +1,22 @@
+#ifndef TREE_PARALLEL_H_
+#define TREE_PARALLEL_H_
+
+#include "tree.h"
+#include "../common/task_pool.h"
+
+/* serializeTreeParallel
+ * same output as serializeTree, byte for byte, using the threads of 'pool'.
+ * serializeTree is sequential because a right subtree starts after the whole left subtree,
+ * so this runs in two passes over the subtrees hanging below the top levels of the tree:
+ *   1. count the nodes of every subtree, in parallel.
+ *   2. walk the top levels, writing their nodes and giving every subtree its start index,
+ *      then serialize all the subtrees at their start index, in parallel.
+ * Every subtree is a task, so threads that finish early steal the rest and uneven subtrees
+ * balance out.
+ * Every node is walked twice, so this only pays off from about 3 cores up.
+ * A degenerate tree has one subtree per level and gains nothing from this.
+ * return the index of the final array position, or -1 if 'tree' is NULL or on allocation failure.
+*/
+int serializeTreeParallel(node_t *tree, node2_t *tree_array, int idx, task_pool_t *pool);
+
+#endif  // TREE_PARALLEL_H_
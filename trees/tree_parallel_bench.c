@@ -0,0 +1,95 @@
+/*
+Scaling of serializeTreeParallel against serializeTree, on a random tree of BENCH_NODES nodes.
+
+compile:
+make tree_parallel_bench
+
+run:
+./tree_parallel_bench [max threads]
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tree.h"
+#include "tree_parallel.h"
+
+#ifndef BENCH_NODES
+#define BENCH_NODES 10000000
+#endif
+
+double now_sec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Random binary search tree: insert nodes[0, n) with random values, no rebalancing.
+node_t *buildRandomTree(node_t *nodes, int n){
+    for (int i = 0; i < n; i++){
+        nodes[i].value = rand();
+        nodes[i].left = NULL;
+        nodes[i].right = NULL;
+        if (i == 0) continue;
+        node_t *curr = &nodes[0];
+        while (true){
+            node_t **next = nodes[i].value < curr->value ? &curr->left : &curr->right;
+            if (*next == NULL){
+                *next = &nodes[i];
+                break;
+            }
+            curr = *next;
+        }
+    }
+    return n > 0 ? &nodes[0] : NULL;
+}
+
+int main(int argc, char **argv){
+    int n = BENCH_NODES;
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1) max_threads = 1;
+    node_t *nodes = malloc(n * sizeof(node_t));
+    node2_t *expected = malloc(n * sizeof(node2_t));
+    node2_t *tree_array = malloc(n * sizeof(node2_t));
+    if (nodes == NULL || expected == NULL || tree_array == NULL){
+        printf("failed to allocate %d nodes\n", n);
+        return 1;
+    }
+    srand(1);
+    node_t *tree = buildRandomTree(nodes, n);
+    // fault the output buffers in up front so page faults are not timed (nonzero, or this becomes calloc).
+    memset(expected, 0xff, n * sizeof(node2_t));
+    memset(tree_array, 0xff, n * sizeof(node2_t));
+
+    double start = now_sec();
+    int end_idx = serializeTree(tree, expected, 0);
+    double sequential = now_sec() - start;
+    printf("random     n=%-9d sequential        %8.3fs\n", n, sequential);
+    for (int threads = 1; threads <= max_threads; threads *= 2){
+        task_pool_t pool;
+        if (!task_pool_init(&pool, threads)){
+            printf("failed to start %d threads\n", threads);
+            return 1;
+        }
+        memset(tree_array, 0xff, n * sizeof(node2_t));
+        start = now_sec();
+        int parallel_end_idx = serializeTreeParallel(tree, tree_array, 0, &pool);
+        double parallel = now_sec() - start;
+        task_pool_destroy(&pool);
+        bool match = parallel_end_idx == end_idx && 0 == memcmp(expected, tree_array, n * sizeof(node2_t));
+        printf("random     n=%-9d parallel x%-3d     %8.3fs   speedup %5.2f   match %d\n",
+            n, threads, parallel, sequential / parallel, match);
+    }
+    free(nodes);
+    free(expected);
+    free(tree_array);
+    return 0;
+}
@@ -7,16 +7,34 @@ gcc -g3 -std=c99 -pedantic -Wall -o tree_serializer_soln tree_serializer_soln.c
 run:
 ./tree_serializer_soln
 
+benchmark the recursive and iterative versions (balanced and degenerate trees of BENCH_NODES nodes):
+gcc -O2 -std=c99 -pedantic -Wall -D BENCH -o tree_serializer_soln_bench tree_serializer_soln.c
+./tree_serializer_soln_bench
+
 */
 
+#ifdef BENCH
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 // helper macros
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
+#ifdef TREE_LIB
+// Built with -D TREE_LIB, this file has no main and is linked next to tree.c (see tree_bench.c),
+// which has its own serializeTree and deserializeTree: the functions below take their tree.h
+// names instead, and the print helpers, which tree_serializer_soln2.c also has, are left out.
+#include "tree.h"
+#define serializeTree serializeTreeWalkthroughRecursive
+#define serializeTreeIterative serializeTreeWalkthrough
+#define deserializeTree deserializeTreeWalkthrough
+#else
 // Native tree interface using a recursive type definition and pointers.
 typedef struct node_t {
     int value;
@@ -33,15 +51,51 @@ void printTreeInOrder(node_t *tree){
     return;
 }
 
+// Same output as printTreeInOrder, but without recursion (Morris traversal).
+// The left subtree's rightmost node is temporarily threaded back to its ancestor
+// so we can climb back up without a stack. Every thread is removed again before
+// we leave the ancestor, so the tree is unchanged on return.
+void printTreeInOrderIterative(node_t *tree){
+    node_t *curr = tree;
+    while (curr != NULL){
+        if (curr->left == NULL){
+            printf("%d ", curr->value);
+            curr = curr->right;
+            continue;
+        }
+        node_t *pred = curr->left;
+        while (pred->right != NULL && pred->right != curr){
+            pred = pred->right;
+        }
+        if (pred->right == NULL){
+            // first visit: thread back to curr, then descend left.
+            pred->right = curr;
+            curr = curr->left;
+        } else {
+            // second visit: the left subtree is done. remove the thread.
+            pred->right = NULL;
+            printf("%d ", curr->value);
+            curr = curr->right;
+        }
+    }
+    return;
+}
+
 // New tree interface for serializing
 typedef struct {
     int value;
     int left;
     int right;
 } node2_t;
+#endif
 // max nodes to serialize
 #define MAX_NODES 1024
+#ifdef TREE_LIB
+// any length, as tree.h declares them.
+typedef node2_t *node_array_t;
+#else
 typedef node2_t node_array_t[MAX_NODES];
+#endif
 
 /* serializeTree
  * serialize a tree represented in the 'tree' variable into the array in the 'tree_array' variable.
@@ -67,6 +121,63 @@ int serializeTree(node_t *tree, node_array_t tree_array, int idx){
     return tree_end_idx;
 }
 
+// Explicit stack for serializeTreeIterative. Each entry is a subtree still to be
+// written, plus the array position of the parent whose .right it is (or -1).
+typedef struct {
+    node_t *tree;
+    int parent_idx;
+} serialize_frame_t;
+
+typedef struct {
+    serialize_frame_t *frames;
+    int len;
+    int cap;
+} serialize_stack_t;
+
+bool serialize_stack_push(serialize_stack_t *stack, node_t *tree, int parent_idx){
+    if (stack->len == stack->cap){
+        int cap = stack->cap == 0 ? 64 : 2 * stack->cap;
+        serialize_frame_t *frames = realloc(stack->frames, cap * sizeof(serialize_frame_t));
+        if (frames == NULL) return false;
+        stack->frames = frames;
+        stack->cap = cap;
+    }
+    stack->frames[stack->len].tree = tree;
+    stack->frames[stack->len].parent_idx = parent_idx;
+    stack->len++;
+    return true;
+}
+
+/* serializeTreeIterative
+ * same layout and return value as serializeTree, without recursion.
+ * nodes are written in preorder. A left child always lands right after its parent,
+ * so only right children are pushed with their parent's position; the stack holds
+ * at most one pending right subtree per ancestor, and never grows on a degenerate tree.
+ * return -1 if 'tree' is NULL or the stack could not be allocated.
+*/
+int serializeTreeIterative(node_t *tree, node_array_t tree_array, int idx){
+    if (tree == NULL) return -1;
+    serialize_stack_t stack = { 0 };
+    if (!serialize_stack_push(&stack, tree, -1)) return -1;
+    while (stack.len > 0){
+        serialize_frame_t frame = stack.frames[--stack.len];
+        node_t *node = frame.tree;
+        if (frame.parent_idx != -1) tree_array[frame.parent_idx].right = idx;
+        tree_array[idx].value = node->value;
+        tree_array[idx].left = node->left == NULL ? -1 : idx + 1;
+        tree_array[idx].right = -1;
+        // push right first so the whole left subtree is written before it.
+        if ((node->right != NULL && !serialize_stack_push(&stack, node->right, idx)) ||
+            (node->left != NULL && !serialize_stack_push(&stack, node->left, -1))){
+            free(stack.frames);
+            return -1;
+        }
+        idx++;
+    }
+    free(stack.frames);
+    return idx - 1;
+}
+
 /* deserializeTree
  * deserialize a tree represented in the 'tree_array' variable into its native
  * representation in the 'tree' variable.
@@ -89,6 +200,9 @@ node_t *deserializeTree(node_array_t tree_array, node_t *tree, int start_idx, in
     return &tree[start_idx];
 }
 
+#ifdef TREE_LIB
+// no main: see TREE_LIB above.
+#elif !defined(BENCH)
 int main(void){
     // Create test tree
     node_t tree0 = {.value = 4};
@@ -106,6 +220,9 @@ int main(void){
     printf("Tree: ");
     printTreeInOrder(&tree0);
     printf("\n");
+    printf("Tree (iterative): ");
+    printTreeInOrderIterative(&tree0);
+    printf("\n");
 
     // Serialize
     node_array_t tree_array;
@@ -118,6 +235,15 @@ int main(void){
     }
     printf("\n");
 
+    node_array_t tree_array_iterative;
+    tree0.value = 4;
+    bool match = end_idx == serializeTreeIterative(&tree0, tree_array_iterative, 0);
+    tree0.value = 3;
+    match = match && end_idx2 == serializeTreeIterative(&tree0, tree_array_iterative, end_idx + 2);
+    match = match && 0 == memcmp(tree_array, tree_array_iterative, (end_idx + 1) * sizeof(node2_t));
+    match = match && 0 == memcmp(&tree_array[end_idx + 2], &tree_array_iterative[end_idx + 2], (end_idx2 - end_idx - 1) * sizeof(node2_t));
+    printf("Serialized Trees (iterative) match: %d\n", match);
+
     // Deserialize
     node_t new_tree[MAX_NODES];
     node_t *root = deserializeTree(tree_array, new_tree, 0, end_idx);
@@ -131,3 +257,98 @@ int main(void){
 
     return 0;
 }
+#else
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef BENCH_NODES
+#define BENCH_NODES 10000000
+#endif
+// the recursive versions use one stack frame per level; deeper trees than this would overflow it.
+#define BENCH_RECURSION_LIMIT 100000
+
+double now_sec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Links nodes[0, n) into a complete binary tree (children of i are 2i+1, 2i+2).
+node_t *buildBalancedTree(node_t *nodes, int n){
+    for (int i = 0; i < n; i++){
+        nodes[i].value = i;
+        nodes[i].left = 2 * i + 1 < n ? &nodes[2 * i + 1] : NULL;
+        nodes[i].right = 2 * i + 2 < n ? &nodes[2 * i + 2] : NULL;
+    }
+    return n > 0 ? &nodes[0] : NULL;
+}
+
+// Links nodes[0, n) into a linked-list shaped tree, alternating left and right children.
+node_t *buildDegenerateTree(node_t *nodes, int n){
+    for (int i = 0; i < n; i++){
+        nodes[i].value = i;
+        nodes[i].left = (i % 2 == 0 && i + 1 < n) ? &nodes[i + 1] : NULL;
+        nodes[i].right = (i % 2 == 1 && i + 1 < n) ? &nodes[i + 1] : NULL;
+    }
+    return n > 0 ? &nodes[0] : NULL;
+}
+
+// Times printTreeInOrder-style output with stdout sent to /dev/null.
+double timePrint(void (*print)(node_t *), node_t *tree){
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int dev_null = open("/dev/null", O_WRONLY);
+    dup2(dev_null, STDOUT_FILENO);
+    double start = now_sec();
+    print(tree);
+    fflush(stdout);
+    double elapsed = now_sec() - start;
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(dev_null);
+    close(saved_stdout);
+    return elapsed;
+}
+
+void benchTree(const char *shape, node_t *tree, int n, node2_t *tree_array, node2_t *tree_array_iterative){
+    bool recursive = strcmp(shape, "degenerate") != 0 || n <= BENCH_RECURSION_LIMIT;
+    double start = now_sec();
+    int end_idx_iterative = serializeTreeIterative(tree, tree_array_iterative, 0);
+    double serialize_iterative = now_sec() - start;
+    double print_iterative = timePrint(printTreeInOrderIterative, tree);
+    if (!recursive){
+        printf("%-10s n=%-9d serialize: recursive %9s  iterative %8.3fs   print: recursive %9s  iterative %8.3fs\n",
+            shape, n, "overflow", serialize_iterative, "overflow", print_iterative);
+        return;
+    }
+    start = now_sec();
+    int end_idx = serializeTree(tree, tree_array, 0);
+    double serialize_recursive = now_sec() - start;
+    double print_recursive = timePrint(printTreeInOrder, tree);
+    bool match = end_idx == end_idx_iterative && 0 == memcmp(tree_array, tree_array_iterative, (end_idx + 1) * sizeof(node2_t));
+    printf("%-10s n=%-9d serialize: recursive %8.3fs  iterative %8.3fs   print: recursive %8.3fs  iterative %8.3fs   match %d\n",
+        shape, n, serialize_recursive, serialize_iterative, print_recursive, print_iterative, match);
+}
+
+int main(void){
+    int n = BENCH_NODES;
+    node_t *nodes = malloc(n * sizeof(node_t));
+    node2_t *tree_array = malloc(n * sizeof(node2_t));
+    node2_t *tree_array_iterative = malloc(n * sizeof(node2_t));
+    if (nodes == NULL || tree_array == NULL || tree_array_iterative == NULL){
+        printf("failed to allocate %d nodes\n", n);
+        return 1;
+    }
+    // fault the output buffers in up front so page faults are not timed (nonzero, or this becomes calloc).
+    memset(tree_array, 0xff, n * sizeof(node2_t));
+    memset(tree_array_iterative, 0xff, n * sizeof(node2_t));
+    benchTree("balanced", buildBalancedTree(nodes, n), n, tree_array, tree_array_iterative);
+    int m = MIN(n, BENCH_RECURSION_LIMIT);
+    benchTree("degenerate", buildDegenerateTree(nodes, m), m, tree_array, tree_array_iterative);
+    if (n > m) benchTree("degenerate", buildDegenerateTree(nodes, n), n, tree_array, tree_array_iterative);
+    free(nodes);
+    free(tree_array);
+    free(tree_array_iterative);
+    return 0;
+}
+#endif
@@ -7,22 +7,41 @@ gcc -g3 -std=c99 -pedantic -Wall -o tree_serializer_soln tree_serializer_soln.c
 run:
 ./tree_serializer_soln
 
+benchmark the recursive and iterative versions (balanced and degenerate trees of BENCH_NODES nodes):
+gcc -O2 -std=c99 -pedantic -Wall -D BENCH -o tree_serializer_soln2_bench tree_serializer_soln2.c
+./tree_serializer_soln2_bench
+
 */
 
+#ifdef BENCH
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 // helper macros
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
+#ifdef TREE_LIB
+// Built with -D TREE_LIB, this file has no main and is linked next to tree.c (see tree_bench.c),
+// whose serializeTree is the node2_t one: the functions below take their tree.h names instead.
+#include "tree.h"
+#define serializeTree serializeTreeSentinelRecursive
+#define serializeTreeIterative serializeTreeSentinel
+#define deserializeTree deserializeTreeSentinelRecursive
+#define deserializeTreeIterative deserializeTreeSentinel
+#else
 // Native tree interface using a recursive type definition and pointers.
 typedef struct node_t {
     int value;
     struct node_t *left;
     struct node_t *right;
 } node_t;
+#endif
 
 // Helper function to print a tree with an "in order" traversal (left subtree, me, right subtree).
 void printTreeInOrder(node_t *tree){
@@ -33,6 +52,36 @@ void printTreeInOrder(node_t *tree){
     return;
 }
 
+// Same output as printTreeInOrder, but without recursion (Morris traversal).
+// The left subtree's rightmost node is temporarily threaded back to its ancestor
+// so we can climb back up without a stack. Every thread is removed again before
+// we leave the ancestor, so the tree is unchanged on return.
+void printTreeInOrderIterative(node_t *tree){
+    node_t *curr = tree;
+    while (curr != NULL){
+        if (curr->left == NULL){
+            printf("%d ", curr->value);
+            curr = curr->right;
+            continue;
+        }
+        node_t *pred = curr->left;
+        while (pred->right != NULL && pred->right != curr){
+            pred = pred->right;
+        }
+        if (pred->right == NULL){
+            // first visit: thread back to curr, then descend left.
+            pred->right = curr;
+            curr = curr->left;
+        } else {
+            // second visit: the left subtree is done. remove the thread.
+            pred->right = NULL;
+            printf("%d ", curr->value);
+            curr = curr->right;
+        }
+    }
+    return;
+}
+
 // New tree interface for serializing
 // typedef struct {
 //     int value;
@@ -41,7 +90,12 @@ void printTreeInOrder(node_t *tree){
 // } node2_t;
 // max nodes to serialize
 #define MAX_NODES 1024
+#ifdef TREE_LIB
+// any length, as tree.h declares them.
+typedef int *node_array_t;
+#else
 typedef int node_array_t[MAX_NODES];
+#endif
 
 /* serializeTree
  * serialize a tree represented in the 'tree' variable into the array in the 'tree_array' variable.
@@ -63,6 +117,43 @@ int serializeTree(node_t *tree, node_array_t tree_array, int idx){
     return tree_end_idx;
 }
 
+/* serializeTreeIterative
+ * same layout and return value as serializeTree, without recursion.
+ * the explicit stack holds subtrees still to be written (NULL ones included, they
+ * become -1). A node's left subtree is pushed last so it is written first. On a
+ * right-leaning chain the stack never holds more than two entries, but on a
+ * left-leaning one every node leaves its NULL right child on it until the whole
+ * left spine is written, so it grows with the tree; it is grown with realloc.
+ * return -1 if the stack could not be allocated.
+*/
+int serializeTreeIterative(node_t *tree, node_array_t tree_array, int idx){
+    int len = 0, cap = 64;
+    node_t **stack = malloc(cap * sizeof(node_t *));
+    if (stack == NULL) return -1;
+    stack[len++] = tree;
+    while (len > 0){
+        node_t *node = stack[--len];
+        if (node == NULL){
+            tree_array[idx++] = -1;
+            continue;
+        }
+        tree_array[idx++] = node->value;
+        if (len + 2 > cap){
+            cap *= 2;
+            node_t **grown = realloc(stack, cap * sizeof(node_t *));
+            if (grown == NULL){
+                free(stack);
+                return -1;
+            }
+            stack = grown;
+        }
+        stack[len++] = node->right;
+        stack[len++] = node->left;
+    }
+    free(stack);
+    return idx - 1;
+}
+
 /* deserializeTree
  * deserialize a tree represented in the 'tree_array' variable into its native
  * representation in the 'tree' variable.
@@ -81,6 +172,41 @@ node_t *deserializeTree(node_array_t tree_array, node_t *tree, int start_idx, in
     return &tree[start_idx];
 }
 
+/* deserializeTreeIterative
+ * same as deserializeTree, without recursion and without extra memory.
+ * 'slot' is the child pointer the next array entry belongs in. Nodes whose right
+ * child is still to come form a stack, linked through their own (not yet set)
+ * .right pointers: when a -1 closes a left subtree, the top of that stack is the
+ * node whose right subtree comes next.
+*/
+node_t *deserializeTreeIterative(node_array_t tree_array, node_t *tree, int start_idx, int *end_idx){
+    node_t *root = NULL;
+    node_t **slot = &root;
+    node_t *pending_right = NULL;
+    for (int i = start_idx; ; i++){
+        if (tree_array[i] == -1){
+            *slot = NULL;
+            if (pending_right == NULL){
+                *end_idx = i;
+                return root;
+            }
+            node_t *node = pending_right;
+            pending_right = node->right;
+            slot = &node->right;
+            continue;
+        }
+        node_t *node = &tree[i];
+        node->value = tree_array[i];
+        node->right = pending_right;
+        pending_right = node;
+        *slot = node;
+        slot = &node->left;
+    }
+}
+
+#ifdef TREE_LIB
+// no main: see TREE_LIB above.
+#elif !defined(BENCH)
 int main(void){
     // Create test tree
     node_t tree0 = {.value = 4};
@@ -98,6 +224,9 @@ int main(void){
     printf("Tree: ");
     printTreeInOrder(&tree0);
     printf("\n");
+    printf("Tree (iterative): ");
+    printTreeInOrderIterative(&tree0);
+    printf("\n");
 
     // Serialize
     node_array_t tree_array;
@@ -111,6 +240,15 @@ int main(void){
     }
     printf("\n");
 
+    node_array_t tree_array_iterative;
+    tree0.value = 4;
+    bool match = end_idx == serializeTreeIterative(&tree0, tree_array_iterative, 0);
+    tree0.value = 3;
+    match = match && end_idx2 == serializeTreeIterative(&tree0, tree_array_iterative, end_idx + 2);
+    match = match && 0 == memcmp(tree_array, tree_array_iterative, (end_idx + 1) * sizeof(int));
+    match = match && 0 == memcmp(&tree_array[end_idx + 2], &tree_array_iterative[end_idx + 2], (end_idx2 - end_idx - 1) * sizeof(int));
+    printf("Serialized Trees (iterative) match: %d\n", match);
+
     // Deserialize
     node_t new_tree[MAX_NODES];
     node_t *root = deserializeTree(tree_array, new_tree, 0, &end_idx);
@@ -121,6 +259,123 @@ int main(void){
     printf("Deserialized Tree: ");
     printTreeInOrder(root);
     printf("\n");
+    root = deserializeTreeIterative(tree_array, new_tree, 0, &end_idx);
+    printf("Deserialized Tree (iterative): ");
+    printTreeInOrderIterative(root);
+    printf("\n");
+    root = deserializeTreeIterative(tree_array, new_tree, end_idx + 2, &end_idx);
+    printf("Deserialized Tree (iterative): ");
+    printTreeInOrderIterative(root);
+    printf("\n");
 
     return 0;
 }
+#else
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef BENCH_NODES
+#define BENCH_NODES 10000000
+#endif
+// the recursive versions use one stack frame per level; deeper trees than this would overflow it.
+#define BENCH_RECURSION_LIMIT 100000
+
+double now_sec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Links nodes[0, n) into a complete binary tree (children of i are 2i+1, 2i+2).
+node_t *buildBalancedTree(node_t *nodes, int n){
+    for (int i = 0; i < n; i++){
+        nodes[i].value = i;
+        nodes[i].left = 2 * i + 1 < n ? &nodes[2 * i + 1] : NULL;
+        nodes[i].right = 2 * i + 2 < n ? &nodes[2 * i + 2] : NULL;
+    }
+    return n > 0 ? &nodes[0] : NULL;
+}
+
+// Links nodes[0, n) into a linked-list shaped tree, alternating left and right children.
+node_t *buildDegenerateTree(node_t *nodes, int n){
+    for (int i = 0; i < n; i++){
+        nodes[i].value = i;
+        nodes[i].left = (i % 2 == 0 && i + 1 < n) ? &nodes[i + 1] : NULL;
+        nodes[i].right = (i % 2 == 1 && i + 1 < n) ? &nodes[i + 1] : NULL;
+    }
+    return n > 0 ? &nodes[0] : NULL;
+}
+
+// Times printTreeInOrder-style output with stdout sent to /dev/null.
+double timePrint(void (*print)(node_t *), node_t *tree){
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int dev_null = open("/dev/null", O_WRONLY);
+    dup2(dev_null, STDOUT_FILENO);
+    double start = now_sec();
+    print(tree);
+    fflush(stdout);
+    double elapsed = now_sec() - start;
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(dev_null);
+    close(saved_stdout);
+    return elapsed;
+}
+
+void benchTree(const char *shape, node_t *tree, int n, int *tree_array, node_t *new_tree){
+    bool recursive = strcmp(shape, "degenerate") != 0 || n <= BENCH_RECURSION_LIMIT;
+    int end_idx = 0;
+    double start = now_sec();
+    int end_idx_iterative = serializeTreeIterative(tree, tree_array, 0);
+    double serialize_iterative = now_sec() - start;
+    start = now_sec();
+    node_t *root = deserializeTreeIterative(tree_array, new_tree, 0, &end_idx);
+    double deserialize_iterative = now_sec() - start;
+    bool match = end_idx == end_idx_iterative;
+    double print_iterative = timePrint(printTreeInOrderIterative, root);
+    if (!recursive){
+        printf("%-10s n=%-9d serialize: recursive %9s  iterative %8.3fs   deserialize: recursive %9s  iterative %8.3fs   print: recursive %9s  iterative %8.3fs\n",
+            shape, n, "overflow", serialize_iterative, "overflow", deserialize_iterative, "overflow", print_iterative);
+        return;
+    }
+    // the recursive serializer must reproduce the iterative one's output exactly.
+    int *tree_array_iterative = malloc((end_idx_iterative + 1) * sizeof(int));
+    memcpy(tree_array_iterative, tree_array, (end_idx_iterative + 1) * sizeof(int));
+    start = now_sec();
+    int end_idx_recursive = serializeTree(tree, tree_array, 0);
+    double serialize_recursive = now_sec() - start;
+    match = match && end_idx_recursive == end_idx_iterative && 0 == memcmp(tree_array, tree_array_iterative, (end_idx_recursive + 1) * sizeof(int));
+    free(tree_array_iterative);
+    start = now_sec();
+    root = deserializeTree(tree_array, new_tree, 0, &end_idx);
+    double deserialize_recursive = now_sec() - start;
+    match = match && end_idx == end_idx_recursive;
+    double print_recursive = timePrint(printTreeInOrder, root);
+    printf("%-10s n=%-9d serialize: recursive %8.3fs  iterative %8.3fs   deserialize: recursive %8.3fs  iterative %8.3fs   print: recursive %8.3fs  iterative %8.3fs   match %d\n",
+        shape, n, serialize_recursive, serialize_iterative, deserialize_recursive, deserialize_iterative, print_recursive, print_iterative, match);
+}
+
+int main(void){
+    int n = BENCH_NODES;
+    node_t *nodes = malloc(n * sizeof(node_t));
+    // every node and every NULL child gets one entry: 2n+1 in total.
+    node_t *new_tree = malloc((2 * n + 1) * sizeof(node_t));
+    int *tree_array = malloc((2 * n + 1) * sizeof(int));
+    if (nodes == NULL || new_tree == NULL || tree_array == NULL){
+        printf("failed to allocate %d nodes\n", n);
+        return 1;
+    }
+    // fault the output buffers in up front so page faults are not timed (nonzero, or this becomes calloc).
+    memset(new_tree, 0xff, (2 * n + 1) * sizeof(node_t));
+    memset(tree_array, 0xff, (2 * n + 1) * sizeof(int));
+    benchTree("balanced", buildBalancedTree(nodes, n), n, tree_array, new_tree);
+    int m = MIN(n, BENCH_RECURSION_LIMIT);
+    benchTree("degenerate", buildDegenerateTree(nodes, m), m, tree_array, new_tree);
+    if (n > m) benchTree("degenerate", buildDegenerateTree(nodes, n), n, tree_array, new_tree);
+    free(nodes);
+    free(new_tree);
+    free(tree_array);
+    return 0;
+}
+#endif
@@ -0,0 +1,172 @@
+#include "tree_varint.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../common/trace.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TREE_VARINT_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#define HEADER_BYTES 8
+
+static uint32_t zigzag(int value){
+    return ((uint32_t) value << 1) ^ (uint32_t) -(value < 0);
+}
+
+static int unzigzag(uint32_t value){
+    return (int) (value >> 1) ^ -(int) (value & 1);
+}
+
+// bytes needed for 'value', minus one: the 2 bit code stored in the control stream.
+static int lengthCode(uint32_t value){
+    return (value > 0xFF) + (value > 0xFFFF) + (value > 0xFFFFFF);
+}
+
+static uint32_t readU32(const uint8_t *buf){
+    return buf[0] | (uint32_t) buf[1] << 8 | (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+static void writeU32(uint8_t *buf, uint32_t value){
+    for (int i = 0; i < 4; i++){
+        buf[i] = value >> (8 * i);
+    }
+}
+
+size_t treeVarintMaxBytes(int len){
+    return HEADER_BYTES + (2 * (size_t) len + 3) / 4 + 2 * (size_t) len * 4;
+}
+
+size_t treeVarintEncode(const node2_t *tree_array, int len, uint8_t *buf){
+    TRACE_BEGIN("treeVarintEncode");
+    size_t control_bytes = (2 * (size_t) len + 3) / 4;
+    uint8_t *control = buf + HEADER_BYTES;
+    uint8_t *data = control + control_bytes;
+    memset(control, 0, control_bytes);
+    size_t k = 0;
+    for (int i = 0; i < len; i++){
+        node2_t node = tree_array[i];
+        if ((node.left != -1 && node.left != i + 1) || (node.right != -1 && (node.right <= i || node.right >= len))){
+            TRACE_END("treeVarintEncode");
+            return 0; // not preorder
+        }
+        uint32_t ints[2] = {
+            zigzag(node.value),
+            (uint32_t) (node.right == -1 ? 0 : node.right - i) << 1 | (node.left != -1)
+        };
+        for (int j = 0; j < 2; j++, k++){
+            int code = lengthCode(ints[j]);
+            control[k / 4] |= code << (2 * (k % 4));
+            for (int b = 0; b <= code; b++){
+                *data++ = ints[j] >> (8 * b);
+            }
+        }
+    }
+    size_t data_bytes = data - (control + control_bytes);
+    writeU32(buf, len);
+    writeU32(buf + 4, data_bytes);
+    TRACE_END("treeVarintEncode");
+    return HEADER_BYTES + control_bytes + data_bytes;
+}
+
+int treeVarintLen(const uint8_t *buf, size_t buf_len){
+    if (buf_len < HEADER_BYTES) return -1;
+    uint32_t len = readU32(buf);
+    return len > INT32_MAX ? -1 : (int) len;
+}
+
+// rebuild node i from its two ints. return false if a link points outside the tree.
+static bool decodeNode(uint32_t value, uint32_t link, int i, int len, node2_t *tree_array){
+    uint32_t right_offset = link >> 1;
+    if (right_offset >= (uint32_t) (len - i) || ((link & 1) && i + 1 >= len)) return false;
+    tree_array[i].value = unzigzag(value);
+    tree_array[i].left = (link & 1) ? i + 1 : -1;
+    tree_array[i].right = right_offset == 0 ? -1 : i + (int) right_offset;
+    return true;
+}
+
+#ifdef TREE_VARINT_SSSE3
+// for each control byte: the shuffle spreading its 4 ints' data bytes out to 4 uint32 lanes
+// (0xFF zeroes a lane byte), and the number of data bytes it covers. Constant, so threads
+// decoding at once share them without setup.
+#define INT_BYTES(c, j) (1 + (((c) >> (2 * (j))) & 3))
+#define INT_START(c, j) (((j) > 0 ? INT_BYTES(c, 0) : 0) + ((j) > 1 ? INT_BYTES(c, 1) : 0) + \
+    ((j) > 2 ? INT_BYTES(c, 2) : 0))
+#define LANE_BYTE(c, j, b) ((b) < INT_BYTES(c, j) ? INT_START(c, j) + (b) : 0xFF)
+#define LANE(c, j) LANE_BYTE(c, j, 0), LANE_BYTE(c, j, 1), LANE_BYTE(c, j, 2), LANE_BYTE(c, j, 3)
+#define SHUFFLE(c) { LANE(c, 0), LANE(c, 1), LANE(c, 2), LANE(c, 3) }
+#define SHUFFLE4(c) SHUFFLE(c), SHUFFLE(c + 1), SHUFFLE(c + 2), SHUFFLE(c + 3)
+#define SHUFFLE16(c) SHUFFLE4(c), SHUFFLE4(c + 4), SHUFFLE4(c + 8), SHUFFLE4(c + 12)
+#define SHUFFLE64(c) SHUFFLE16(c), SHUFFLE16(c + 16), SHUFFLE16(c + 32), SHUFFLE16(c + 48)
+#define LENGTH(c) (INT_START(c, 3) + INT_BYTES(c, 3))
+#define LENGTH4(c) LENGTH(c), LENGTH(c + 1), LENGTH(c + 2), LENGTH(c + 3)
+#define LENGTH16(c) LENGTH4(c), LENGTH4(c + 4), LENGTH4(c + 8), LENGTH4(c + 12)
+#define LENGTH64(c) LENGTH16(c), LENGTH16(c + 16), LENGTH16(c + 32), LENGTH16(c + 48)
+
+static const uint8_t shuffle_table[256][16] = {
+    SHUFFLE64(0), SHUFFLE64(64), SHUFFLE64(128), SHUFFLE64(192)
+};
+static const uint8_t length_table[256] = {
+    LENGTH64(0), LENGTH64(64), LENGTH64(128), LENGTH64(192)
+};
+
+// decode whole control bytes (2 nodes each) while 16 bytes of data can be loaded.
+// return the number of control bytes consumed; the caller finishes the rest.
+__attribute__((target("ssse3")))
+static size_t decodeGroupsSSSE3(const uint8_t *control, size_t groups, const uint8_t **data, const uint8_t *data_end,
+    int len, node2_t *tree_array, bool *ok){
+    const uint8_t *in = *data;
+    size_t g = 0;
+    for ( ; g < groups && in + 16 <= data_end; g++){
+        __m128i bytes = _mm_loadu_si128((const __m128i *) in);
+        __m128i shuffle = _mm_loadu_si128((const __m128i *) shuffle_table[control[g]]);
+        uint32_t ints[4];
+        _mm_storeu_si128((__m128i *) ints, _mm_shuffle_epi8(bytes, shuffle));
+        in += length_table[control[g]];
+        if (!decodeNode(ints[0], ints[1], 2 * g, len, tree_array) ||
+            !decodeNode(ints[2], ints[3], 2 * g + 1, len, tree_array)){
+            *ok = false;
+            break;
+        }
+    }
+    *data = in;
+    return g;
+}
+#endif
+
+int treeVarintDecode(const uint8_t *buf, size_t buf_len, node2_t *tree_array){
+    int len = treeVarintLen(buf, buf_len);
+    if (len < 0) return -1;
+    size_t control_bytes = (2 * (size_t) len + 3) / 4;
+    size_t data_bytes = readU32(buf + 4);
+    if (HEADER_BYTES + control_bytes > buf_len || data_bytes > buf_len - HEADER_BYTES - control_bytes) return -1;
+    const uint8_t *control = buf + HEADER_BYTES;
+    const uint8_t *data = control + control_bytes;
+    const uint8_t *data_end = data + data_bytes;
+    bool ok = true;
+
+    // every full control byte holds exactly two nodes.
+    size_t k = 0;
+#ifdef TREE_VARINT_SSSE3
+    if (__builtin_cpu_supports("ssse3")){
+        k = 4 * decodeGroupsSSSE3(control, len / 2, &data, data_end, len, tree_array, &ok);
+        if (!ok) return -1;
+    }
+#endif
+    // scalar path: the tail, or everything without SSSE3.
+    uint32_t ints[2];
+    for ( ; k < 2 * (size_t) len; k++){
+        int bytes = 1 + ((control[k / 4] >> (2 * (k % 4))) & 3);
+        if (data + bytes > data_end) return -1;
+        uint32_t value = 0;
+        for (int b = 0; b < bytes; b++){
+            value |= (uint32_t) data[b] << (8 * b);
+        }
+        data += bytes;
+        ints[k % 2] = value;
+        if (k % 2 == 1 && !decodeNode(ints[0], ints[1], k / 2, len, tree_array)) return -1;
+    }
+    return data == data_end ? len : -1;
+}
@@ -0,0 +1,36 @@
+#ifndef TREE_VARINT_H_
+#define TREE_VARINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree.h"
+
+// Compressed form of a preorder node2_t array (the serializeTree layout).
+//
+// In preorder a left child always directly follows its parent, and a right child
+// follows the parent's whole left subtree, so each node is stored as two unsigned ints:
+//   zigzag(value)                      small values of either sign stay small
+//   (right - i) << 1 | has_left        0 for a leaf; 1 or 3 for most inner nodes
+// The 2n ints are written Stream VByte style: a control stream with 2 bits per int
+// (its length, 1 to 4 bytes) followed by a data stream of the ints' low bytes. Keeping
+// the lengths apart lets the decoder expand 4 ints per control byte with one shuffle.
+//
+// Buffer layout: [ uint32 nodes ][ uint32 data bytes ][ control: (2*nodes+3)/4 ][ data ]
+// A tree of small values takes about 2.5 bytes per node, against 12 for node2_t.
+
+// worst case size of the encoding of 'len' nodes.
+size_t treeVarintMaxBytes(int len);
+
+// encode the preorder array 'tree_array[0, len)' into 'buf', which has treeVarintMaxBytes(len) bytes.
+// return the encoded size, or 0 if 'tree_array' is not in preorder.
+size_t treeVarintEncode(const node2_t *tree_array, int len, uint8_t *buf);
+
+// number of nodes in the encoding in 'buf', or -1 if 'buf_len' is too short to hold one.
+int treeVarintLen(const uint8_t *buf, size_t buf_len);
+
+// decode 'buf' into 'tree_array', which has room for treeVarintLen(buf) nodes.
+// uses SSSE3 shuffles when the CPU has them. return the number of nodes, or -1 if 'buf' is malformed.
+int treeVarintDecode(const uint8_t *buf, size_t buf_len, node2_t *tree_array);
+
+#endif  // TREE_VARINT_H_